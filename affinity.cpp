@@ -0,0 +1,107 @@
+#include "affinity.h"
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include <stdexcept>
+#include <string>
+
+std::vector<int> Affinity::parse(const char *list) {
+    std::vector<int> cpus;
+    const char *p = list;
+
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p or first < 0)
+            throw std::invalid_argument(std::string("Bad CPU list '") + list + "'");
+
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 or last < first)
+                throw std::invalid_argument(std::string("Bad CPU list '") + list + "'");
+            p = end;
+        }
+
+        if (last >= CPU_SETSIZE)
+            throw std::invalid_argument(std::string("CPU out of range in '") + list + "'");
+
+        for (long cpu = first; cpu <= last; ++cpu)
+            cpus.push_back((int)cpu);
+
+        if (*p == ',')
+            ++p;
+        else if (*p)
+            throw std::invalid_argument(std::string("Bad CPU list '") + list + "'");
+    }
+
+    if (cpus.empty())
+        throw std::invalid_argument("Empty CPU list");
+
+    return cpus;
+}
+
+bool Affinity::pin(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu < 0 or cpu >= CPU_SETSIZE)
+            return false;
+        CPU_SET(cpu, &set);
+    }
+
+    // pid 0 es "el thread que llama" (en Linux la afinidad es por thread)
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+int Affinity::current_cpu() {
+    return sched_getcpu();
+}
+
+int Affinity::node_of(int cpu) {
+    /*
+     * No usamos libnuma: el kernel expone la topologia en sysfs como
+     * un directorio nodeN dentro de cada cpuM.
+     * */
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR *dir = opendir(path.c_str());
+    if (not dir)
+        return 0;
+
+    int node = 0;
+    while (struct dirent *entry = readdir(dir)) {
+        if (strncmp(entry->d_name, "node", 4) == 0 and entry->d_name[4] >= '0' and entry->d_name[4] <= '9') {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+
+    closedir(dir);
+    return node;
+}
+
+int Affinity::node_of_address(const void *addr) {
+    /*
+     * Tampoco aca usamos libnuma: get_mempolicy() con MPOL_F_ADDR
+     * consulta la pagina de addr y con MPOL_F_NODE retorna su nodo en
+     * vez de la politica.
+     * */
+    int node = -1;
+    if (syscall(SYS_get_mempolicy, &node, nullptr, 0, addr, MPOL_F_NODE | MPOL_F_ADDR) != 0)
+        return -1;
+    return node;
+}
+
+int Affinity::available_cpus() {
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+        return 1;
+    return CPU_COUNT(&set);
+}
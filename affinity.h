@@ -0,0 +1,61 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <vector>
+
+/*
+ * Afinidad de CPU.
+ *
+ * Por default el scheduler mueve a los threads de un core a otro
+ * (migraciones) segun le convenga. Para un server eso tiene un costo:
+ * los paquetes de una conexion los procesa el kernel en un core (el
+ * que atendio la interrupcion o el softirq) y si el thread que lee el
+ * socket corre en otro, los datos (y el propio struct del socket)
+ * tienen que viajar de un cache a otro. En una maquina con varios
+ * nodos NUMA ademas la memoria puede estar "lejos".
+ *
+ * Fijando (pinning) cada Worker a un core y dandole a cada Worker las
+ * conexiones cuyos paquetes llegan a su core (vease
+ * Socket::incoming_cpu()) todo el procesamiento de una conexion ocurre
+ * en un mismo core.
+ * */
+class Affinity {
+    public:
+    /*
+     * Parsea una lista de CPUs como las de taskset/cpuset: "0-3,6,8-9".
+     * Lanza std::invalid_argument si esta mal formada.
+     * */
+    static std::vector<int> parse(const char *list);
+
+    /*
+     * Fija el thread actual a los CPUs dados. Retorna false (y deja el
+     * thread como estaba) si el sistema no lo permite, por ejemplo si
+     * algun CPU no existe o esta fuera del cpuset del proceso.
+     * */
+    static bool pin(const std::vector<int>& cpus);
+
+    /*
+     * CPU en el que esta corriendo el thread en este momento.
+     * */
+    static int current_cpu();
+
+    /*
+     * Nodo NUMA al que pertenece el CPU (0 si no se puede saber, como
+     * en maquinas sin NUMA).
+     * */
+    static int node_of(int cpu);
+
+    /*
+     * Nodo NUMA en el que esta la pagina de memoria de addr (si todavia
+     * no se toco, el kernel la ubica ahora). Retorna -1 si no se puede
+     * saber, como en un kernel sin soporte NUMA.
+     * */
+    static int node_of_address(const void *addr);
+
+    /*
+     * Cantidad de CPUs en los que el proceso puede correr.
+     * */
+    static int available_cpus();
+};
+
+#endif
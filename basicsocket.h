@@ -0,0 +1,822 @@
+#ifndef BASICSOCKET_H
+#define BASICSOCKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <chrono>
+#include <stdexcept>
+
+#include "resolver.h"
+#include "unixresolver.h"
+#include "liberror.h"
+#include "trace.h"
+#include "recorder.h"
+
+/*
+ * Familias de direcciones para BasicSocket.
+ *
+ * Cada familia define su dominio (el primer argumento de socket()), el
+ * tipo de sus direcciones, con que se resuelven (Addresses, con la
+ * interfaz de Resolver) y que hay que hacer antes del bind() de un
+ * socket pasivo.
+ * */
+template<int D, class A>
+struct InetFamily {
+    static const int DOMAIN = D;
+    typedef A Address;
+    typedef Resolver Addresses;
+
+    /*
+     * Como el sistema operativo puede mantener ocupado (en TIME_WAIT)
+     * un puerto que fue usado recientemente, no queremos que nuesta
+     * aplicacion falle a la hora de hacer un bind() por algo que sabemos
+     * que es temporal.
+     *
+     * Un puerto en TIME_WAIT esta "ocupado" solo temporalmente por
+     * el sistema operativo.
+     *
+     * Entonces queremos decirle que "queremos reutilizar la direccion"
+     * aun si esta en TIME_WAIT (de otro modo obtendriamos un error al
+     * llamar a bind() con un "Address already in use")
+     * */
+    static int prepare_bind(int skt, const struct addrinfo *) {
+        int val = 1;
+        return setsockopt(skt, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val));
+    }
+};
+
+typedef InetFamily<AF_INET, struct sockaddr_in> Inet4;
+typedef InetFamily<AF_INET6, struct sockaddr_in6> Inet6;
+
+struct Unix {
+    static const int DOMAIN = AF_UNIX;
+    typedef struct sockaddr_un Address;
+    typedef UnixResolver Addresses;
+
+    /*
+     * Un path "viejo" (de una ejecucion anterior) haria fallar al bind()
+     * con "Address already in use": como en Handoff, lo borramos.
+     * No chequeamos el error: lo normal es que el path no exista.
+     * */
+    static int prepare_bind(int, const struct addrinfo *addr) {
+        ::unlink(((const struct sockaddr_un*)addr->ai_addr)->sun_path);
+        return 0;
+    }
+};
+
+/*
+ * Transportes para BasicSocket.
+ *
+ *  - TYPE es el segundo argumento de socket()
+ *  - CONNECTION_ORIENTED: hay una conexion, un recv() que retorna 0
+ *    significa que el peer la cerro y un send() puede fallar con EPIPE.
+ *    En un socket de datagramas en cambio un recv() que retorna 0 es
+ *    un datagrama vacio.
+ *  - LISTENS: el socket pasivo hace listen() y accept()
+ *  - SEND_FLAGS: MSG_NOSIGNAL evita el SIGPIPE (vease
+ *    BasicSocket::sendsome()), que solo existe con conexiones
+ * */
+struct Stream {
+    static const int TYPE = SOCK_STREAM;
+    static const bool CONNECTION_ORIENTED = true;
+    static const bool LISTENS = true;
+    static const int SEND_FLAGS = MSG_NOSIGNAL;
+};
+
+struct Datagram {
+    static const int TYPE = SOCK_DGRAM;
+    static const bool CONNECTION_ORIENTED = false;
+    static const bool LISTENS = false;
+    static const int SEND_FLAGS = 0;
+};
+
+/*
+ * Con conexion, como Stream, pero preservando los limites de los
+ * mensajes: cada send() es un mensaje y cada recv() lee a lo sumo uno.
+ * Linux lo soporta para Unix; para Inet4/Inet6 seria SCTP, que
+ * getaddrinfo() no suele resolver.
+ * */
+struct SeqPacket {
+    static const int TYPE = SOCK_SEQPACKET;
+    static const bool CONNECTION_ORIENTED = true;
+    static const bool LISTENS = true;
+    static const int SEND_FLAGS = MSG_NOSIGNAL;
+};
+
+/*
+ * Estadisticas del modo de baja latencia (vease
+ * BasicSocket::set_busy_poll()).
+ *
+ * spin_ns es el tiempo total que BasicSocket::recvsome() paso "girando"
+ * (spinning) consultando al socket sin bloquearse; sleep_ns es el
+ * tiempo total que paso bloqueado en recv() una vez agotado el
+ * presupuesto de spinning.
+ *
+ * spin_hits cuenta cuantas lecturas se resolvieron girando y
+ * sleeps cuantas terminaron bloqueandose.
+ * */
+struct SocketBusyPollStats {
+    unsigned long long spin_ns;
+    unsigned long long sleep_ns;
+    unsigned long long spin_hits;
+    unsigned long long sleeps;
+};
+
+/*
+ * Socket parametrizado en familia (Inet4, Inet6, Unix) y transporte
+ * (Stream, Datagram, SeqPacket).
+ *
+ * Generalizar Socket con flags en runtime ("es UDP?", "es UNIX?")
+ * agregaria un branch en cada send() y recv(). Aca en cambio la familia
+ * y el transporte son parametros del template: las constantes de las
+ * policies se resuelven al compilar y cada combinacion tiene su propio
+ * codigo, sin branches ni llamadas indirectas. Para IPv4/TCP el codigo
+ * generado es el mismo que el de la version escrita a mano (Socket,
+ * vease socket.h, es justamente BasicSocket<Inet4, Stream> mas lo
+ * especifico de TCP).
+ *
+ * Lo que no tiene sentido para una combinacion no compila: accept() en
+ * un socket de datagramas, sendto() en uno con conexion, etc.
+ *
+ * Para Unix no hay host: el path del socket va en servicename y el
+ * hostname se ignora (puede ser nullptr).
+ *
+ *  BasicSocket<Inet6, Stream> srv("8080");
+ *  BasicSocket<Unix, SeqPacket> skt(nullptr, "/tmp/app.sock");
+ *  BasicSocket<Inet4, Datagram> udp("127.0.0.1", "9000");
+ * */
+template<class Family, class Transport>
+class BasicSocket {
+    public:
+    typedef typename Family::Address Address;
+    typedef SocketBusyPollStats BusyPollStats;
+
+    protected:
+    int skt;
+    bool closed;
+    unsigned int spin_usecs;
+    BusyPollStats stats;
+
+    /*
+     * Construye un BasicSocket a partir de un file descriptor ya
+     * existente y toma su ownership (lo "adopta").
+     *
+     * Es protegido: el codigo del usuario no deberia manipular file
+     * descriptors.
+     * */
+    explicit BasicSocket(int skt) : skt(skt), closed(false), spin_usecs(0), stats() {}
+
+    /*
+     * Hace el accept() y retorna el file descriptor del nuevo socket.
+     * BasicSocket::accept() (y Socket::accept()) lo adoptan.
+     * */
+    int accept_fd() {
+        static_assert(Transport::LISTENS, "accept() requires a listening transport (Stream or SeqPacket)");
+
+        uint64_t t0 = Trace::now();
+        int skt = ::accept(this->skt, nullptr, nullptr);
+        Trace::record(Trace::ACCEPT, this->skt, 0, skt == -1 ? -errno : skt, t0);
+        if (skt == -1)
+            throw LibError(errno, "Socket accept failed: ");
+
+        Recorder::open(skt, Recorder::OPEN_ACCEPTED);
+        return skt;
+    }
+
+    private:
+    /*
+     * Hace el recv() del modo de baja latencia: gira con MSG_DONTWAIT
+     * mientras dure el presupuesto y despues se bloquea.
+     *
+     * Retorna lo mismo que recv().
+     * */
+    static int recv_spinning(int skt, char *data, unsigned int sz, unsigned int spin_usecs,
+                             BusyPollStats& stats) {
+        using clock = std::chrono::steady_clock;
+        auto begin = clock::now();
+        auto deadline = begin + std::chrono::microseconds(spin_usecs);
+
+        int s;
+        auto now = begin;
+        do {
+            s = recv(skt, data, sz, MSG_DONTWAIT);
+            now = clock::now();
+            if (s >= 0 or (errno != EAGAIN and errno != EWOULDBLOCK)) {
+                // Llego algo (o hubo un error real): lo resolvimos girando
+                stats.spin_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(now - begin).count();
+                ++stats.spin_hits;
+                return s;
+            }
+        } while (now < deadline);
+
+        stats.spin_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(now - begin).count();
+
+        // Se agoto el presupuesto: nos bloqueamos como siempre.
+        s = recv(skt, data, sz, 0);
+        int errno_saved = errno;
+
+        stats.sleep_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - now).count();
+        ++stats.sleeps;
+
+        errno = errno_saved;
+        return s;
+    }
+
+    public:
+    /*
+     * Construye el socket tanto para conectarse a un servidor
+     * (primer constructor) como para inicializarlo para ser usado
+     * por un servidor (segundo constructor).
+     *
+     * Muchas librerias de muchos lenguajes ofrecen una unica formal de inicializar
+     * los sockets y luego metodos (post-inicializacion) para establer
+     * la conexion o ponerlo en escucha.
+     *
+     * Otras librerias/lenguajes van por tener una inicializacion para
+     * el socket activo y otra para el pasivo.
+     *
+     * Este codigo es un ejemplo de ello.
+     *
+     * Para un socket de datagramas "conectarse" solo fija el destino
+     * por default de sendsome() y filtra lo que se recibe a lo que
+     * venga de ahi; el socket pasivo hace el bind() pero no el listen().
+     * */
+    BasicSocket(const char *hostname, const char *servicename) :
+        skt(-1), closed(true), spin_usecs(0), stats() {
+        typename Family::Addresses resolver(hostname, servicename, false, Family::DOMAIN, Transport::TYPE);
+
+        int s;
+        int skt = -1;
+        while (resolver.has_next()) {
+            struct addrinfo *addr = resolver.next();
+
+            /* Cerramos el socket si nos quedo abierto de la iteracion
+             * anterior
+             * */
+            if (skt != -1)
+                ::close(skt);
+
+            /* Creamos el socket definiendo la familia (Family::DOMAIN),
+               el tipo de socket (Transport::TYPE) y el protocolo (0) */
+            skt = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+            if (skt == -1) {
+                continue;
+            }
+
+            /* Intentamos conectarnos al servidor cuya direccion
+             * fue dada por el resolver
+             * */
+            uint64_t t0 = Trace::now();
+            s = connect(skt, addr->ai_addr, addr->ai_addrlen);
+            Trace::record(Trace::CONNECT, skt, 0, s == -1 ? -errno : s, t0);
+            if (s == -1) {
+                continue;
+            }
+
+            // Conexion exitosa!
+            this->skt = skt;
+            this->closed = false;
+            Recorder::open(skt, Recorder::OPEN_CONNECTED);
+            return;
+        }
+
+        // El errno es una (psuedo) variable global con el ultimo error generado.
+        // Es importante no llamar nada antes ya que cualquier llamada
+        // a la libc puede cambiar el errno y hacernos perder el mensaje
+        // El manejo de errores en C es muy sensible!
+        int errno_saved = errno;
+
+        // No hay q olvidarse de cerrar el socket en caso de
+        // que lo hayamos abierto
+        if (skt != -1)
+            ::close(skt);
+
+        // Lanzamos una excepcion con el errno que guardamos (preservamos)
+        // excepcion
+        // Dado que probamos multiples direcciones y llamamos a socket() y
+        // a connect() multiples veces podriamos estar ante el caso de varios
+        // errores *distintos*.
+        // Sin embargo vamos a notificar del ultimo error y nada mas.
+        //
+        // Notese que lanzar una excepcion en el constructor es la unica manera
+        // de poder comunicar que un objeto no se construyo
+        throw LibError(errno_saved, "Socket for connection to '%s:%s' failed: ",
+                hostname ? hostname : "", servicename);
+    }
+
+    BasicSocket(const char *servicename) : skt(-1), closed(true), spin_usecs(0), stats() {
+        typename Family::Addresses resolver(nullptr, servicename, true, Family::DOMAIN, Transport::TYPE);
+
+        int s;
+        int skt = -1;
+        while (resolver.has_next()) {
+            struct addrinfo *addr = resolver.next();
+
+            /* Cerramos el socket si nos quedo abierto de la iteracion
+             * anterior
+             * */
+            if (skt != -1)
+                ::close(skt);
+
+            /* Creamos el socket definiendo la misma familia, tipo y protocolo
+             * que tiene la direccion que estamos por probar.
+             *
+             * Ya que usamos un resolver no conviene hardcodear esos valores
+             * sino usar los mismos que ya estan cargados en la direccion
+             * que estamos probando.
+             * */
+            skt = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+            if (skt == -1) {
+                continue;
+            }
+
+            // Lo que la familia necesite antes del bind() (vease
+            // InetFamily::prepare_bind() y Unix::prepare_bind())
+            s = Family::prepare_bind(skt, addr);
+            if (s == -1) {
+                continue;
+            }
+
+            // Hacemos le bind: enlazamos el socket a una direccion local
+            // para escuchar
+            s = bind(skt, addr->ai_addr, addr->ai_addrlen);
+            if (s == -1) {
+                continue;
+            }
+
+            // Ponemos el socket a escuchar. Ese 20 (podria ser otro valor)
+            // indica cuantas conexiones a la espera de ser aceptadas se toleraran
+            // No tiene nada q ver con cuantas conexiones totales el server tendra
+            //
+            // Un socket de datagramas no escucha: con el bind() ya recibe.
+            if (Transport::LISTENS) {
+                s = listen(skt, 20);
+                if (s == -1) {
+                    continue;
+                }
+            }
+
+            // setupeamos el socket! Ahora esta escuchando
+            // en una de las direcciones obtenidas por el resolver
+            // y esta listo para aceptar conexiones (o recibir datagramas).
+            this->skt = skt;
+            this->closed = false;
+            return;
+        }
+
+        int errno_saved = errno;
+
+        // No hay q olvidarse de cerrar el socket en caso de
+        // que lo hayamos abierto
+        if (skt != -1)
+            ::close(skt);
+
+        throw LibError(errno_saved, "Socket for service '%s' failed: ", servicename);
+    }
+
+    BasicSocket() : skt(-1), closed(true), spin_usecs(0), stats() {}
+
+    /* BasicSocket::sendsome() lee hasta sz bytes del buffer y los envia. La funcion
+     * puede enviar menos bytes sin embargo.
+     *
+     * BasicSocket::recvsome() por el otro lado recibe hasta sz bytes y los escribe
+     * en el buffer (que debe estar pre-allocado). La funcion puede recibir
+     * menos bytes sin embargo.
+     *
+     * Si el socket detecto que la conexion fue cerrada, la variable
+     * was_closed es puesta a True, de otro modo sera False.
+     *
+     * Retorna 0 si se cerro el socket, menor a 0 si el socket es no
+     * bloqueante (vease set_nonblocking()) y la operacion se hubiera
+     * bloqueado (EAGAIN) o positivo que indicara cuantos bytes realmente
+     * se enviaron/recibieron. Cualquier otro error lanza LibError.
+     *
+     * En un socket de datagramas (o SeqPacket) cada llamada envia o
+     * recibe un mensaje entero; sin conexion, retornar 0 significa un
+     * datagrama vacio y was_closed nunca se pone en True.
+     *
+     * Lease man send y man recv
+     * */
+    int sendsome(const void *data, unsigned int sz, bool *was_closed) {
+        *was_closed = false;
+        uint64_t t0 = Trace::now();
+        int s = send(this->skt, (char*)data, sz, Transport::SEND_FLAGS);
+        Trace::record(Trace::SEND, this->skt, sz, s < 0 ? -errno : s, t0);
+        if (s == 0 and Transport::CONNECTION_ORIENTED) {
+            // Puede o no ser un error (vease el comentario en recvsome())
+            *was_closed = true;
+            return 0;
+        } else if (s < 0) {
+            // Este es un caso especial: cuando enviamos algo pero en el medio
+            // se detecta un cierre del socket no se sabe bien cuanto se logro
+            // enviar (y fue recibido por el peer) y cuanto se perdio.
+            //
+            // Se dice que la "tuberia esta rota" o en ingles, "broken pipe"
+            //
+            // En Linux el sistema operativo envia una signal (SIGPIPE) que
+            // mata al proceso. El flag MSG_NOSIGNAL evita eso y nos permite
+            // checkear y manejar la condicion mas elegantemente
+            if (Transport::CONNECTION_ORIENTED and errno == EPIPE) {
+                // Puede o no ser un error (vease el comentario en recvsome())
+                *was_closed = true;
+                return 0;
+            }
+
+            // Socket no bloqueante con el buffer de envio lleno
+            if (errno == EAGAIN or errno == EWOULDBLOCK)
+                return -1;
+
+            // 99% casi seguro que es un error
+            throw LibError(errno, "Socket sendsome failed (len %d): ", sz);
+        } else {
+            Recorder::record(Recorder::SEND, this->skt, data, s);
+            return s;
+        }
+    }
+
+    int recvsome(void *data, unsigned int sz, bool *was_closed) {
+        *was_closed = false;
+        int s;
+        uint64_t t0 = Trace::now();
+        if (this->spin_usecs)
+            s = recv_spinning(this->skt, (char*)data, sz, this->spin_usecs, this->stats);
+        else
+            s = recv(this->skt, (char*)data, sz, 0);
+        Trace::record(Trace::RECV, this->skt, sz, s < 0 ? -errno : s, t0);
+        if (s == 0 and Transport::CONNECTION_ORIENTED) {
+            // Puede ser o no un error, dependera del protocolo.
+            // Alguno protocolo podria decir "se reciben datos hasta
+            // que la conexion se cierra" en cuyo caso el cierre del socket
+            // no es un error sino algo esperado.
+            *was_closed = true;
+            return 0;
+        } else if (s < 0) {
+            // Socket no bloqueante sin nada para leer
+            if (errno == EAGAIN or errno == EWOULDBLOCK)
+                return -1;
+
+            // 99% casi seguro que es un error real
+            throw LibError(errno, "Socket recvsome failed (len %d): ", sz);
+        } else {
+            Recorder::record(Recorder::RECV, this->skt, data, s);
+            return s;
+        }
+    }
+
+    /*
+     * Envia un datagrama a addr / recibe uno y pone en from (si no es
+     * nullptr) de donde vino. Solo para sockets sin conexion.
+     *
+     * Retornan la cantidad de bytes enviados/recibidos; si el datagrama
+     * no entraba en sz bytes, recvfrom() lo trunca.
+     * */
+    int sendto(const void *data, unsigned int sz, const Address& addr) {
+        static_assert(not Transport::CONNECTION_ORIENTED, "sendto() is for connectionless transports (Datagram)");
+
+        uint64_t t0 = Trace::now();
+        int s = ::sendto(this->skt, (const char*)data, sz, Transport::SEND_FLAGS,
+                (const struct sockaddr*)&addr, sizeof(addr));
+        Trace::record(Trace::SEND, this->skt, sz, s < 0 ? -errno : s, t0);
+        if (s < 0)
+            throw LibError(errno, "Socket sendto failed (len %d): ", sz);
+
+        Recorder::record(Recorder::SEND, this->skt, data, s);
+        return s;
+    }
+
+    int recvfrom(void *data, unsigned int sz, Address *from) {
+        static_assert(not Transport::CONNECTION_ORIENTED, "recvfrom() is for connectionless transports (Datagram)");
+
+        socklen_t len = sizeof(Address);
+        uint64_t t0 = Trace::now();
+        int s = ::recvfrom(this->skt, (char*)data, sz, 0, (struct sockaddr*)from, from ? &len : nullptr);
+        Trace::record(Trace::RECV, this->skt, sz, s < 0 ? -errno : s, t0);
+        if (s < 0)
+            throw LibError(errno, "Socket recvfrom failed (len %d): ", sz);
+
+        Recorder::record(Recorder::RECV, this->skt, data, s);
+        return s;
+    }
+
+    /*
+     * Modo de baja latencia (opt-in).
+     *
+     * Bloquearse en recv() implica que cuando llega el mensaje el kernel
+     * tiene que despertar al thread y el scheduler tiene que volver
+     * a ponerlo a correr: eso suma latencia a *cada* mensaje.
+     *
+     * Con spin_usecs > 0, BasicSocket::recvsome() primero "gira" haciendo
+     * recv() no bloqueantes durante a lo sumo spin_usecs microsegundos
+     * y solo si no llego nada se bloquea como siempre.
+     * Ademas se configura SO_BUSY_POLL / SO_PREFER_BUSY_POLL si el
+     * kernel lo soporta para que el propio kernel haga polling de la
+     * placa de red (estas opciones son best-effort y sus errores se
+     * ignoran).
+     *
+     * El precio: un core al 100% mientras se gira. Solo tiene sentido
+     * en el camino critico y con cores de sobra.
+     *
+     * Con spin_usecs == 0 se vuelve al modo normal.
+     * */
+    void set_busy_poll(unsigned int spin_usecs) {
+        this->spin_usecs = spin_usecs;
+
+        /*
+         * SO_BUSY_POLL le pide al kernel que, en un recv() bloqueante,
+         * haga polling de la cola de la placa de red durante esa cantidad
+         * de microsegundos antes de dormir al thread.
+         *
+         * Aumentar el valor por encima del de /proc/sys/net/core/busy_read
+         * requiere CAP_NET_ADMIN: si falla seguimos igual, el spinning
+         * en user-space funciona de todos modos.
+         * */
+#ifdef SO_BUSY_POLL
+        int val = spin_usecs;
+        setsockopt(this->skt, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val));
+#endif
+#ifdef SO_PREFER_BUSY_POLL
+        int prefer = spin_usecs > 0 ? 1 : 0;
+        setsockopt(this->skt, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer));
+#endif
+    }
+
+    const BusyPollStats& busy_poll_stats() const {
+        return this->stats;
+    }
+
+    /*
+     * Pone (o saca) al socket en modo no bloqueante (O_NONBLOCK).
+     *
+     * En ese modo sendsome() y recvsome() retornan enseguida un valor
+     * menor a 0 si no pueden enviar/recibir nada; el caller debe
+     * esperar a que el socket sea writable/readable (vease poller.h).
+     * sendall() y recvall() no tienen sentido en este modo: si se
+     * bloquearian lanzan LibError con EAGAIN.
+     * */
+    void set_nonblocking(bool nonblocking) {
+        int flags = fcntl(this->skt, F_GETFL);
+        if (flags == -1)
+            throw LibError(errno, "Socket fcntl(F_GETFL) failed: ");
+
+        flags = nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+        if (fcntl(this->skt, F_SETFL, flags) == -1)
+            throw LibError(errno, "Socket fcntl(F_SETFL) failed: ");
+    }
+
+    /*
+     * BasicSocket::sendall() envia exactamente sz bytes leidos del buffer, ni mas,
+     * ni menos. BasicSocket::recvall() recibe exactamente sz bytes.
+     *
+     * sz es de 64 bits: se puede transferir mas de 4 GiB en una sola
+     * llamada (internamente se hacen sendsome()/recvsome() de a lo sumo
+     * MAX_CHUNK bytes).
+     *
+     * Retornan sz. En caso de error se lanza LibError; si el socket se
+     * cerro antes de completar, was_closed es puesto a True y se lanza
+     * std::runtime_error ya que es claro que no se transfirio todo.
+     *
+     * La segunda version ademas mantiene en done la cantidad exacta de
+     * bytes transferidos: se actualiza despues de cada sendsome() o
+     * recvsome(), asi que es valida tanto al retornar como cuando se
+     * lanza una excepcion o el peer cierra la conexion. Con eso el caller
+     * puede continuar desde done en vez de empezar de nuevo (vease
+     * resumable.h).
+     *
+     * Ojo: para sendall() "enviado" significa "entregado al kernel". Lo
+     * que todavia estaba en el buffer de envio cuando se corto la
+     * conexion se pierde; cuanto llego de verdad solo lo sabe el peer.
+     *
+     * Solo con conexion: sin ella "todo lo pedido" mezclaria datagramas.
+     * */
+    static const size_t MAX_CHUNK = 1 << 30;
+
+    size_t sendall(const void *data, size_t sz, bool *was_closed) {
+        size_t done;
+        return this->sendall(data, sz, was_closed, &done);
+    }
+
+    size_t recvall(void *data, size_t sz, bool *was_closed) {
+        size_t done;
+        return this->recvall(data, sz, was_closed, &done);
+    }
+
+    size_t sendall(const void *data, size_t sz, bool *was_closed, size_t *done) {
+        static_assert(Transport::CONNECTION_ORIENTED, "sendall() requires a connection-oriented transport");
+
+        size_t sent = 0;
+        *done = 0;
+        *was_closed = false;
+
+        while (sent < sz) try {
+            size_t chunk = sz - sent < MAX_CHUNK ? sz - sent : MAX_CHUNK;
+            int s = this->sendsome((char*)data + sent, chunk, was_closed);
+            if (s == 0) {
+                // Si el socket fue cerrado (s == 0) pero es claro que no logramos
+                // enviar todo lo que queriamos enviar por lo que supondremos
+                // que es un error y lanzamos una excepcion.
+                //
+                // Podriamos crear nuestra propia clase UnexpectedClosed pero
+                // por simplicidad voy a lanzar std::runtime_error que es una excepcion
+                // estandar que me permite pasarle un mensaje simple
+                // a su constructor
+                throw std::runtime_error("Unexpected closed");
+            } else if (s < 0) {
+                throw LibError(EAGAIN, "Socket sendsome would block: ");
+            } else {
+                sent += s;
+                *done = sent;
+            }
+        } catch (const LibError& err) {
+            throw LibError(err.error_code, "Socket sendall failed (len %zu/%zu): ", sent, sz);
+        }
+
+        return sz;
+    }
+
+    size_t recvall(void *data, size_t sz, bool *was_closed, size_t *done) {
+        static_assert(Transport::CONNECTION_ORIENTED, "recvall() requires a connection-oriented transport");
+
+        size_t received = 0;
+        *done = 0;
+        *was_closed = false;
+
+        while (received < sz) try {
+            size_t chunk = sz - received < MAX_CHUNK ? sz - received : MAX_CHUNK;
+            int s = this->recvsome((char*)data + received, chunk, was_closed);
+            if (s == 0) {
+                // Vease el comentario en sendall()
+                throw std::runtime_error("Unexpected closed");
+            } else if (s < 0) {
+                throw LibError(EAGAIN, "Socket recvsome would block: ");
+            }
+            else {
+                // Ok, recibimos algo pero no necesariamente todo lo que
+                // esperamos. La condicion del while checkea eso justamente
+                received += s;
+                *done = received;
+            }
+        } catch (const LibError& err) {
+            throw LibError(err.error_code, "Socket recvall failed (len %zu/%zu): ", received, sz);
+        }
+
+        return sz;
+    }
+
+    /*
+     * Acepta una conexion entrante y construye con ella un BasicSocket
+     * peer. Dicho peer es retornado por move semantics.
+     * */
+    BasicSocket accept() {
+        /*
+         * Creamos un BasicSocket en el scope de accept() y lo retornamos.
+         * Por default C y C++ harian una copia pero copiar un socket no tiene
+         * sentido y ya tenemos al constructor por copia deshabilitado
+         * asi que no funcionara.
+         *
+         * Lo que queremos es que este socket siga vivo y se mueva al scope
+         * superior (a quien llamo a accept().
+         *
+         * Este es el corazon de Move Semantics.
+         * */
+        return BasicSocket(this->accept_fd());
+    }
+
+    /*
+     * Cierra la conexion ya sea parcial o completamente.
+     * Lease man 2 shutdown
+     * */
+    void shutdown(int how) {
+        uint64_t t0 = Trace::now();
+        int s = ::shutdown(this->skt, how);
+        Trace::record(Trace::SHUTDOWN, this->skt, how, s == -1 ? -errno : s, t0);
+        if (s == -1) {
+            throw LibError(errno, "Socket shutdown failed: ");
+        }
+    }
+
+    /*
+     * Cierra el socket. El cierre no implica un shutdown
+     * que debe ser llamado explicitamente.
+     * */
+    int close() {
+        // Aunque estrictamente uno deberia chequear el codigo de error
+        // de close(), el hecho es que no hay mucho que se pueda hacer
+        // al respecto.
+        this->closed = true;
+        Recorder::close(this->skt);
+
+        uint64_t t0 = Trace::now();
+        int s = ::close(this->skt);
+        Trace::record(Trace::CLOSE, this->skt, 0, s == -1 ? -errno : s, t0);
+        return s;
+    }
+
+    /*
+     * Desinicializa el socket. Si aun esta conectado,
+     * se llamara a shutdown() y close() automaticamente.
+     * */
+    ~BasicSocket() {
+        if (not this->closed) {
+            // Aunque estrictamente uno deberia chequear el codigo de error
+            // de shutdown() y close(), el hecho es que no hay mucho que se pueda hacer
+            // al respecto.
+            // Es mas, intentar lanzar una excepcion desde un destructor lleva
+            // al programa abortar asi que lo mejor es dejarlo asi.
+            this->release();
+        }
+    }
+
+    /*
+     * Copiar un socket carece de todo sentido. Como lo copiarias?
+     * Estarian conectados al mismo server? Que pasaria del lado del server
+     * si ahora su cliente tiene 2 sockets hacia él?
+     *
+     * Simplemente no tiene sentido.
+     *
+     * Ya que C++ nos crea por default el constructor y el operador asignacion
+     * por copia, lo unico razonable es prohibir los.
+     * */
+    BasicSocket(const BasicSocket&) = delete;
+    BasicSocket& operator=(const BasicSocket&) = delete;
+
+    /*
+     * BasicSocket es movible
+     * */
+    BasicSocket(BasicSocket&& other) {
+        this->skt = other.skt;
+        this->closed = other.closed;
+        this->spin_usecs = other.spin_usecs;
+        this->stats = other.stats;
+
+        // Le robamos al otro socket su file descriptor.
+        // A partir de aqui somos nosotros (this) los dueños
+        // del recurso.
+        //
+        // Hubo una transferencia de ownership y por lo tanto
+        // debemos hacer que el destructor del otro socket no
+        // libere los recursos.
+        //
+        // Para un socket con esto alcanza (mirate Resolver)
+        other.skt = -1;
+        other.closed = true;
+    }
+
+    BasicSocket& operator=(BasicSocket&& other) {
+        // Este es un caso borde donde alguien codeo
+        //  skt = skt;
+        //
+        // Si alguien quiere "moverse a si mismo" no hacemos nada.
+        if (this == &other)
+            return *this;
+
+        // A diferencia del constructor por movimiento, nosotros
+        // somos un objeto ya construido.
+        // Antes de tomar el ownership del otro socket debemos
+        // liberar nuestro propio recurso.
+        // Al igual que en el destructor no chequeamos errores.
+        if (not this->closed)
+            this->release();
+
+        // A partir de aqui hacemos lo mismo que en el constructor
+        // por movimiento.
+        //
+        // Le robamos el recurso al otro, transferimos el ownership
+        // del recurso del otro socket hacia el nuestro.
+        this->skt = other.skt;
+        this->closed = other.closed;
+        this->spin_usecs = other.spin_usecs;
+        this->stats = other.stats;
+
+        other.skt = -1;
+        other.closed = true;
+
+        return *this;
+    }
+
+    private:
+    /*
+     * shutdown() y close() sin chequear errores, para el destructor y
+     * el operador asignacion por movimiento.
+     * */
+    void release() {
+        Recorder::close(this->skt);
+
+        uint64_t t0 = Trace::now();
+        int s = ::shutdown(this->skt, 2);
+        Trace::record(Trace::SHUTDOWN, this->skt, 2, s == -1 ? -errno : s, t0);
+
+        t0 = Trace::now();
+        s = ::close(this->skt);
+        Trace::record(Trace::CLOSE, this->skt, 0, s == -1 ? -errno : s, t0);
+    }
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include <iostream>
+#include "socket.h"
+#include "affinity.h"
+
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <exception>
+
+/*
+ * Benchmark de afinidad: N pares cliente/server hacen ping-pong de
+ * 64 bytes por loopback durante S segundos, primero sin afinidad
+ * (el scheduler ubica los threads donde quiere) y despues con cada
+ * par fijado a un CPU (los pares se reparten entre los CPUs
+ * disponibles).
+ *
+ * En loopback el que envia hace tambien el procesamiento de recepcion
+ * del kernel: con ambos extremos en el mismo CPU los datos nunca
+ * salen de su cache.
+ *
+ * Por cada modo reporta:
+ *
+ *  - requests/s (ping-pongs completos, en total)
+ *  - migraciones observadas cada 1000 requests: cada thread consulta
+ *    en que CPU esta (sched_getcpu()) en cada iteracion y cuenta los
+ *    cambios
+ *  - context switches involuntarios (el scheduler desalojo al thread)
+ *
+ * Uso:
+ *
+ *  ./bench_affinity <pairs> <seconds>
+ *
+ *  ./bench_affinity 4 5
+ * */
+
+struct ThreadStats {
+    unsigned long long requests;
+    unsigned long long migrations;
+    long involuntary;
+
+    ThreadStats() : requests(0), migrations(0), involuntary(0) {}
+};
+
+static void ping_pong(Socket& skt, bool client, int cpu, const std::atomic<bool>& stop, ThreadStats& stats) {
+    if (cpu >= 0 and not Affinity::pin(std::vector<int>(1, cpu)))
+        std::cerr << "Could not pin to CPU " << cpu << "\n";
+
+    char msg[64] = {0};
+    bool was_closed = false;
+    int last_cpu = Affinity::current_cpu();
+
+    while (true) {
+        if (client) {
+            if (stop)
+                break;
+            skt.sendall(msg, sizeof(msg), &was_closed);
+            skt.recvall(msg, sizeof(msg), &was_closed);
+        } else {
+            // El server termina cuando el cliente cierra
+            skt.recvsome(msg, 1, &was_closed);
+            if (was_closed)
+                break;
+            skt.recvall(msg + 1, sizeof(msg) - 1, &was_closed);
+            skt.sendall(msg, sizeof(msg), &was_closed);
+        }
+
+        ++stats.requests;
+        int now_cpu = Affinity::current_cpu();
+        if (now_cpu != last_cpu) {
+            ++stats.migrations;
+            last_cpu = now_cpu;
+        }
+    }
+
+    if (client)
+        skt.shutdown(SHUT_WR);
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) == 0)
+        stats.involuntary = usage.ru_nivcsw;
+}
+
+static void bench(const char *mode, int pairs, double seconds, bool pinned) {
+    Socket srv("3132");
+    std::vector<Socket> clients, servers;
+    for (int i = 0; i < pairs; ++i) {
+        clients.push_back(Socket("127.0.0.1", "3132"));
+        servers.push_back(srv.accept());
+    }
+
+    const int ncpus = Affinity::available_cpus();
+    std::atomic<bool> stop(false);
+    std::vector<ThreadStats> stats(2 * pairs);
+    std::vector<std::thread> threads;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < pairs; ++i) {
+        int cpu = pinned ? i % ncpus : -1;
+        threads.emplace_back(ping_pong, std::ref(servers[i]), false, cpu, std::cref(stop), std::ref(stats[2 * i]));
+        threads.emplace_back(ping_pong, std::ref(clients[i]), true, cpu, std::cref(stop), std::ref(stats[2 * i + 1]));
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto& th : threads)
+        th.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    unsigned long long requests = 0, migrations = 0;
+    long involuntary = 0;
+    for (int i = 0; i < 2 * pairs; ++i) {
+        if (i % 2 == 1)
+            requests += stats[i].requests;
+        migrations += stats[i].migrations;
+        involuntary += stats[i].involuntary;
+    }
+
+    std::cout << mode << ": " << requests / elapsed << " requests/s"
+              << ", " << (requests ? migrations * 1000.0 / requests : 0) << " migrations/1k requests"
+              << ", " << involuntary << " involuntary context switches\n";
+}
+
+int main(int argc, char *argv[]) try {
+    if (argc != 3) {
+        std::cerr << "Bad program call. Expected " << argv[0] << " <pairs> <seconds>\n";
+        return -1;
+    }
+
+    int pairs = atoi(argv[1]);
+    double seconds = atof(argv[2]);
+
+    std::cout << Affinity::available_cpus() << " CPUs available\n";
+    bench("unpinned", pairs, seconds, false);
+    bench("pinned  ", pairs, seconds, true);
+
+    return 0;
+} catch (const std::exception& err) {
+    std::cerr << "Something went wrong and an exception was caught: " << err.what() << "\n";
+    return -1;
+} catch (...) {
+    std::cerr << "Something went wrong and an unknown exception was caught.\n";
+    return -1;
+}
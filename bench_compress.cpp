@@ -0,0 +1,136 @@
+#include <iostream>
+#include "socket.h"
+#include "compressedsocket.h"
+
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <exception>
+
+/*
+ * Benchmark de CompressedSocket: envia MB megabytes por loopback con
+ * distintos niveles de compresion y reporta
+ *
+ *  - ratio: bytes en el cable / bytes de la aplicacion
+ *  - throughput: MB/s de datos de la aplicacion
+ *  - CPU: nanosegundos de CPU (de todo el proceso: emisor y receptor)
+ *    por byte de la aplicacion
+ *
+ * para dos tipos de datos: texto (lineas de log, muy comprimible) y
+ * bytes aleatorios (incomprimibles: aca se ve el salteo adaptativo).
+ *
+ * Loopback es un "enlace" rapidisimo: en un enlace lento la ganancia
+ * por enviar menos bytes seria mucho mayor.
+ *
+ * Uso:
+ *
+ *  ./bench_compress <MB> <level> [<level> ...]
+ *
+ *  ./bench_compress 256 0 1 6 9
+ * */
+
+static double cpu_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static std::vector<char> text_corpus(size_t sz) {
+    const char *levels[] = { "INFO", "WARN", "DEBUG", "ERROR" };
+    const char *paths[] = { "/index.html", "/api/v1/users", "/health", "/static/app.js" };
+
+    std::mt19937 rng(42);
+    std::string out;
+    while (out.size() < sz) {
+        out += "2026-10-18T09:" + std::to_string(rng() % 60) + ":" + std::to_string(rng() % 60)
+            + " " + levels[rng() % 4] + " request served path=" + paths[rng() % 4]
+            + " status=200 bytes=" + std::to_string(rng() % 100000)
+            + " latency_us=" + std::to_string(rng() % 5000) + "\n";
+    }
+
+    return std::vector<char>(out.begin(), out.begin() + sz);
+}
+
+static std::vector<char> random_corpus(size_t sz) {
+    std::mt19937 rng(42);
+    std::vector<char> out(sz);
+    for (auto& c : out)
+        c = (char)rng();
+    return out;
+}
+
+static void bench(const char *name, const std::vector<char>& data, int level) {
+    Socket srv("3130");
+    unsigned long long received = 0;
+
+    std::thread receiver([&srv, &received, level] {
+        bool was_closed = false;
+        Socket peer = srv.accept();
+        CompressedSocket zpeer(peer, level);
+
+        std::vector<char> buf(64 * 1024);
+        while (true) {
+            int n = zpeer.recvsome(buf.data(), buf.size(), &was_closed);
+            if (was_closed)
+                break;
+            received += n;
+        }
+    });
+
+    double cpu0 = cpu_seconds();
+    auto begin = std::chrono::steady_clock::now();
+
+    bool was_closed = false;
+    Socket skt("127.0.0.1", "3130");
+    CompressedSocket zskt(skt, level);
+
+    const size_t chunk = 16 * 1024;
+    for (size_t off = 0; off < data.size(); off += chunk)
+        zskt.sendall(data.data() + off, std::min(chunk, data.size() - off), &was_closed);
+
+    zskt.flush(&was_closed);
+    skt.shutdown(SHUT_WR);
+    receiver.join();
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    double cpu = cpu_seconds() - cpu0;
+
+    const CompressedSocket::Stats& stats = zskt.get_stats();
+    double ratio = zskt.is_enabled() ? (double)stats.wire_bytes / stats.app_bytes : 1.0;
+
+    std::cout << name << " level " << level
+              << ": ratio " << ratio
+              << ", " << received / elapsed / 1e6 << " MB/s"
+              << ", " << cpu * 1e9 / received << " CPU ns/byte"
+              << " (" << stats.deflated_blocks << " deflated / " << stats.raw_blocks << " raw blocks)\n";
+}
+
+int main(int argc, char *argv[]) try {
+    if (argc < 3) {
+        std::cerr << "Bad program call. Expected " << argv[0] << " <MB> <level> [<level> ...]\n";
+        return -1;
+    }
+
+    size_t sz = (size_t)atoi(argv[1]) * 1024 * 1024;
+    std::vector<char> text = text_corpus(sz);
+    std::vector<char> noise = random_corpus(sz);
+
+    for (int i = 2; i < argc; ++i) {
+        bench("text  ", text, atoi(argv[i]));
+        bench("random", noise, atoi(argv[i]));
+    }
+
+    return 0;
+} catch (const std::exception& err) {
+    std::cerr << "Something went wrong and an exception was caught: " << err.what() << "\n";
+    return -1;
+} catch (...) {
+    std::cerr << "Something went wrong and an unknown exception was caught.\n";
+    return -1;
+}
@@ -0,0 +1,111 @@
+#include <iostream>
+#include "delimiter.h"
+
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+#include <exception>
+
+/*
+ * Microbenchmark de Delimiter::find(): cuantos GB/s se escanean
+ * buscando \r\n\r\n con cada implementacion (y con memmem() de la libc
+ * como referencia) para distintos tamaños de buffer y densidades de
+ * delimitadores (uno cada N bytes, o ninguno).
+ *
+ * Uso:
+ *
+ *  ./bench_delim
+ * */
+
+static std::vector<char> make_buffer(size_t sz, size_t every) {
+    // Texto "parecido" a headers: muchas letras y algun \r\n suelto
+    // que obliga a verificar candidatos.
+    std::vector<char> buf(sz);
+    for (size_t i = 0; i < sz; ++i)
+        buf[i] = i % 40 == 39 ? '\n' : (i % 40 == 38 ? '\r' : 'a' + i % 26);
+
+    if (every) {
+        for (size_t i = every - 4; i + 4 <= sz; i += every)
+            memcpy(&buf[i], "\r\n\r\n", 4);
+    }
+
+    return buf;
+}
+
+/*
+ * Cuenta todas las ocurrencias repitiendo hasta escanear ~1 GB
+ * y retorna GB/s.
+ * */
+template<class Find>
+static double measure(const std::vector<char>& buf, Find find, size_t *count) {
+    const char *end = buf.data() + buf.size();
+    size_t rounds = (1UL << 30) / buf.size() + 1;
+
+    auto begin = std::chrono::steady_clock::now();
+    size_t found = 0;
+    for (size_t r = 0; r < rounds; ++r) {
+        const char *p = buf.data();
+        while ((p = find(p, end)) != nullptr) {
+            ++found;
+            p += 4;
+        }
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    *count = found / rounds;
+    return rounds * buf.size() / secs / 1e9;
+}
+
+int main() try {
+    const size_t sizes[] = { 64, 1024, 16 * 1024, 1024 * 1024 };
+    const size_t densities[] = { 64, 1024, 0 };
+    const char *impls[] = { "scalar", "sse2", "avx2" };
+
+    Delimiter delim("\r\n\r\n", 4);
+
+    std::cout << "size\tevery\tmemmem";
+    for (const char *impl : impls)
+        std::cout << "\t" << impl;
+    std::cout << "\t(GB/s)\n";
+
+    for (size_t sz : sizes) {
+        for (size_t every : densities) {
+            if (every >= sz)
+                continue;
+
+            std::vector<char> buf = make_buffer(sz, every);
+            size_t expected;
+
+            std::cout << sz << "\t" << (every ? std::to_string(every) : "none") << "\t";
+            std::cout << measure(buf, [](const char *p, const char *end) {
+                return (const char*)memmem(p, end - p, "\r\n\r\n", 4);
+            }, &expected);
+
+            for (const char *impl : impls) {
+                std::cout << "\t";
+                if (not Delimiter::force(impl)) {
+                    std::cout << "n/a";
+                    continue;
+                }
+
+                size_t count;
+                std::cout << measure(buf, [&delim](const char *p, const char *end) {
+                    return delim.find(p, end);
+                }, &count);
+
+                if (count != expected)
+                    std::cout << "(MISMATCH " << count << " vs " << expected << ")";
+            }
+            std::cout << "\n";
+        }
+    }
+
+    return 0;
+} catch (const std::exception& err) {
+    std::cerr << "Something went wrong and an exception was caught: " << err.what() << "\n";
+    return -1;
+} catch (...) {
+    std::cerr << "Something went wrong and an unknown exception was caught.\n";
+    return -1;
+}
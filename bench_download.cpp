@@ -0,0 +1,211 @@
+#include <iostream>
+#include "socket.h"
+#include "liberror.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <exception>
+
+/*
+ * Descarga HTTP/1.0 de varios GB a un archivo, como la hace get_page
+ * (vease download() en get_page.cpp), comparando tres formas de
+ * escribir el body:
+ *
+ *  - recvsome(): recv() a un buffer nuestro y write() al archivo (dos
+ *    copias por byte)
+ *  - recv_to_fd(): splice() del socket al archivo sin pasar por
+ *    user-space (vease socket.h), hasta que el server cierra
+ *  - recv_to_fd() con el Content-Length: lo mismo, pero sabiendo el
+ *    tamaño de antemano el archivo se pre-reserva con fallocate()
+ *
+ * El server es otro proceso (fork()) que responde con Content-Length y
+ * un body de MB megabytes. Con MB > 4096 ademas se prueba que los
+ * tamaños y offsets de 64 bits no se truncan en ningun lado.
+ *
+ * Al final se verifica el tamaño del archivo. El archivo queda en el
+ * page cache: se mide la red local + el kernel, no el disco.
+ *
+ * Uso:
+ *
+ *  ./bench_download <MB> [<output-file>]
+ *
+ *  ./bench_download 4200 /tmp/bench_download.out
+ * */
+
+static const size_t CHUNK = 1 << 20;
+
+static void server(Socket& srv, long long total, int downloads) {
+    std::vector<char> data(CHUNK);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = (char)(i * 31);
+
+    const std::string headers = "HTTP/1.0 200 OK\r\nContent-Length: " + std::to_string(total) + "\r\n\r\n";
+
+    bool was_closed = false;
+    for (int i = 0; i < downloads; ++i) {
+        Socket peer = srv.accept();
+
+        // El request no nos importa: leemos hasta el fin de los headers
+        std::string req;
+        char buf[512];
+        while (req.find("\r\n\r\n") == std::string::npos) {
+            int n = peer.recvsome(buf, sizeof(buf), &was_closed);
+            if (was_closed)
+                throw std::runtime_error("Unexpected closed");
+            req.append(buf, n);
+        }
+
+        peer.sendall(headers.data(), headers.size(), &was_closed);
+        for (long long sent = 0; sent < total;) {
+            size_t n = std::min((long long)CHUNK, total - sent);
+            peer.sendall(data.data(), n, &was_closed);
+            if (was_closed)
+                throw std::runtime_error("Unexpected closed");
+            sent += n;
+        }
+    }
+}
+
+enum Method { RECVSOME, RECV_TO_FD, RECV_TO_FD_PREALLOCATED };
+
+static const char *method_names[] = {
+    "recvsome              ",
+    "recv_to_fd            ",
+    "recv_to_fd (fallocate)",
+};
+
+/*
+ * Pide el archivo y se queda con la respuesta. Los headers son chicos
+ * y el server los manda antes que el body, asi que los leemos de a uno
+ * hasta el \r\n\r\n (el body queda entero para el metodo a medir).
+ * */
+static long long download(const char *filename, Method method) {
+    Socket skt("127.0.0.1", "3137");
+    bool was_closed = false;
+
+    const std::string req = "GET /big HTTP/1.0\r\nAccept: */*\r\nHost: 127.0.0.1\r\n\r\n";
+    skt.sendall(req.data(), req.size(), &was_closed);
+
+    std::string headers;
+    while (headers.size() < 4 or headers.compare(headers.size() - 4, 4, "\r\n\r\n") != 0) {
+        char c;
+        skt.recvall(&c, 1, &was_closed);
+        if (was_closed)
+            throw std::runtime_error("Unexpected closed");
+        headers += c;
+    }
+
+    int fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        throw LibError(errno, "Cannot open '%s': ", filename);
+
+    long long total = 0;
+    try {
+        if (method == RECV_TO_FD) {
+            total = skt.recv_to_fd(fd, -1, &was_closed);
+        } else if (method == RECV_TO_FD_PREALLOCATED) {
+            const char *cl = strstr(headers.c_str(), "Content-Length: ");
+            if (not cl)
+                throw std::runtime_error("Missing Content-Length");
+            total = skt.recv_to_fd(fd, atoll(cl + 16), &was_closed);
+        } else {
+            std::vector<char> buf(CHUNK);
+            while (true) {
+                int n = skt.recvsome(buf.data(), buf.size(), &was_closed);
+                if (was_closed)
+                    break;
+                for (int off = 0; off < n;) {
+                    ssize_t w = ::write(fd, buf.data() + off, n - off);
+                    if (w == -1) {
+                        if (errno == EINTR)
+                            continue;
+                        throw LibError(errno, "write failed: ");
+                    }
+                    off += w;
+                }
+                total += n;
+            }
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    return total;
+}
+
+int main(int argc, char *argv[]) try {
+    if (argc != 2 and argc != 3) {
+        std::cerr << "Bad program call. Expected " << argv[0] << " <MB> [<output-file>]\n";
+        return -1;
+    }
+
+    const long long total = atoll(argv[1]) * 1024 * 1024;
+    const char *filename = argc == 3 ? argv[2] : "bench_download.out";
+    const Method methods[] = { RECVSOME, RECV_TO_FD, RECV_TO_FD_PREALLOCATED };
+    const int downloads = sizeof(methods) / sizeof(methods[0]);
+
+    // El listener se crea antes del fork(): cuando nos conectemos el
+    // server ya esta escuchando
+    Socket srv("3137");
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        std::cerr << "fork failed\n";
+        return -1;
+    }
+
+    if (pid == 0) {
+        int ret = 0;
+        try {
+            server(srv, total, downloads);
+        } catch (const std::exception& err) {
+            std::cerr << "Server failed: " << err.what() << "\n";
+            ret = -1;
+        }
+        _exit(ret);
+    }
+
+    int ret = 0;
+    for (Method method : methods) {
+        auto begin = std::chrono::steady_clock::now();
+        long long n = download(filename, method);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        struct stat st;
+        if (stat(filename, &st) == -1)
+            throw LibError(errno, "Cannot stat '%s': ", filename);
+
+        bool ok = n == total and st.st_size == total;
+        if (not ok)
+            ret = -1;
+
+        std::cout << method_names[method] << ": "
+                  << n / 1e6 << " MB in " << elapsed << " s, "
+                  << n / 1e6 / elapsed << " MB/s"
+                  << (ok ? "" : " (SIZE MISMATCH)") << "\n";
+    }
+
+    unlink(filename);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (not WIFEXITED(status) or WEXITSTATUS(status) != 0)
+        ret = -1;
+    return ret;
+} catch (const std::exception& err) {
+    std::cerr << "Something went wrong and an exception was caught: " << err.what() << "\n";
+    return -1;
+} catch (...) {
+    std::cerr << "Something went wrong and an unknown exception was caught.\n";
+    return -1;
+}
@@ -0,0 +1,167 @@
+#include <iostream>
+#include "socket.h"
+#include "mux.h"
+#include "histogram.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <exception>
+
+/*
+ * Benchmark de Mux: N streams "chicos" hacen ping-pong de 64 bytes
+ * contra un echo (un thread por stream del lado del server) sobre una
+ * unica conexion TCP, primero solos y despues mientras otro stream de
+ * la misma conexion transfiere MB megabytes (ida y vuelta).
+ *
+ * Con el interleaving de frames la latencia de los streams chicos no
+ * deberia depender de la transferencia grande: sin multiplexar (todo
+ * en orden sobre el mismo Socket) cada ping-pong esperaria detras de
+ * todo lo que la transferencia haya encolado.
+ *
+ * Uso:
+ *
+ *  ./bench_mux <streams> <MB>
+ *
+ *  ./bench_mux 16 256
+ * */
+
+static const int PINGS = 2000;
+
+static void echo(Mux::Stream stream) try {
+    char buf[16 * 1024];
+    bool was_closed = false;
+    while (true) {
+        int n = stream.recvsome(buf, sizeof(buf), &was_closed);
+        if (was_closed)
+            break;
+        stream.sendall(buf, n, &was_closed);
+    }
+} catch (const std::exception& err) {
+    std::cerr << "Echo stream failed: " << err.what() << "\n";
+}
+
+static void server(Socket& srv) {
+    Socket peer = srv.accept();
+    std::vector<std::thread> threads;
+    {
+        Mux mux(peer, false);
+        try {
+            while (true)
+                threads.emplace_back(echo, mux.accept());
+        } catch (const std::runtime_error&) {
+            // El cliente cerro la conexion
+        }
+
+        for (auto& th : threads)
+            th.join();
+    }
+}
+
+static void ping(Mux& mux, Histogram& latency) {
+    Mux::Stream stream = mux.open();
+    char msg[64] = {0};
+    bool was_closed = false;
+
+    for (int i = 0; i < PINGS; ++i) {
+        auto begin = std::chrono::steady_clock::now();
+        stream.sendall(msg, sizeof(msg), &was_closed);
+        stream.recvall(msg, sizeof(msg), &was_closed);
+        latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - begin).count());
+    }
+}
+
+static void bulk(Mux& mux, size_t sz, double *mbps) {
+    Mux::Stream stream = mux.open();
+    auto begin = std::chrono::steady_clock::now();
+
+    // Un thread envia y otro recibe el echo: si solo enviaramos, el
+    // server se bloquearia al llenarse nuestra ventana
+    std::thread sender([&stream, sz] {
+        std::vector<char> chunk(64 * 1024, 'x');
+        bool was_closed = false;
+        for (size_t sent = 0; sent < sz; sent += chunk.size())
+            stream.sendall(chunk.data(), std::min(chunk.size(), sz - sent), &was_closed);
+        stream.close();
+    });
+
+    std::vector<char> buf(64 * 1024);
+    bool was_closed = false;
+    size_t received = 0;
+    while (true) {
+        int n = stream.recvsome(buf.data(), buf.size(), &was_closed);
+        if (was_closed)
+            break;
+        received += n;
+    }
+    sender.join();
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    *mbps = 2 * received / elapsed / 1e6;
+}
+
+static void bench(int streams, size_t bulk_sz) {
+    Socket srv("3133");
+    std::thread srv_th(server, std::ref(srv));
+
+    Socket skt("127.0.0.1", "3133");
+    std::vector<Histogram> latencies(streams);
+    double mbps = 0;
+    {
+        Mux mux(skt, true);
+
+        std::unique_ptr<std::thread> bulk_th;
+        if (bulk_sz)
+            bulk_th.reset(new std::thread(bulk, std::ref(mux), bulk_sz, &mbps));
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < streams; ++i)
+            threads.emplace_back(ping, std::ref(mux), std::ref(latencies[i]));
+        for (auto& th : threads)
+            th.join();
+
+        if (bulk_th)
+            bulk_th->join();
+    }
+    srv_th.join();
+
+    Histogram total;
+    for (auto& h : latencies)
+        total.merge(h);
+
+    std::cout << (bulk_sz ? "with bulk   " : "without bulk")
+              << ": " << streams << " streams over 1 connection"
+              << ", ping p50 " << total.percentile(50) / 1000.0 << " us"
+              << ", p99 " << total.percentile(99) / 1000.0 << " us";
+    if (bulk_sz)
+        std::cout << ", bulk " << mbps << " MB/s (both directions)";
+    std::cout << "\n";
+}
+
+int main(int argc, char *argv[]) try {
+    if (argc != 3) {
+        std::cerr << "Bad program call. Expected " << argv[0] << " <streams> <MB>\n";
+        return -1;
+    }
+
+    int streams = atoi(argv[1]);
+    size_t sz = (size_t)atoi(argv[2]) * 1024 * 1024;
+
+    bench(streams, 0);
+    bench(streams, sz);
+
+    return 0;
+} catch (const std::exception& err) {
+    std::cerr << "Something went wrong and an exception was caught: " << err.what() << "\n";
+    return -1;
+} catch (...) {
+    std::cerr << "Something went wrong and an unknown exception was caught.\n";
+    return -1;
+}
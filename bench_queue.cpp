@@ -0,0 +1,160 @@
+#include <iostream>
+#include "channel.h"
+#include "poller.h"
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include <exception>
+
+/*
+ * Benchmark: cuantos items por segundo pasan de P productores a un
+ * consumidor usando
+ *
+ *  - un Channel (MpscQueue lock-free + EventFd + Poller), y
+ *  - una cola clasica con std::mutex + std::condition_variable.
+ *
+ * Es el mismo patron que un aceptador (o varios) pasandole Sockets a un
+ * worker: aca pasamos enteros para medir solo el costo de la cola.
+ *
+ * Uso:
+ *
+ *  ./bench_queue <producers> <items>
+ * */
+
+/*
+ * Cola acotada con mutex, la "de libro", para comparar.
+ * */
+class LockedQueue {
+    std::queue<long> q;
+    const size_t capacity;
+    std::mutex mtx;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+
+    public:
+    explicit LockedQueue(size_t capacity) : capacity(capacity) {}
+
+    void push(long item) {
+        std::unique_lock<std::mutex> lck(mtx);
+        while (q.size() >= capacity)
+            not_full.wait(lck);
+
+        q.push(item);
+        not_empty.notify_one();
+    }
+
+    long pop() {
+        std::unique_lock<std::mutex> lck(mtx);
+        while (q.empty())
+            not_empty.wait(lck);
+
+        long item = q.front();
+        q.pop();
+        not_full.notify_one();
+        return item;
+    }
+};
+
+static double bench_locked(int producers, long items) {
+    LockedQueue queue(1024);
+    long per_producer = items / producers;
+
+    auto begin = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.push_back(std::thread([&queue, per_producer] {
+            for (long i = 0; i < per_producer; ++i)
+                queue.push(i);
+        }));
+    }
+
+    long sum = 0;
+    for (long i = 0; i < per_producer * producers; ++i)
+        sum += queue.pop();
+
+    for (auto& th : threads)
+        th.join();
+
+    auto end = std::chrono::steady_clock::now();
+    (void)sum;
+    return per_producer * producers / std::chrono::duration<double>(end - begin).count();
+}
+
+static double bench_channel(int producers, long items) {
+    Channel<long> channel(1024);
+    long per_producer = items / producers;
+
+    auto begin = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.push_back(std::thread([&channel, per_producer] {
+            for (long i = 0; i < per_producer; ++i) {
+                long item = i;
+                // Si esta llena le cedemos el CPU al consumidor
+                while (not channel.try_push(item))
+                    std::this_thread::yield();
+            }
+        }));
+    }
+
+    // El consumidor se bloquea solo en el Poller, como lo haria un
+    // worker que ademas atiende sockets.
+    Poller poller;
+    poller.add(channel.event(), nullptr);
+    Poller::Event events[1];
+
+    long sum = 0;
+    long received = 0;
+    while (received < per_producer * producers) {
+        long item;
+        while (channel.try_pop(item)) {
+            sum += item;
+            ++received;
+        }
+
+        if (received == per_producer * producers or not channel.sleep())
+            continue;
+
+        poller.wait(events, 1, -1);
+        channel.awake();
+    }
+
+    for (auto& th : threads)
+        th.join();
+
+    auto end = std::chrono::steady_clock::now();
+    (void)sum;
+    return per_producer * producers / std::chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, char *argv[]) try {
+    if (argc != 3) {
+        std::cerr << "Bad program call. Expected " << argv[0] << " <producers> <items>\n";
+        return -1;
+    }
+
+    int producers = atoi(argv[1]);
+    long items = atol(argv[2]);
+    if (producers <= 0 or items <= 0) {
+        std::cerr << "producers and items must be positive\n";
+        return -1;
+    }
+
+    std::cout << "mutex+condvar: " << bench_locked(producers, items) / 1e6 << " M items/s\n";
+    std::cout << "channel:       " << bench_channel(producers, items) / 1e6 << " M items/s\n";
+    return 0;
+} catch (const std::exception& err) {
+    std::cerr << "Something went wrong and an exception was caught: " << err.what() << "\n";
+    return -1;
+} catch (...) {
+    std::cerr << "Something went wrong and an unknown exception was caught.\n";
+    return -1;
+}
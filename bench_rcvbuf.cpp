@@ -0,0 +1,150 @@
+#include <iostream>
+#include "socket.h"
+#include "recvbuffer.h"
+
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+#include <exception>
+
+/*
+ * Benchmark de buffers de recepcion: un cliente envia MB megabytes de
+ * mensajes por loopback y el server los lee con distintas estrategias:
+ *
+ *  - fixed 512: un buffer fijo de 512 bytes (lo que hacia echo_server)
+ *  - fixed 64K: un buffer fijo de 64 KiB
+ *  - adaptive: RecvBuffer (vease recvbuffer.h)
+ *  - adaptive+lowat: RecvBuffer manejando tambien el SO_RCVLOWAT,
+ *    hasta 16 KiB (vease RecvBuffer::set_max_lowat())
+ *
+ * con tres cargas:
+ *
+ *  - chatty: mensajes de 64 bytes
+ *  - bulk: mensajes de 64 KiB
+ *  - mixed: 95% de mensajes de 64 bytes y 5% de 64 KiB, al azar
+ *
+ * Por cada combinacion reporta:
+ *
+ *  - recv/MB: cuantos recvsome() hicieron falta por megabyte
+ *  - wakeups/MB: cuantas veces el thread lector se bloqueo y tuvo que
+ *    ser despertado (context switches voluntarios, getrusage())
+ *  - MB/s
+ *  - peak: el tamaño maximo que llego a tener el buffer
+ *
+ * Uso:
+ *
+ *  ./bench_rcvbuf <MB>
+ *
+ *  ./bench_rcvbuf 256
+ * */
+
+static const size_t SMALL = 64;
+static const size_t LARGE = 64 * 1024;
+static const int LOWAT = 16 * 1024;
+
+/*
+ * Tamaños de los mensajes de la carga: el mismo para todas las
+ * estrategias (semilla fija).
+ * */
+static std::vector<size_t> workload(const char *name, size_t total) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> pct(0, 99);
+    std::vector<size_t> sizes;
+
+    size_t sum = 0;
+    while (sum < total) {
+        size_t sz;
+        if (name[0] == 'c')
+            sz = SMALL;
+        else if (name[0] == 'b')
+            sz = LARGE;
+        else
+            sz = pct(rng) < 95 ? SMALL : LARGE;
+
+        sizes.push_back(sz);
+        sum += sz;
+    }
+    return sizes;
+}
+
+static void sender(Socket& skt, const std::vector<size_t>& sizes) {
+    std::vector<char> msg(LARGE, 'x');
+    bool was_closed = false;
+    for (size_t sz : sizes)
+        skt.sendall(msg.data(), sz, &was_closed);
+    skt.shutdown(SHUT_WR);
+}
+
+static long voluntary_switches() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) == -1)
+        return 0;
+    return usage.ru_nvcsw;
+}
+
+static void bench(const char *load, const char *mode, const std::vector<size_t>& sizes,
+        size_t min_size, size_t max_size, bool lowat) {
+    Socket srv("3134");
+    Socket client("127.0.0.1", "3134");
+    Socket peer = srv.accept();
+
+    RecvBuffer rbuf(min_size, max_size);
+    if (lowat)
+        rbuf.set_max_lowat(LOWAT);
+
+    auto begin = std::chrono::steady_clock::now();
+    long switches = voluntary_switches();
+    std::thread th(sender, std::ref(client), std::cref(sizes));
+
+    bool was_closed = false;
+    while (true) {
+        rbuf.recvsome(peer, &was_closed);
+        if (was_closed)
+            break;
+    }
+
+    switches = voluntary_switches() - switches;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    th.join();
+
+    const RecvBuffer::Stats& stats = rbuf.get_stats();
+    double mb = stats.bytes / 1e6;
+    std::cout << load << "\t" << mode
+              << "\t" << stats.reads / mb << " recv/MB"
+              << "\t" << switches / mb << " wakeups/MB"
+              << "\t" << mb / elapsed << " MB/s"
+              << "\tpeak " << stats.peak << " bytes\n";
+}
+
+int main(int argc, char *argv[]) try {
+    if (argc != 2) {
+        std::cerr << "Bad program call. Expected " << argv[0] << " <MB>\n";
+        return -1;
+    }
+
+    size_t total = (size_t)atoi(argv[1]) * 1024 * 1024;
+
+    const char *loads[] = { "chatty", "bulk  ", "mixed " };
+    for (const char *load : loads) {
+        std::vector<size_t> sizes = workload(load, total);
+
+        bench(load, "fixed 512     ", sizes, 512, 512, false);
+        bench(load, "fixed 64K     ", sizes, 64 * 1024, 64 * 1024, false);
+        bench(load, "adaptive      ", sizes, RecvBuffer::MIN_SIZE, RecvBuffer::MAX_SIZE, false);
+        bench(load, "adaptive+lowat", sizes, RecvBuffer::MIN_SIZE, RecvBuffer::MAX_SIZE, true);
+    }
+
+    return 0;
+} catch (const std::exception& err) {
+    std::cerr << "Something went wrong and an exception was caught: " << err.what() << "\n";
+    return -1;
+} catch (...) {
+    std::cerr << "Something went wrong and an unknown exception was caught.\n";
+    return -1;
+}
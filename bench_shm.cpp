@@ -0,0 +1,149 @@
+#include <iostream>
+#include "socket.h"
+#include "shmsocket.h"
+#include "shmlistener.h"
+#include "histogram.h"
+
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <exception>
+
+/*
+ * Benchmark de ShmSocket (vease shmsocket.h) contra TCP por loopback.
+ *
+ * El server es otro proceso (fork()) que hace echo de todo lo que
+ * recibe. El echo es un template: el mismo codigo sirve para Socket y
+ * para ShmSocket porque ambos tienen la misma API.
+ *
+ * Para cada transporte se mide:
+ *
+ *  - latencia: N ping-pongs de 64 bytes (p50 y p99)
+ *  - throughput: un thread envia MB megabytes en bloques de 64 KiB
+ *    mientras otro recibe el echo (MB/s en ambas direcciones)
+ *
+ * Uso:
+ *
+ *  ./bench_shm <pings> <MB>
+ *
+ *  ./bench_shm 100000 1024
+ * */
+
+static const char *SHM_PATH = "/tmp/bench_shm.sock";
+
+template <class S>
+static void echo(S& peer) {
+    std::vector<char> buf(64 * 1024);
+    bool was_closed = false;
+    while (true) {
+        int n = peer.recvsome(buf.data(), buf.size(), &was_closed);
+        if (was_closed)
+            break;
+        peer.sendall(buf.data(), n, &was_closed);
+        if (was_closed)
+            break;
+    }
+}
+
+template <class S>
+static void bench(const char *name, S& skt, int pings, size_t sz) {
+    char msg[64] = {0};
+    bool was_closed = false;
+
+    Histogram latency;
+    for (int i = 0; i < pings; ++i) {
+        auto begin = std::chrono::steady_clock::now();
+        skt.sendall(msg, sizeof(msg), &was_closed);
+        skt.recvall(msg, sizeof(msg), &was_closed);
+        latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - begin).count());
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    std::thread sender([&skt, sz] {
+        std::vector<char> chunk(64 * 1024, 'x');
+        bool was_closed = false;
+        for (size_t sent = 0; sent < sz; sent += chunk.size())
+            skt.sendall(chunk.data(), std::min(chunk.size(), sz - sent), &was_closed);
+        skt.shutdown(SHUT_WR);
+    });
+
+    std::vector<char> buf(64 * 1024);
+    size_t received = 0;
+    while (true) {
+        int n = skt.recvsome(buf.data(), buf.size(), &was_closed);
+        if (was_closed)
+            break;
+        received += n;
+    }
+    sender.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::cout << name << ": ping p50 " << latency.percentile(50) / 1000.0 << " us"
+              << ", p99 " << latency.percentile(99) / 1000.0 << " us"
+              << ", throughput " << 2 * received / elapsed / 1e6 << " MB/s (both directions)\n";
+}
+
+int main(int argc, char *argv[]) try {
+    if (argc != 3) {
+        std::cerr << "Bad program call. Expected " << argv[0] << " <pings> <MB>\n";
+        return -1;
+    }
+
+    int pings = atoi(argv[1]);
+    size_t sz = (size_t)atoi(argv[2]) * 1024 * 1024;
+
+    // Los listeners se crean antes del fork(): cuando el cliente se
+    // conecte el server ya esta escuchando
+    Socket srv("3135");
+    ShmListener shm_srv(SHM_PATH);
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        std::cerr << "fork failed\n";
+        return -1;
+    }
+
+    if (pid == 0) {
+        try {
+            Socket peer = srv.accept();
+            echo(peer);
+        } catch (const std::exception& err) {
+            std::cerr << "TCP echo failed: " << err.what() << "\n";
+        }
+
+        try {
+            ShmSocket peer = shm_srv.accept();
+            echo(peer);
+        } catch (const std::exception& err) {
+            std::cerr << "Shared memory echo failed: " << err.what() << "\n";
+        }
+
+        // Sin destructores: el listener y el path son del padre
+        _exit(0);
+    }
+
+    {
+        Socket skt("127.0.0.1", "3135");
+        bench("tcp loopback ", skt, pings, sz);
+    }
+    {
+        ShmSocket skt = ShmSocket::connect(SHM_PATH);
+        bench("shared memory", skt, pings, sz);
+    }
+
+    waitpid(pid, nullptr, 0);
+    return 0;
+} catch (const std::exception& err) {
+    std::cerr << "Something went wrong and an exception was caught: " << err.what() << "\n";
+    return -1;
+} catch (...) {
+    std::cerr << "Something went wrong and an unknown exception was caught.\n";
+    return -1;
+}
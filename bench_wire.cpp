@@ -0,0 +1,177 @@
+#include <iostream>
+#include "wire.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+#include <exception>
+
+/*
+ * Benchmark de serializacion: codifica y decodifica N mensajes de
+ * layout fijo con WireLayout (vease wire.h) y con una version escrita
+ * a mano (htonl() y memcpy() campo por campo con los offsets
+ * calculados a mano), reportando nanosegundos por mensaje.
+ *
+ * Los mensajes se codifican uno detras de otro en un buffer de 64 KiB,
+ * como se haria con el buffer que despues se envia con
+ * Socket::sendall(), y se decodifican desde ahi.
+ *
+ * Uso:
+ *
+ *  ./bench_wire <millions-of-messages>
+ *
+ *  ./bench_wire 20
+ * */
+
+enum class Side : uint8_t { BUY = 1, SELL = 2 };
+
+struct Quote {
+    uint32_t id;
+    uint64_t timestamp;
+    uint16_t venue;
+    Side side;
+    int32_t price;
+    int64_t quantity;
+    char symbol[8];
+};
+
+typedef WireLayout<Quote,
+        WIRE_FIELD(Quote, id),
+        WIRE_FIELD(Quote, timestamp),
+        WIRE_FIELD(Quote, venue),
+        WIRE_FIELD(Quote, side),
+        WIRE_FIELD(Quote, price),
+        WIRE_FIELD(Quote, quantity),
+        WIRE_FIELD(Quote, symbol)> QuoteWire;
+
+static_assert(QuoteWire::SIZE == 35, "4 + 8 + 2 + 1 + 4 + 8 + 8 bytes, sin padding");
+
+static char *encode_by_hand(const Quote& q, char *buf) {
+    uint32_t id = htonl(q.id);
+    uint64_t timestamp = htobe64(q.timestamp);
+    uint16_t venue = htons(q.venue);
+    uint32_t price = htonl((uint32_t)q.price);
+    uint64_t quantity = htobe64((uint64_t)q.quantity);
+
+    memcpy(buf, &id, 4);
+    memcpy(buf + 4, &timestamp, 8);
+    memcpy(buf + 12, &venue, 2);
+    buf[14] = (char)q.side;
+    memcpy(buf + 15, &price, 4);
+    memcpy(buf + 19, &quantity, 8);
+    memcpy(buf + 27, q.symbol, 8);
+    return buf + 35;
+}
+
+static const char *decode_by_hand(const char *buf, Quote& q) {
+    uint32_t id, price;
+    uint64_t timestamp, quantity;
+    uint16_t venue;
+
+    memcpy(&id, buf, 4);
+    memcpy(&timestamp, buf + 4, 8);
+    memcpy(&venue, buf + 12, 2);
+    q.side = (Side)buf[14];
+    memcpy(&price, buf + 15, 4);
+    memcpy(&quantity, buf + 19, 8);
+    memcpy(q.symbol, buf + 27, 8);
+
+    q.id = ntohl(id);
+    q.timestamp = be64toh(timestamp);
+    q.venue = ntohs(venue);
+    q.price = (int32_t)ntohl(price);
+    q.quantity = (int64_t)be64toh(quantity);
+    return buf + 35;
+}
+
+typedef char *(*Encoder)(const Quote&, char*);
+typedef const char *(*Decoder)(const char*, Quote&);
+
+/*
+ * Codifica n mensajes llenando el buffer una y otra vez y los
+ * decodifica. Retorna un checksum para que el compilador no descarte
+ * el trabajo (y para comparar ambas versiones).
+ * */
+template<Encoder encode, Decoder decode>
+static unsigned long long run(const char *name, const std::vector<Quote>& quotes, long n) {
+    std::vector<char> buf(64 * 1024);
+    const size_t per_buffer = buf.size() / 35;
+
+    unsigned long long checksum = 0;
+    double encode_ns = 0, decode_ns = 0;
+
+    for (long done = 0; done < n; done += per_buffer) {
+        size_t batch = std::min<long>(per_buffer, n - done);
+
+        auto t0 = std::chrono::steady_clock::now();
+        char *p = buf.data();
+        for (size_t i = 0; i < batch; ++i)
+            p = encode(quotes[(done + i) % quotes.size()], p);
+
+        auto t1 = std::chrono::steady_clock::now();
+        const char *q = buf.data();
+        Quote out;
+        for (size_t i = 0; i < batch; ++i) {
+            q = decode(q, out);
+            checksum += out.id + out.timestamp + out.venue + (int)out.side + out.price + out.quantity + out.symbol[0];
+        }
+        auto t2 = std::chrono::steady_clock::now();
+
+        encode_ns += std::chrono::duration<double, std::nano>(t1 - t0).count();
+        decode_ns += std::chrono::duration<double, std::nano>(t2 - t1).count();
+    }
+
+    std::cout << name << ": encode " << encode_ns / n << " ns/msg"
+              << ", decode " << decode_ns / n << " ns/msg"
+              << " (checksum " << checksum << ")\n";
+    return checksum;
+}
+
+int main(int argc, char *argv[]) try {
+    if (argc != 2) {
+        std::cerr << "Bad program call. Expected " << argv[0] << " <millions-of-messages>\n";
+        return -1;
+    }
+
+    long n = atol(argv[1]) * 1000000;
+
+    std::vector<Quote> quotes(1024);
+    for (size_t i = 0; i < quotes.size(); ++i) {
+        Quote& q = quotes[i];
+        q.id = i;
+        q.timestamp = 1700000000000000000ULL + i * 1000;
+        q.venue = i % 7;
+        q.side = i % 2 ? Side::BUY : Side::SELL;
+        q.price = 100000 - (int)i;
+        q.quantity = -(long long)i * 100;
+        memcpy(q.symbol, "ACME.BA ", 8);
+    }
+
+    // Verificamos que ambas codificaciones son identicas byte a byte
+    char a[QuoteWire::SIZE], b[QuoteWire::SIZE];
+    for (const Quote& q : quotes) {
+        QuoteWire::encode(q, a);
+        encode_by_hand(q, b);
+        if (memcmp(a, b, sizeof(a)) != 0)
+            throw std::runtime_error("WireLayout and the hand-written encoder disagree");
+    }
+
+    unsigned long long by_hand = run<encode_by_hand, decode_by_hand>("hand-written", quotes, n);
+    unsigned long long wire = run<QuoteWire::encode, QuoteWire::decode>("WireLayout  ", quotes, n);
+
+    if (by_hand != wire)
+        throw std::runtime_error("Checksums differ");
+
+    return 0;
+} catch (const std::exception& err) {
+    std::cerr << "Something went wrong and an exception was caught: " << err.what() << "\n";
+    return -1;
+} catch (...) {
+    std::cerr << "Something went wrong and an unknown exception was caught.\n";
+    return -1;
+}
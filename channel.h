@@ -0,0 +1,113 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <stddef.h>
+
+#include <atomic>
+
+#include "mpscqueue.h"
+#include "eventfd.h"
+
+/*
+ * Channel: una MpscQueue mas un EventFd para despertar al consumidor.
+ *
+ * Pensado para pasarle trabajo (por ejemplo, los Sockets que retorna
+ * Socket::accept()) a un thread que corre un loop con un Poller:
+ * el consumidor registra Channel::event() en su Poller y asi se despierta
+ * tanto por sus sockets como por items nuevos en el Channel.
+ *
+ * Hacer un EventFd::notify() en cada push seria una syscall por item.
+ * En cambio el consumidor avisa que se va a dormir (Channel::sleep())
+ * y solo en ese caso el productor lo despierta.
+ *
+ * El loop del consumidor queda asi:
+ *
+ *  while (...) {
+ *      while (channel.try_pop(item))
+ *          ...
+ *
+ *      if (not channel.sleep())
+ *          continue;           // llego algo justo antes de dormir
+ *
+ *      poller.wait(...);       // unico punto de bloqueo
+ *      channel.awake();
+ *      ...
+ *  }
+ * */
+template<class T>
+class Channel {
+    MpscQueue<T> queue;
+    EventFd efd;
+    std::atomic<bool> sleeping;
+
+    public:
+    explicit Channel(size_t capacity) : queue(capacity), sleeping(false) {}
+
+    /*
+     * Encola item (vease MpscQueue::try_push()) y si el consumidor
+     * estaba por dormirse lo despierta.
+     *
+     * Retorna false si el Channel esta lleno (item no se mueve).
+     * */
+    bool try_push(T& item) {
+        if (not this->queue.try_push(item))
+            return false;
+
+        // seq_cst: el push tiene que ser visible antes de leer sleeping
+        // (vease Channel::sleep())
+        if (this->sleeping.exchange(false))
+            this->efd.notify();
+
+        return true;
+    }
+
+    /*
+     * Despierta al consumidor aunque no haya items nuevos (por ejemplo,
+     * para pedirle que termine).
+     * */
+    void wakeup() {
+        this->sleeping.store(false);
+        this->efd.notify();
+    }
+
+    bool try_pop(T& item) {
+        return this->queue.try_pop(item);
+    }
+
+    /*
+     * El consumidor avisa que se va a bloquear. Retorna false si en el
+     * medio llego un item: en ese caso no hay que bloquearse sino volver
+     * a hacer try_pop().
+     *
+     * Marcamos sleeping *antes* de mirar la cola: o el productor ve
+     * sleeping == true y nos despierta, o nosotros vemos su item.
+     * Nunca pasa que ninguno de los dos se entere.
+     * */
+    bool sleep() {
+        this->sleeping.store(true);
+
+        if (not this->queue.empty()) {
+            this->sleeping.store(false);
+            return false;
+        }
+
+        return true;
+    }
+
+    /*
+     * El consumidor se desperto: consume el aviso del EventFd.
+     * */
+    void awake() {
+        this->sleeping.store(false);
+        this->efd.drain();
+    }
+
+    const EventFd& event() const {
+        return this->efd;
+    }
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+};
+
+#endif
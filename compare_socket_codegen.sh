@@ -0,0 +1,163 @@
+#!/bin/sh
+#
+# Compara el codigo generado para el camino caliente de Socket antes y
+# despues de parametrizarlo en familia y transporte (BasicSocket, vease
+# basicsocket.h).
+#
+# Compila con -O2 el socket.cpp anterior al template (sacado de git) y
+# las instancias de BasicSocket<Inet4, Stream> actuales, desensambla
+# sendsome(), recvsome(), sendall() y recvall() de cada uno (incluyendo
+# los clones .cold que gcc manda a .text.unlikely) y muestra el diff.
+#
+# El desensamblado se normaliza: sin direcciones, sin bytes, sin nops
+# de alineacion y con los destinos de los saltos y las relocations
+# reducidos a un placeholder. Asi lo que queda son las instrucciones.
+#
+# Las instrucciones no son identicas, y no tienen por que serlo: despues
+# del template cambio lo que hacen estas funciones. Las diferencias
+# esperadas son:
+#
+#  - sendsome/recvsome: con errno == EAGAIN retornan -1 en vez de lanzar
+#    (sockets no bloqueantes). Es un cmp y un salto que solo se ejecutan
+#    si send()/recv() ya fallo; el camino de exito no cambia (salvo la
+#    asignacion de registros: en recvsome hay un mov mas)
+#
+#  - sendall/recvall: tamaños de 64 bits, bloques de a lo sumo MAX_CHUNK
+#    y el progreso en done. Ademas sendall inlinea sendsome (una llamada
+#    menos por bloque)
+#
+# Lo que el template no debe agregar es dispatch en runtime por familia
+# o transporte. Eso es lo que se verifica: sale con 1 si el codigo
+# nuevo tiene llamadas o saltos indirectos, o llama a alguna funcion a
+# la que el Socket anterior no llamaba.
+#
+# Uso (desde el directorio del repo):
+#
+#  ./compare_socket_codegen.sh [<commit-anterior-al-template>]
+#
+# Con FULL=1 ademas se muestra el diff completo, en orden.
+#
+# Por default se usa el padre del commit que introdujo BasicSocket.
+
+set -e
+
+BASE=${1:-$(git log --format=%H --grep='^\[user-044\] Socket parametrizado' | tail -n 1)^}
+CXX=${CXX:-g++}
+CXXFLAGS="-std=c++14 -O2 -pedantic -Wall"
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+mkdir "$TMP/old"
+git archive "$BASE" -- '*.h' '*.cpp' | tar -x -C "$TMP/old"
+(cd "$TMP/old" && $CXX $CXXFLAGS -c socket.cpp -o "$TMP/old.o")
+
+# Instanciacion explicita miembro por miembro: instanciar la clase
+# entera no compila, porque los miembros que no aplican a Stream (como
+# sendto()) tienen un static_assert.
+cat > "$TMP/new.cpp" <<EOF
+#include "basicsocket.h"
+template int BasicSocket<Inet4, Stream>::sendsome(const void*, unsigned int, bool*);
+template int BasicSocket<Inet4, Stream>::recvsome(void*, unsigned int, bool*);
+template size_t BasicSocket<Inet4, Stream>::sendall(const void*, size_t, bool*, size_t*);
+template size_t BasicSocket<Inet4, Stream>::recvall(void*, size_t, bool*, size_t*);
+EOF
+$CXX $CXXFLAGS -I "$(pwd)" -c "$TMP/new.cpp" -o "$TMP/new.o"
+
+# disassemble <obj> <simbolo>: la funcion cuyo simbolo demangleado
+# termina en <simbolo> (con la firma, hay overloads) y su clone .cold,
+# normalizados
+disassemble() {
+    objdump -d -r -C --no-show-raw-insn "$1" | awk -v sym="$2" '
+        /^Disassembly of section/ { next }
+        /^[0-9a-f]+ <.*>:$/ {
+            p = (index($0, sym ">:") > 0 || index($0, sym " [clone .cold]>:") > 0)
+            next
+        }
+        p && NF {
+            sub(/^[ \t]*[0-9a-f]+:[ \t]*/, "")
+            if ($0 ~ /^R_X86/) {
+                # Socket es BasicSocket<Inet4, Stream>: es la misma funcion
+                sub(/^R_X86_64_[A-Z0-9_]+[ \t]*/, "reloc ")
+                sub(/-0x4$/, "")
+                gsub(/\.LC[0-9]+/, ".LC")
+                gsub(/\+0x[0-9a-f]+/, "")
+                gsub(/BasicSocket<InetFamily<2, sockaddr_in>, Stream>::/, "Socket::")
+            } else {
+                sub(/[0-9a-f]* *<.*$/, "<X>")
+            }
+            if ($0 ~ /^(nop|xchg   %ax,%ax|cs nopw|data16)/) next
+            if ($0 ~ /^jmp    <X>$/) next
+            print
+        }'
+}
+
+# Pares funcion|firma anterior|firma actual. sendall() y recvall()
+# pasaron a tamaños de 64 bits y a reportar el progreso en done (las
+# versiones de 3 argumentos solo llaman a estas).
+FUNCTIONS="
+sendsome|Socket::sendsome(void const*, unsigned int, bool*)|Stream>::sendsome(void const*, unsigned int, bool*)
+recvsome|Socket::recvsome(void*, unsigned int, bool*)|Stream>::recvsome(void*, unsigned int, bool*)
+sendall|Socket::sendall(void const*, unsigned int, bool*)|Stream>::sendall(void const*, unsigned long, bool*, unsigned long*)
+recvall|Socket::recvall(void*, unsigned int, bool*)|Stream>::recvall(void*, unsigned long, bool*, unsigned long*)
+"
+
+status=0
+while IFS='|' read -r f old_sym new_sym; do
+    [ -n "$f" ] || continue
+    disassemble "$TMP/old.o" "$old_sym" > "$TMP/old.$f"
+    disassemble "$TMP/new.o" "$new_sym" > "$TMP/new.$f"
+
+    old=$(wc -l < "$TMP/old.$f")
+    new=$(wc -l < "$TMP/new.$f")
+    if cmp -s "$TMP/old.$f" "$TMP/new.$f"; then
+        echo "$f: identical ($old instructions)"
+        continue
+    fi
+
+    # Si no son identicas, comparamos las instrucciones como multiset:
+    # que gcc cambie el orden de los bloques no es una diferencia real
+    sort "$TMP/old.$f" > "$TMP/old.$f.sorted"
+    sort "$TMP/new.$f" > "$TMP/new.$f.sorted"
+    if cmp -s "$TMP/old.$f.sorted" "$TMP/new.$f.sorted"; then
+        echo "$f: same $old instructions, different block order"
+    else
+        echo "$f: differs ($old -> $new instructions), only in old (-) / only in new (+):"
+        diff "$TMP/old.$f.sorted" "$TMP/new.$f.sorted" | grep '^[<>]' | sed 's/^</   -/; s/^>/   +/' || true
+    fi
+
+    if [ -n "$FULL" ]; then
+        diff -u "$TMP/old.$f" "$TMP/new.$f" | tail -n +3 || true
+    fi
+done <<EOF
+$FUNCTIONS
+EOF
+
+# calls <archivo>...: las funciones llamadas (la relocation que sigue a
+# cada call directo)
+calls() {
+    awk '/^reloc / && prev ~ /^call / { sub(/^reloc /, ""); print } { prev = $0 }' "$@" | sort -u
+}
+
+# Se compara contra todas las funciones anteriores juntas: que sendall
+# inlinee sendsome hace que llame a send(), y eso esta bien
+calls "$TMP"/old.* > "$TMP/old.calls"
+calls "$TMP"/new.* > "$TMP/new.calls"
+extra=$(comm -13 "$TMP/old.calls" "$TMP/new.calls")
+if [ -n "$extra" ]; then
+    echo "calls to functions the old Socket did not call:"
+    echo "$extra" | sed 's/^/   /'
+    status=1
+fi
+
+if grep -q '^\(call\|jmp\|notrack jmp\) *\*' "$TMP"/new.*; then
+    echo "indirect calls or jumps:"
+    grep -h '^\(call\|jmp\|notrack jmp\) *\*' "$TMP"/new.* | sed 's/^/   /'
+    status=1
+fi
+
+if [ $status -eq 0 ]; then
+    echo "no indirect calls and no new callees: no runtime dispatch"
+fi
+
+exit $status
@@ -0,0 +1,288 @@
+#include "compressedsocket.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "socket.h"
+#include "wire.h"
+
+enum BlockType : uint8_t {
+    RAW = 0,
+    DEFLATE = 1,
+};
+
+/*
+ * Header de cada bloque: tipo + largo en el cable + largo original
+ * */
+struct BlockHeader {
+    uint8_t type;
+    uint32_t wire_len;
+    uint32_t raw_len;
+};
+
+typedef WireLayout<BlockHeader,
+        WIRE_FIELD(BlockHeader, type),
+        WIRE_FIELD(BlockHeader, wire_len),
+        WIRE_FIELD(BlockHeader, raw_len)> BlockHeaderWire;
+
+static const unsigned int HEADER_SIZE = BlockHeaderWire::SIZE;
+static_assert(HEADER_SIZE == 9, "the CompressedSocket block header is 9 bytes long (see compressedsocket.h)");
+
+/*
+ * Un bloque "vale la pena" si se achica al menos un 10%. Si no, durante
+ * los siguientes SKIP_BLOCKS bloques ni intentamos comprimir: comprimir
+ * datos incomprimibles es gastar CPU para nada.
+ * */
+static const unsigned int SKIP_BLOCKS = 16;
+
+/*
+ * Ventana de 16 KiB y memLevel 7: deflate usa (1 << (14+2)) + (1 << (7+9))
+ * = 128 KiB e inflate ~16 KiB. Con los defaults (15, 8) serian 256 KiB
+ * por conexion a cambio de una compresion apenas mejor.
+ * */
+static const int WINDOW_BITS = 14;
+static const int MEM_LEVEL = 7;
+
+CompressedSocket::CompressedSocket(Socket& skt, int level) :
+    skt(skt), enabled(false), flush_delay(std::chrono::milliseconds::rep(DEFAULT_FLUSH_DELAY_MS)), in_pos(0), skip_blocks(0), stats() {
+    bool was_closed = false;
+
+    memset(&this->deflater, 0, sizeof(this->deflater));
+    memset(&this->inflater, 0, sizeof(this->inflater));
+
+    if (level < 0 or level > 9)
+        throw std::invalid_argument("Compression level must be between 0 and 9");
+
+    /*
+     * Handshake: cada uno envia "Z1" y el nivel que ofrece. No importa
+     * quien envia primero: ambos envian y despues ambos reciben.
+     * */
+    unsigned char hello[3] = { 'Z', '1', (unsigned char)level };
+    this->skt.sendall(hello, sizeof(hello), &was_closed);
+
+    unsigned char peer_hello[3];
+    this->skt.recvall(peer_hello, sizeof(peer_hello), &was_closed);
+    if (peer_hello[0] != 'Z' or peer_hello[1] != '1')
+        throw std::runtime_error("CompressedSocket handshake failed: unexpected hello");
+
+    if (level == 0 or peer_hello[2] == 0)
+        return;
+
+    if (deflateInit2(&this->deflater, level, Z_DEFLATED, WINDOW_BITS, MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw std::runtime_error("CompressedSocket deflateInit2 failed");
+
+    if (inflateInit2(&this->inflater, WINDOW_BITS) != Z_OK) {
+        deflateEnd(&this->deflater);
+        throw std::runtime_error("CompressedSocket inflateInit2 failed");
+    }
+
+    this->enabled = true;
+
+    // Reservamos todo de antemano: el peor caso de deflate esta acotado
+    // por deflateBound()
+    this->out_raw.reserve(BLOCK_SIZE);
+    this->out_frame.resize(HEADER_SIZE + deflateBound(&this->deflater, BLOCK_SIZE));
+    this->in_frame.reserve(this->out_frame.size());
+    this->in_raw.reserve(BLOCK_SIZE);
+}
+
+bool CompressedSocket::send_block(bool *was_closed) {
+    *was_closed = false;
+    const unsigned int raw_len = this->out_raw.size();
+    if (raw_len == 0)
+        return true;
+
+    uint8_t type = RAW;
+    unsigned int wire_len = raw_len;
+
+    if (this->skip_blocks == 0) {
+        auto begin = std::chrono::steady_clock::now();
+
+        deflateReset(&this->deflater);
+        this->deflater.next_in = (Bytef*)this->out_raw.data();
+        this->deflater.avail_in = raw_len;
+        this->deflater.next_out = (Bytef*)this->out_frame.data() + HEADER_SIZE;
+        this->deflater.avail_out = this->out_frame.size() - HEADER_SIZE;
+
+        // Con un buffer de salida de deflateBound() bytes, un unico
+        // deflate(Z_FINISH) siempre termina (Z_STREAM_END)
+        int s = deflate(&this->deflater, Z_FINISH);
+
+        this->stats.deflate_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - begin).count();
+
+        if (s == Z_STREAM_END and this->deflater.total_out < raw_len - raw_len / 10) {
+            type = DEFLATE;
+            wire_len = this->deflater.total_out;
+        } else {
+            this->skip_blocks = SKIP_BLOCKS;
+        }
+    } else {
+        --this->skip_blocks;
+    }
+
+    if (type == RAW)
+        memcpy(this->out_frame.data() + HEADER_SIZE, this->out_raw.data(), raw_len);
+
+    BlockHeaderWire::encode(BlockHeader{ type, wire_len, raw_len }, this->out_frame.data());
+
+    this->skt.sendall(this->out_frame.data(), HEADER_SIZE + wire_len, was_closed);
+    if (*was_closed)
+        return false;
+
+    ++(type == DEFLATE ? this->stats.deflated_blocks : this->stats.raw_blocks);
+    this->stats.wire_bytes += HEADER_SIZE + wire_len;
+    this->out_raw.clear();
+    return true;
+}
+
+bool CompressedSocket::recv_block(bool *was_closed) {
+    /*
+     * Leemos el primer byte con recvsome(): si el peer cerro la conexion
+     * entre bloques es un cierre "limpio". En cambio un cierre en el medio
+     * de un bloque es un error (recvall() lanza una excepcion).
+     * */
+    char buf[HEADER_SIZE];
+    this->skt.recvsome(buf, 1, was_closed);
+    if (*was_closed)
+        return false;
+
+    this->skt.recvall(buf + 1, HEADER_SIZE - 1, was_closed);
+
+    BlockHeader header;
+    BlockHeaderWire::decode(buf, header);
+    const uint32_t wire_len = header.wire_len;
+    const uint32_t raw_len = header.raw_len;
+
+    // Nunca confiar en lo que viene por la red: sin estos chequeos
+    // un peer podria hacernos reservar memoria sin limite.
+    if (raw_len > BLOCK_SIZE or wire_len > this->in_frame.capacity() or
+            (header.type == RAW and wire_len != raw_len) or (header.type != RAW and header.type != DEFLATE))
+        throw std::runtime_error("CompressedSocket received a corrupted block header");
+
+    this->in_raw.resize(raw_len);
+    this->in_pos = 0;
+
+    if (header.type == RAW) {
+        this->skt.recvall(this->in_raw.data(), raw_len, was_closed);
+        return true;
+    }
+
+    this->in_frame.resize(wire_len);
+    this->skt.recvall(this->in_frame.data(), wire_len, was_closed);
+
+    inflateReset(&this->inflater);
+    this->inflater.next_in = (Bytef*)this->in_frame.data();
+    this->inflater.avail_in = wire_len;
+    this->inflater.next_out = (Bytef*)this->in_raw.data();
+    this->inflater.avail_out = raw_len;
+
+    int s = inflate(&this->inflater, Z_FINISH);
+    if (s != Z_STREAM_END or this->inflater.total_out != raw_len)
+        throw std::runtime_error("CompressedSocket received a corrupted block");
+
+    return true;
+}
+
+int CompressedSocket::sendall(const void *data, unsigned int sz, bool *was_closed) {
+    if (not this->enabled)
+        return this->skt.sendall(data, sz, was_closed);
+
+    *was_closed = false;
+    const auto now = std::chrono::steady_clock::now();
+    const char *p = (const char*)data;
+    unsigned int left = sz;
+    while (left > 0) {
+        if (this->out_raw.empty())
+            this->out_since = now;
+
+        unsigned int n = std::min(left, BLOCK_SIZE - (unsigned int)this->out_raw.size());
+        this->out_raw.insert(this->out_raw.end(), p, p + n);
+        p += n;
+        left -= n;
+
+        if (this->out_raw.size() == BLOCK_SIZE and not this->send_block(was_closed))
+            return 0;
+    }
+
+    // Deadline: lo que queda en el buffer no espera a completar el bloque
+    // si ya lleva demasiado ahi (comparamos con el now de la entrada, asi
+    // hay una sola lectura del reloj por llamada)
+    if (not this->out_raw.empty() and now - this->out_since >= this->flush_delay
+            and not this->send_block(was_closed))
+        return 0;
+
+    this->stats.app_bytes += sz;
+    return sz;
+}
+
+int CompressedSocket::recvsome(void *data, unsigned int sz, bool *was_closed) {
+    if (not this->enabled)
+        return this->skt.recvsome(data, sz, was_closed);
+
+    *was_closed = false;
+
+    // Flush-on-idle: si vamos a esperar al peer, que nuestros datos
+    // pendientes ya esten en camino.
+    if (not this->send_block(was_closed))
+        return 0;
+
+    while (this->in_pos == this->in_raw.size()) {
+        if (not this->recv_block(was_closed))
+            return 0;
+    }
+
+    unsigned int n = std::min(sz, (unsigned int)this->in_raw.size() - this->in_pos);
+    memcpy(data, this->in_raw.data() + this->in_pos, n);
+    this->in_pos += n;
+    return n;
+}
+
+void CompressedSocket::flush(bool *was_closed) {
+    *was_closed = false;
+    if (this->enabled)
+        this->send_block(was_closed);
+}
+
+void CompressedSocket::set_flush_delay(unsigned int delay_ms) {
+    this->flush_delay = std::chrono::milliseconds(delay_ms);
+}
+
+int CompressedSocket::next_flush_ms() const {
+    if (this->out_raw.empty())
+        return -1;
+
+    auto deadline = this->out_since + this->flush_delay;
+    auto now = std::chrono::steady_clock::now();
+    if (now >= deadline)
+        return 0;
+
+    // Redondeamos para arriba: despertar un poco antes del deadline
+    // seria un poll() que no hace nada
+    auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count();
+    return (int)((left + 999) / 1000);
+}
+
+void CompressedSocket::flush_if_due(bool *was_closed) {
+    *was_closed = false;
+    if (this->next_flush_ms() == 0)
+        this->send_block(was_closed);
+}
+
+bool CompressedSocket::is_enabled() const {
+    return this->enabled;
+}
+
+const CompressedSocket::Stats& CompressedSocket::get_stats() const {
+    return this->stats;
+}
+
+CompressedSocket::~CompressedSocket() {
+    if (this->enabled) {
+        deflateEnd(&this->deflater);
+        inflateEnd(&this->inflater);
+    }
+}
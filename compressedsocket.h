@@ -0,0 +1,156 @@
+#ifndef COMPRESSED_SOCKET_H
+#define COMPRESSED_SOCKET_H
+
+#include <zlib.h>
+
+#include <chrono>
+#include <vector>
+
+class Socket;
+
+/*
+ * Capa de compresion (zlib) sobre una conexion.
+ *
+ * Si lo que enviamos es texto (logs, JSON, HTML) en un enlace lento,
+ * el tiempo de transferencia lo dominan los bytes en el cable: comprimir
+ * cambia un poco de CPU por muchos menos bytes.
+ *
+ * Ambos extremos deben envolver su Socket en un CompressedSocket. Al
+ * construirse se intercambian un "hello" con el nivel de compresion que
+ * cada uno ofrece: si alguno ofrece 0 la conexion queda sin compresion
+ * (y sin framing, los bytes pasan tal cual).
+ *
+ * Con compresion los datos viajan en bloques de a lo sumo BLOCK_SIZE
+ * bytes, cada uno precedido por un header de 9 bytes:
+ *
+ *      tipo (1 byte)   RAW o DEFLATE
+ *      largo en el cable (4 bytes, big endian)
+ *      largo original    (4 bytes, big endian)
+ *
+ * Cada bloque se comprime de forma independiente (deflateReset()): asi
+ * el emisor puede decidir bloque a bloque si vale la pena comprimir.
+ * Si un bloque no se achica lo suficiente (datos ya comprimidos, cifrados,
+ * aleatorios) se envia RAW y durante los siguientes bloques ni se intenta
+ * comprimir; despues se vuelve a probar.
+ *
+ * Memoria acotada: cada CompressedSocket usa ~128 KiB para zlib
+ * (ventana de 16 KiB, memLevel 7) mas dos buffers de BLOCK_SIZE.
+ *
+ * Flush: lo enviado con sendall() se acumula hasta completar un bloque.
+ * Para no dejar datos "colgados" en el buffer:
+ *
+ *  - antes de cada recvsome() se hace flush() (la aplicacion esta ociosa
+ *    hasta que responda el peer)
+ *
+ *  - deadline: si un sendall() encuentra datos en el buffer desde hace
+ *    mas de flush_delay_ms (vease set_flush_delay()) los envia aunque
+ *    el bloque no este completo. Un emisor que escribe de a poco nunca
+ *    retiene datos mas que eso.
+ *
+ *  - idle: CompressedSocket no tiene threads ni timers propios, asi que
+ *    si la aplicacion deja de llamar a sendall() y recvsome() nadie
+ *    envia el resto. Un event loop usa next_flush_ms() como timeout del
+ *    poll() y llama a flush_if_due() al despertar; un programa
+ *    bloqueante debe llamar a flush() antes de quedarse esperando otra
+ *    cosa.
+ *
+ * Tambien se puede llamar a flush() a mano.
+ * */
+class CompressedSocket {
+    public:
+    static const unsigned int BLOCK_SIZE = 64 * 1024;
+    static const unsigned int DEFAULT_FLUSH_DELAY_MS = 5;
+
+    /*
+     * Estadisticas del lado emisor: cuantos bytes nos dio la aplicacion,
+     * cuantos pusimos en el cable (incluyendo headers), cuantos bloques
+     * se comprimieron y cuantos se enviaron RAW, y el tiempo de CPU
+     * (aproximado por reloj) que paso comprimiendo.
+     * */
+    struct Stats {
+        unsigned long long app_bytes;
+        unsigned long long wire_bytes;
+        unsigned long long deflated_blocks;
+        unsigned long long raw_blocks;
+        unsigned long long deflate_ns;
+    };
+
+    private:
+    Socket& skt;
+    bool enabled;
+
+    z_stream deflater;
+    z_stream inflater;
+
+    std::vector<char> out_raw;      // datos de la aplicacion sin enviar
+    std::chrono::steady_clock::time_point out_since;  // desde cuando out_raw no esta vacio
+    std::chrono::milliseconds flush_delay;
+    std::vector<char> out_frame;    // header + bloque comprimido
+    std::vector<char> in_frame;     // bloque recibido
+    std::vector<char> in_raw;       // bloque recibido descomprimido
+    unsigned int in_pos;            // cuanto de in_raw ya leyo la aplicacion
+
+    unsigned int skip_blocks;
+    Stats stats;
+
+    bool send_block(bool *was_closed);
+    bool recv_block(bool *was_closed);
+
+    public:
+    /*
+     * Hace el handshake ofreciendo el nivel de compresion dado (1 a 9,
+     * 0 para no comprimir). Bloquea hasta recibir el hello del peer.
+     * */
+    CompressedSocket(Socket& skt, int level);
+
+    /*
+     * Misma semantica que Socket::sendall() y Socket::recvsome(), vease
+     * socket.h. sendall() puede retornar antes de que los datos esten
+     * en el cable (quedan en el buffer hasta el proximo flush).
+     * */
+    int sendall(const void *data, unsigned int sz, bool *was_closed);
+    int recvsome(void *data, unsigned int sz, bool *was_closed);
+
+    /*
+     * Envia lo que haya quedado en el buffer.
+     * */
+    void flush(bool *was_closed);
+
+    /*
+     * Cuanto puede quedar un dato en el buffer antes de que el proximo
+     * sendall() lo envie (por default DEFAULT_FLUSH_DELAY_MS). Con 0 cada
+     * sendall() envia lo que tenga: se pierde compresion en bloques
+     * chicos a cambio de latencia minima.
+     * */
+    void set_flush_delay(unsigned int delay_ms);
+
+    /*
+     * Para event loops: retorna en cuantos milisegundos vence el
+     * deadline de lo que hay en el buffer (0 si ya vencio) o -1 si no
+     * hay nada pendiente. Sirve directo como timeout de Poller::wait().
+     * */
+    int next_flush_ms() const;
+
+    /*
+     * Hace flush() solo si el deadline vencio.
+     * */
+    void flush_if_due(bool *was_closed);
+
+    /*
+     * Retorna si la compresion quedo habilitada tras el handshake.
+     * */
+    bool is_enabled() const;
+
+    const Stats& get_stats() const;
+
+    /*
+     * No se hace flush() en el destructor: podria fallar y no podemos
+     * lanzar excepciones desde un destructor. Hay que llamarlo antes.
+     * */
+    ~CompressedSocket();
+
+    CompressedSocket(const CompressedSocket&) = delete;
+    CompressedSocket& operator=(const CompressedSocket&) = delete;
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "delimiter.h"
+
+#include <string.h>
+
+#include <atomic>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DELIMITER_X86 1
+#endif
+
+typedef const char* (*ScanFn)(const char *p, const char *end, const char *delim, size_t len);
+
+/*
+ * Version escalar: byte a byte. Es la que se usa si no hay SIMD y
+ * tambien para la "cola" del buffer que no llena un vector entero.
+ * */
+static const char* find_scalar(const char *p, const char *end, const char *delim, size_t len) {
+    if ((size_t)(end - p) < len)
+        return nullptr;
+
+    const char *last = end - len;
+    for (; p <= last; ++p) {
+        if (p[0] == delim[0] and p[len - 1] == delim[len - 1] and memcmp(p, delim, len) == 0)
+            return p;
+    }
+
+    return nullptr;
+}
+
+#ifdef DELIMITER_X86
+/*
+ * Versiones SIMD. Ambas hacen lo mismo (vease delimiter.h) cambiando
+ * solo el ancho del vector: en cada vuelta
+ *
+ *  a = p[0..W)             comparado contra el primer byte
+ *  b = p[len-1..len-1+W)   comparado contra el ultimo byte
+ *
+ * y el AND de ambas comparaciones, pasado a una mascara de bits con
+ * movemask, marca las posiciones candidatas.
+ *
+ * El atributo target permite compilar AVX2 sin pasarle -mavx2 al
+ * compilador para todo el programa: solo estas funciones usan AVX2 y
+ * solo se llaman si el procesador lo soporta.
+ * */
+__attribute__((target("sse2")))
+static const char* find_sse2(const char *p, const char *end, const char *delim, size_t len) {
+    const __m128i first = _mm_set1_epi8(delim[0]);
+    const __m128i last = _mm_set1_epi8(delim[len - 1]);
+
+    while ((size_t)(end - p) >= 16 + len - 1) {
+        __m128i a = _mm_loadu_si128((const __m128i*)p);
+        __m128i b = _mm_loadu_si128((const __m128i*)(p + len - 1));
+        unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+
+        while (mask) {
+            int i = __builtin_ctz(mask);
+            if (len <= 2 or memcmp(p + i + 1, delim + 1, len - 2) == 0)
+                return p + i;
+            mask &= mask - 1;
+        }
+
+        p += 16;
+    }
+
+    return find_scalar(p, end, delim, len);
+}
+
+__attribute__((target("avx2")))
+static const char* find_avx2(const char *p, const char *end, const char *delim, size_t len) {
+    const __m256i first = _mm256_set1_epi8(delim[0]);
+    const __m256i last = _mm256_set1_epi8(delim[len - 1]);
+
+    while ((size_t)(end - p) >= 32 + len - 1) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)p);
+        __m256i b = _mm256_loadu_si256((const __m256i*)(p + len - 1));
+        unsigned int mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+
+        while (mask) {
+            int i = __builtin_ctz(mask);
+            if (len <= 2 or memcmp(p + i + 1, delim + 1, len - 2) == 0)
+                return p + i;
+            mask &= mask - 1;
+        }
+
+        p += 32;
+    }
+
+    // Lo que queda (menos de 32 bytes) todavia puede aprovechar SSE2
+    return find_sse2(p, end, delim, len);
+}
+#endif
+
+struct Implementation {
+    const char *name;
+    ScanFn fn;
+    bool supported;
+};
+
+/*
+ * Las implementaciones de la mejor a la peor.
+ * */
+static Implementation* implementations() {
+#ifdef DELIMITER_X86
+    __builtin_cpu_init();
+    static Implementation impls[] = {
+        { "avx2", find_avx2, (bool)__builtin_cpu_supports("avx2") },
+        { "sse2", find_sse2, (bool)__builtin_cpu_supports("sse2") },
+        { "scalar", find_scalar, true },
+        { nullptr, nullptr, false },
+    };
+#else
+    static Implementation impls[] = {
+        { "scalar", find_scalar, true },
+        { nullptr, nullptr, false },
+    };
+#endif
+    return impls;
+}
+
+static const char* resolve(const char *p, const char *end, const char *delim, size_t len);
+
+/*
+ * La implementacion elegida. Arranca apuntando a resolve() que en la
+ * primera llamada elige la mejor y se reemplaza a si misma: asi no
+ * dependemos del orden de inicializacion de variables estaticas ni
+ * pagamos un chequeo en cada llamada.
+ * */
+static std::atomic<ScanFn> scan(resolve);
+static std::atomic<const char*> scan_name("unresolved");
+
+static void select_best() {
+    for (Implementation *impl = implementations(); impl->name; ++impl) {
+        if (impl->supported) {
+            scan_name.store(impl->name);
+            scan.store(impl->fn);
+            return;
+        }
+    }
+}
+
+static const char* resolve(const char *p, const char *end, const char *delim, size_t len) {
+    select_best();
+    return scan.load(std::memory_order_relaxed)(p, end, delim, len);
+}
+
+Delimiter::Delimiter(const char *delim, size_t len) : len(len) {
+    if (len == 0 or len > sizeof(this->delim))
+        throw std::invalid_argument("Delimiter must have between 1 and 16 bytes");
+
+    memcpy(this->delim, delim, len);
+}
+
+const char* Delimiter::find(const char *begin, const char *end) const {
+    return scan.load(std::memory_order_relaxed)(begin, end, this->delim, this->len);
+}
+
+size_t Delimiter::size() const {
+    return this->len;
+}
+
+const char* Delimiter::implementation() {
+    if (scan.load() == resolve)
+        select_best();
+    return scan_name.load();
+}
+
+bool Delimiter::force(const char *name) {
+    for (Implementation *impl = implementations(); impl->name; ++impl) {
+        if (strcmp(impl->name, name) == 0 and impl->supported) {
+            scan_name.store(impl->name);
+            scan.store(impl->fn);
+            return true;
+        }
+    }
+
+    return false;
+}
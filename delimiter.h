@@ -0,0 +1,57 @@
+#ifndef DELIMITER_H
+#define DELIMITER_H
+
+#include <stddef.h>
+
+/*
+ * Buscador de delimitadores (\r\n, \r\n\r\n, \n, ...) en un buffer.
+ *
+ * Los protocolos de texto (HTTP, SMTP, Redis, ...) separan lineas y
+ * headers con delimitadores. Buscarlos byte a byte es lento cuando los
+ * headers llegan a decenas de GB/s: la mayor parte del tiempo se va en
+ * *descartar* bytes que no son el delimitador.
+ *
+ * Delimiter::find() usa instrucciones SIMD para mirar 16 (SSE2) o 32
+ * (AVX2) bytes a la vez:
+ *
+ *  - compara en paralelo cada posicion contra el *primer* byte del
+ *    delimitador y la posicion + len - 1 contra el *ultimo* byte;
+ *  - solo las posiciones que coinciden en ambos son candidatas y se
+ *    verifican con memcmp() (para \r\n\r\n, que haya \r y \n a 3 bytes
+ *    de distancia ya descarta casi todo).
+ *
+ * Cual de las implementaciones se usa se decide en runtime segun lo que
+ * soporte el procesador (el mismo binario corre en maquinas sin AVX2),
+ * con una version escalar para todo lo demas.
+ * */
+class Delimiter {
+    char delim[16];
+    size_t len;
+
+    public:
+    /*
+     * delim debe tener entre 1 y 16 bytes.
+     * */
+    Delimiter(const char *delim, size_t len);
+
+    /*
+     * Retorna un puntero al principio de la primera ocurrencia del
+     * delimitador en [begin, end) o nullptr si no esta.
+     * */
+    const char* find(const char *begin, const char *end) const;
+
+    size_t size() const;
+
+    /*
+     * Nombre de la implementacion en uso: "avx2", "sse2" o "scalar".
+     * */
+    static const char* implementation();
+
+    /*
+     * Fuerza una implementacion (util para benchmarks y para comparar
+     * resultados). Retorna false si el procesador no la soporta.
+     * */
+    static bool force(const char *name);
+};
+
+#endif
@@ -1,40 +1,336 @@
 #include <iostream>
 #include "socket.h"
+#include "handoff.h"
+#include "trace.h"
+#include "recorder.h"
+#include "worker.h"
+#include "httpconnection.h"
+#include "responsecache.h"
+#include "liberror.h"
+#include "affinity.h"
+#include "recvbuffer.h"
+#include "shmsocket.h"
+#include "shmlistener.h"
+#include "telemetryaggregator.h"
 
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
 #include <exception>
 /*
- * Este mini ejemplo escucha en el puerto 3129 TCP y acepta a un unico
- * cliente. Todo lo que el cliente envie el servidor se lo reenviara.
+ * Este mini ejemplo escucha en el puerto 3129 TCP y acepta clientes.
+ * Todo lo que un cliente envie el servidor se lo reenviara.
  *
  * Es un echo server!
  *
- * Esta codeado "a la C" por lo que veras muchas cosas hechas "a mano".
- * En particular veras como se manejan los errores en C con el uso de goto.
- *
  * Escribi mucho mas en get_page.cpp, podes mirar ahi los detalles.
  *
- * Este servidor es muy basico: solo acepta a un unico cliente.
- * Es tan basico que incluso no finaliza hasta q ese cliente se conecte
- * (no hay forma de cerrarlo ordenadamente)
- *
- * Cuando veamos threads podremos implementar servidores multi-clientes
- * y podremos cerrar todo en orden.
+ * El thread principal acepta clientes y se los reparte (round-robin)
+ * a N Workers (vease worker.h). Cada Worker es un thread que atiende
+ * a muchos clientes a la vez con un Poller.
  *
  * Si queres probar el server, corre en una consola:
  *
  *  nc 127.0.0.1 3129
  *
+ * La cantidad de Workers se puede elegir con -w (por default, uno por
+ * core):
+ *
+ *  ./echo_server -w 4
+ *
+ * O se puede dar una lista de CPUs con --cpus: se lanza un Worker fijado
+ * a cada uno y cada conexion va al Worker del CPU que recibe sus
+ * paquetes (vease affinity.h):
+ *
+ *  ./echo_server --cpus 0-3
+ *
+ * Modo HTTP
+ * ---------
+ *
+ * Con --http el server deja de ser un echo y pasa a ser un server
+ * HTTP/1.1 minimo que sirve los archivos de un directorio (y /health)
+ * desde un cache de respuestas pre-armadas (vease responsecache.h):
+ *
+ *  ./echo_server --http ./public
+ *  curl -v http://127.0.0.1:3129/health
+ *
+ * Con --http - solo se sirve /health.
+ *
+ * Hot restart
+ * -----------
+ *
+ * Si se le pasa un path, el server acepta ser reemplazado por otro
+ * proceso sin dejar de atender el puerto (vease handoff.h):
+ *
+ *  ./echo_server /tmp/echo.handoff         # proceso viejo
+ *  ./echo_server /tmp/echo.handoff         # proceso nuevo (otra consola)
+ *
+ * El proceso nuevo toma el listener del viejo y empieza a aceptar.
+ * El viejo deja de aceptar, espera a que sus clientes terminen y finaliza.
+ * Un cliente que se conecta y desconecta en loop durante el reemplazo
+ * no deberia ver ningun "connection refused" ni "connection reset".
+ *
+ * Tracing
+ * -------
+ *
+ * Las operaciones de los Sockets quedan registradas en memoria (vease
+ * trace.h). Para volcarlas al archivo echo_server.trace:
+ *
+ *  kill -USR1 <pid>
+ *  ./trace_dump echo_server.trace > trace.json
+ *
+ * El volcado tambien se hace si el server crashea.
+ *
+ * Grabacion de trafico
+ * --------------------
+ *
+ * Con --record todo lo que los clientes envian y reciben se graba en
+ * un archivo (vease recorder.h) que despues se puede reproducir contra
+ * otro server (o contra una version nueva de este) con replay:
+ *
+ *  ./echo_server --record traffic.rec
+ *  ./replay traffic.rec 127.0.0.1 3129 10
+ *
+ * Buffers de recepcion
+ * --------------------
+ *
+ * Cada conexion lee con un RecvBuffer que crece y se achica segun lo
+ * que recibe (vease recvbuffer.h). Con --rcvlowat ademas maneja el
+ * SO_RCVLOWAT de cada conexion, hasta esa cantidad de bytes: mientras
+ * el cliente envia mucho el Worker no se despierta hasta que haya un
+ * buffer lleno en cola (vease Socket::set_recv_lowat()). Un cliente que
+ * envia poco no se ve afectado, y al final de una transferencia lo que
+ * quede en cola se lee a lo sumo RecvBuffer::LOWAT_TIMEOUT_MS despues.
+ * Solo en modo echo:
+ *
+ *  ./echo_server --rcvlowat 16384
+ *
+ * Telemetria de transporte
+ * ------------------------
+ *
+ * Con --tcp-info cada Worker muestrea TCP_INFO de sus conexiones cada
+ * esa cantidad de segundos y al cerrarlas (vease tcptelemetry.h):
+ * loguea en stderr las conexiones outlier (con retransmisiones o RTT
+ * muy por encima de la mediana) y en cada intervalo un resumen JSON
+ * de todo el server con los histogramas de RTT, retransmisiones, tasa
+ * de entrega y bytes en vuelo:
+ *
+ *  ./echo_server --tcp-info 10
+ *
+ * Memoria compartida
+ * ------------------
+ *
+ * Con --shm el server ademas acepta clientes del mismo host por
+ * memoria compartida (vease shmsocket.h) en el path dado. Esos clientes
+ * los atienden los mismos Workers, junto con los de TCP:
+ *
+ *  ./echo_server --shm /tmp/echo.shm
+ *
+ * Solo en modo echo y sin hot restart (el path no se traspasa).
+ *
  **/
-int main() try {
-    int ret = -1;
-    bool was_closed = false;
+
+/*
+ * Una conexion del echo server: lo que recibe lo reenvia.
+ * */
+class EchoConnection : public PeerConnection<Socket> {
+    RecvBuffer rbuf;
+
+    public:
+    EchoConnection(Socket&& peer, int rcvlowat) : PeerConnection(std::move(peer)) {
+        if (rcvlowat > 1)
+            this->rbuf.set_max_lowat(rcvlowat);
+    }
+
+    /*
+     * Con el SO_RCVLOWAT subido lo que quede en cola al final de una
+     * transferencia no despierta al Worker: que nos llame igual
+     * (vease recvbuffer.h).
+     * */
+    virtual unsigned int read_timeout_ms() override {
+        return this->rbuf.lowat_timeout_ms();
+    }
+
+    virtual bool on_readable(char *, size_t) override {
+        bool was_closed = false;
+
+        /*
+         * Lo que el servidor recibe lo reenvia al cliente. Es un echo
+         * server despues de todo!
+         *
+         * Usamos socket_recvsome() por q no sabemos cuanto vamos a
+         * recibir exactamente. Para reenviarlo no usamos
+         * socket_sendall(): el socket es no bloqueante y un cliente
+         * que no lee trabaria a todo el Worker. Connection::send()
+         * envia lo que puede y encola el resto (vease worker.h).
+         * Si queres indagar mas podes ver la implementacion
+         * de tiburoncin pero te advierto, es heavy.
+         * https://github.com/eldipa/tiburoncin
+         *
+         * Notese que no hay un loop: el Worker nos llama cada vez que
+         * hay algo para leer, asi que un solo recvsome() no bloqueara.
+         *
+         * No usamos el buffer del Worker sino uno propio que se adapta:
+         * 512 bytes para un cliente que manda poco y hasta 256 KiB
+         * para uno que manda mucho (vease recvbuffer.h). Se reserva
+         * desde el thread del Worker asi que tambien queda en su nodo
+         * NUMA.
+         * */
+        int sz = this->rbuf.recvsome(this->peer, &was_closed);
+        if (was_closed)
+            return false;
+        if (sz < 0)
+            return true;    // al final no habia nada para leer
+
+        return this->send(this->rbuf.data(), sz);
+    }
+};
+
+/*
+ * El echo para un cliente por memoria compartida. Usa el buffer del
+ * Worker: los datos ya estan en memoria (en el ring), no hay un buffer
+ * del kernel que vaciar con menos syscalls como hace RecvBuffer.
+ * */
+class ShmEchoConnection : public PeerConnection<ShmSocket> {
+    public:
+    explicit ShmEchoConnection(ShmSocket&& peer) : PeerConnection(std::move(peer)) {}
+
+    virtual bool on_readable(char *buf, size_t len) override {
+        bool was_closed = false;
+
+        int sz = this->peer.recvsome(buf, len, &was_closed);
+        if (was_closed)
+            return false;
+        if (sz < 0)
+            return true;
+
+        return this->send(buf, sz);
+    }
+};
+
+static std::unique_ptr<Connection> new_shm_echo_connection(ShmSocket&& peer) {
+    return std::unique_ptr<Connection>(new ShmEchoConnection(std::move(peer)));
+}
+
+/*
+ * Un thread que acepta clientes por memoria compartida (--shm) y se los
+ * reparte round-robin a los Workers, como hace main() con los de TCP.
+ * */
+class ShmAcceptor {
+    ShmListener listener;
+    std::vector<std::unique_ptr<Worker>>& workers;
+    std::atomic<bool> stopping;
+    std::thread th;
+
+    void run() {
+        unsigned int next = 0;
+        const unsigned int nworkers = this->workers.size();
+        while (true) {
+            ShmSocket peer;
+            try {
+                peer = this->listener.accept();
+            } catch (const std::exception& err) {
+                if (this->stopping)
+                    return;
+                // Un cliente que fallo el establecimiento no nos detiene
+                std::cerr << "Shared memory client rejected: " << err.what() << "\n";
+                continue;
+            }
+
+            for (unsigned int tries = 1; not this->workers[next++ % nworkers]->give(peer); ++tries) {
+                if (tries % nworkers == 0)
+                    std::this_thread::yield();
+            }
+        }
+    }
+
+    public:
+    ShmAcceptor(const char *path, std::vector<std::unique_ptr<Worker>>& workers) :
+        listener(path), workers(workers), stopping(false) {
+        this->th = std::thread(&ShmAcceptor::run, this);
+    }
+
+    void stop_and_join() {
+        if (not this->th.joinable())
+            return;
+
+        this->stopping = true;
+        this->listener.shutdown();
+        this->th.join();
+    }
+
+    ~ShmAcceptor() {
+        this->stop_and_join();
+    }
+
+    ShmAcceptor(const ShmAcceptor&) = delete;
+    ShmAcceptor& operator=(const ShmAcceptor&) = delete;
+};
+
+int main(int argc, char *argv[]) try {
+    unsigned int nworkers = std::thread::hardware_concurrency();
+    const char *handoff_path = nullptr;
+    const char *docroot = nullptr;
+    const char *record_path = nullptr;
+    const char *shm_path = nullptr;
+    std::vector<int> cpus;
+    int rcvlowat = 0;
+    unsigned int tcp_info_secs = 0;
+    bool http = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-w") == 0 and i + 1 < argc) {
+            nworkers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--http") == 0 and i + 1 < argc) {
+            http = true;
+            docroot = strcmp(argv[++i], "-") == 0 ? nullptr : argv[i];
+        } else if (strcmp(argv[i], "--record") == 0 and i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--cpus") == 0 and i + 1 < argc) {
+            cpus = Affinity::parse(argv[++i]);
+        } else if (strcmp(argv[i], "--rcvlowat") == 0 and i + 1 < argc) {
+            rcvlowat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tcp-info") == 0 and i + 1 < argc) {
+            tcp_info_secs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shm") == 0 and i + 1 < argc) {
+            shm_path = argv[++i];
+        } else if (argv[i][0] != '-' and not handoff_path) {
+            handoff_path = argv[i];
+        } else {
+            std::cerr << "Bad program call. Expected " << argv[0] << " [-w <workers>] [--cpus <list>] [--rcvlowat <bytes>] [--tcp-info <seconds>] [--http <docroot>] [--record <file>] [--shm <path>] [<handoff-path>]\n";
+            return -1;
+        }
+    }
+
+    if (shm_path and (http or handoff_path)) {
+        std::cerr << "--shm can not be combined with --http or a handoff path\n";
+        return -1;
+    }
+
+    if (rcvlowat > 1 and http) {
+        std::cerr << "--rcvlowat can not be combined with --http\n";
+        return -1;
+    }
+
+    if (not cpus.empty())
+        nworkers = cpus.size();
+    if (nworkers == 0)
+        nworkers = 1;
+
+    Trace::dump_on_signals("echo_server.trace");
+
+    if (record_path)
+        Recorder::start(record_path);
 
     /*
      * Inicializamos nuestro socket "server" o "aceptador"
      * que usaremos para escuchar y aceptar conexiones entrantes.
      *
-     * En este mini-ejemplo tendremos un socket srv (server) y
-     * otro llamado peer que representara a nuestro cliente.
      * En general cualquier servidor real tendra N+1 sockets,
      * uno para escuchar y aceptar y luego N sockets para sus
      * N clientes.
@@ -45,57 +341,119 @@ int main() try {
      *
      * En general es una mala idea hardcodear IPs/puertos, aca esta
      * con fines didacticos.
+     *
+     * Si hay otro echo_server corriendo con el mismo handoff path,
+     * en vez de crear un listener nuevo tomamos el suyo.
      * */
-    Socket srv("3129");
+    Socket srv;
+    if (handoff_path) {
+        try {
+            srv = Handoff::takeover(handoff_path);
+        } catch (const LibError& err) {
+            // Nadie escuchando en el path: somos el primer proceso
+            if (err.error_code != ENOENT and err.error_code != ECONNREFUSED)
+                throw;
+            srv = Socket("3129");
+        }
+    } else {
+        srv = Socket("3129");
+    }
+
+    std::unique_ptr<Handoff> handoff;
+    if (handoff_path)
+        handoff.reset(new Handoff(handoff_path));
 
     /*
-     * Bloqueamos el programa hasta q haya una conexion entrante
-     * y sea aceptada. Hablaremos (send/recv) con ese cliente
-     * conectado en particular usando un socket distinto, el peer,
-     * construido dentro mismo de srv.accept() y movido aqui.
+     * El cache se arma una unica vez y despues es de solo lectura:
+     * todos los Workers lo comparten sin necesidad de locks.
      * */
-    Socket peer = srv.accept();
+    std::unique_ptr<ResponseCache> cache;
+    Worker::Factory factory = [rcvlowat](Socket&& peer) {
+        return std::unique_ptr<Connection>(new EchoConnection(std::move(peer), rcvlowat));
+    };
+    if (http) {
+        cache.reset(new ResponseCache(docroot));
+
+        const ResponseCache& c = *cache;
+        factory = [&c](Socket&& peer) {
+            return std::unique_ptr<Connection>(new HttpConnection(std::move(peer), c));
+        };
+    }
 
     /*
-     * A partir de aqui podriamos volver a usar srv para aceptar
-     * nuevos clientes a la vez q hablamos con peer pero
-     * en este mini-ejemplo nos quedaremos con algo simple
-     * de un solo cliente.
+     * Con --cpus cada Worker se fija a uno de los CPUs y recordamos que
+     * Worker corre en cada CPU para darle las conexiones que llegan ahi.
      * */
+    TelemetryAggregator telemetry(tcp_info_secs * 1000);
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<int> worker_of_cpu;
+    for (unsigned int i = 0; i < nworkers; ++i) {
+        workers.push_back(std::unique_ptr<Worker>(new Worker(factory, 1024)));
+        if (not cpus.empty()) {
+            workers.back()->set_cpus(std::vector<int>(1, cpus[i]));
+            if ((size_t)cpus[i] >= worker_of_cpu.size())
+                worker_of_cpu.resize(cpus[i] + 1, -1);
+            worker_of_cpu[cpus[i]] = i;
+        }
+        workers.back()->set_tcp_info(tcp_info_secs * 1000, &telemetry);
+        workers.back()->set_shm_factory(new_shm_echo_connection);
+        workers.back()->start();
+    }
+
+    std::unique_ptr<ShmAcceptor> shm_acceptor;
+    if (shm_path)
+        shm_acceptor.reset(new ShmAcceptor(shm_path, workers));
 
-    char buf[512];
-    while (not was_closed) {
+    unsigned int next = 0;
+    while (true) {
         /*
-         * Loop principal: lo que el servidor recibe lo reenvia
-         * al cliente. Es un echo server despues de todo!
-         *
-         * Usamos socket_recvsome() por q no sabemos cuanto vamos a
-         * recibir exactamente pero usamos socket_sendall() por
-         * que sabemos cuanto queremos enviar.
-         *
-         * Podriamos usar tambien socket_sendsome() para hacer
-         * ciertas optimizaciones pero aca nos quedamos con la
-         * version simple (y facil de entender).
-         * Si queres indagar mas podes ver la implementacion
-         * de tiburoncin pero te advierto, es heavy.
-         * https://github.com/eldipa/tiburoncin
-         *
-         * Pregunta: por que usamos sizeof(buf) en este socket_recvsome()
-         * pero usamos sizeof(buf)-1 en el socket_recvsome() de get_page.cpp?
+         * Si somos reemplazables esperamos a que haya un cliente
+         * o a que un proceso nuevo pida el listener. En este ultimo
+         * caso dejamos de aceptar.
          * */
-        int sz = peer.recvsome(buf, sizeof(buf), &was_closed);
-
-        if (was_closed)
+        if (handoff and not handoff->wait(srv))
             break;
 
-        peer.sendall(buf, sz, &was_closed);
+        /*
+         * Bloqueamos el programa hasta q haya una conexion entrante
+         * y sea aceptada. Hablaremos (send/recv) con ese cliente
+         * conectado en particular usando un socket distinto, el peer,
+         * construido dentro mismo de srv.accept() y movido aqui.
+         * */
+        Socket peer = srv.accept();
 
-        if (was_closed)
-            break;
+        /*
+         * Si hay un Worker fijado al CPU que recibio los paquetes de
+         * esta conexion (SO_INCOMING_CPU) se la damos a el: asi el kernel
+         * y el Worker comparten caches.
+         * */
+        int cpu = peer.incoming_cpu();
+        if (cpu >= 0 and (size_t)cpu < worker_of_cpu.size() and worker_of_cpu[cpu] >= 0 and
+                workers[worker_of_cpu[cpu]]->give(peer))
+            continue;
+
+        /*
+         * Si no, se lo damos al siguiente Worker. Si su Channel esta lleno
+         * probamos con el siguiente; si estan todos llenos le cedemos
+         * el CPU a los Workers para que se pongan al dia.
+         * */
+        for (unsigned int tries = 1; not workers[next++ % nworkers]->give(peer); ++tries) {
+            if (tries % nworkers == 0)
+                std::this_thread::yield();
+        }
     }
 
-    ret = 0;
+    /*
+     * Drenamos: esperamos a que los clientes que ya teniamos terminen.
+     * */
+    if (shm_acceptor)
+        shm_acceptor->stop_and_join();
+
+    for (auto& worker : workers)
+        worker->stop_and_join();
 
+    telemetry.flush();
+    Recorder::stop();
 
     // Por que instanciamos el Socket en el stack, cuando la funcion main()
     // termine se llamara al destructor de Socket automaticamente
@@ -103,7 +461,7 @@ int main() try {
     // las cosas.
     // Esto sucede incluso si se lanzo una excepcion.
     // Este es el poder de RAII (Resource Acquisition is Initialization)
-    return ret;
+    return 0;
 } catch (const std::exception& err) {
     std::cerr << "Something went wrong and an exception was caught: " << err.what() << "\n";
     return -1;
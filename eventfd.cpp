@@ -0,0 +1,43 @@
+#include <errno.h>
+#include <stdint.h>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "eventfd.h"
+#include "liberror.h"
+
+EventFd::EventFd() {
+    // No bloqueante: drain() no debe bloquearse si no hubo notify()
+    this->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (this->fd == -1)
+        throw LibError(errno, "EventFd eventfd failed: ");
+}
+
+void EventFd::notify() {
+    uint64_t one = 1;
+    ssize_t s;
+    do {
+        s = ::write(this->fd, &one, sizeof(one));
+    } while (s == -1 and errno == EINTR);
+
+    // EAGAIN significa que el contador esta al maximo: igual ya hay
+    // un despertar pendiente asi que no es un error.
+    if (s == -1 and errno != EAGAIN)
+        throw LibError(errno, "EventFd notify failed: ");
+}
+
+void EventFd::drain() {
+    uint64_t count;
+    ssize_t s;
+    do {
+        s = ::read(this->fd, &count, sizeof(count));
+    } while (s == -1 and errno == EINTR);
+
+    if (s == -1 and errno != EAGAIN)
+        throw LibError(errno, "EventFd drain failed: ");
+}
+
+EventFd::~EventFd() {
+    ::close(this->fd);
+}
@@ -0,0 +1,42 @@
+#ifndef EVENT_FD_H
+#define EVENT_FD_H
+
+/*
+ * EventFd: un contador del kernel que se puede esperar con epoll.
+ *
+ * Sirve para despertar a un thread que esta bloqueado en
+ * Poller::wait(): otro thread llama a EventFd::notify() y el EventFd
+ * se vuelve "legible" para el Poller.
+ *
+ * Asi el Poller sigue siendo el *unico* lugar donde el thread se bloquea:
+ * espera a la vez por sus sockets y por avisos de otros threads.
+ *
+ * Lease man 2 eventfd
+ * */
+class EventFd {
+    int fd;
+
+    friend class Poller;
+
+    public:
+    EventFd();
+
+    /*
+     * Despierta a quien este esperando. Varios notify() seguidos
+     * se acumulan en un unico despertar.
+     * */
+    void notify();
+
+    /*
+     * Resetea el contador (consume los notify() pendientes) sin
+     * bloquearse si no habia ninguno.
+     * */
+    void drain();
+
+    ~EventFd();
+
+    EventFd(const EventFd&) = delete;
+    EventFd& operator=(const EventFd&) = delete;
+};
+
+#endif
@@ -0,0 +1,425 @@
+#include "fetcher.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <sys/socket.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <exception>
+
+#include "socket.h"
+#include "resolver.h"
+#include "liberror.h"
+#include "delimiter.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const Delimiter CRLF("\r\n", 2);
+static const Delimiter END_OF_HEADERS("\r\n\r\n", 4);
+
+static double ms_since(Clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+struct Fetcher::Host {
+    std::string hostname;
+    std::string servicename;
+
+    // Direcciones resueltas (cacheadas): sockaddr copiados tal cual
+    bool resolved;
+    std::vector<std::string> addrs;
+    std::string resolve_error;
+
+    std::deque<Fetch*> pending;
+    unsigned int active;
+    bool queued;    // esta en Fetcher::ready
+
+    Host(const std::string& hostname, const std::string& servicename) :
+        hostname(hostname), servicename(servicename), resolved(false), active(0), queued(false) {}
+};
+
+struct Fetcher::Fetch {
+    enum State { PENDING, CONNECTING, RECEIVING, DONE };
+
+    Result result;
+    Host *host;
+    std::string request;
+
+    State state;
+    Socket skt;
+    bool registered;
+    size_t addr_index;
+
+    Clock::time_point started;
+    Clock::time_point connect_started;
+    Clock::time_point sent;
+
+    // Headers de la respuesta (hasta encontrar el \r\n\r\n)
+    std::string headers;
+    size_t scanned;
+    bool body_started;
+    long long content_length;
+    int out_fd;
+
+    Fetch(const std::string& url, const std::string& output) :
+        result(), host(nullptr), state(PENDING), registered(false), addr_index(0),
+        scanned(0), body_started(false), content_length(-1), out_fd(-1) {
+        this->result.url = url;
+        this->result.output = output;
+    }
+
+    ~Fetch() {
+        if (this->out_fd != -1)
+            ::close(this->out_fd);
+    }
+};
+
+/*
+ * Separa http://host[:puerto][/path] en sus partes. Retorna false si la
+ * URL no tiene esa forma (solo soportamos http://).
+ * */
+static bool parse_url(const std::string& url, std::string *hostname, std::string *servicename, std::string *path) {
+    const std::string scheme = "http://";
+    if (url.compare(0, scheme.size(), scheme) != 0)
+        return false;
+
+    size_t begin = scheme.size();
+    size_t slash = url.find('/', begin);
+    std::string authority = url.substr(begin, slash == std::string::npos ? std::string::npos : slash - begin);
+    *path = slash == std::string::npos ? "/" : url.substr(slash);
+
+    size_t colon = authority.rfind(':');
+    if (colon == std::string::npos) {
+        *hostname = authority;
+        *servicename = "http";
+    } else {
+        *hostname = authority.substr(0, colon);
+        *servicename = authority.substr(colon + 1);
+    }
+
+    return not hostname->empty() and not servicename->empty();
+}
+
+/*
+ * Busca el header Content-Length (-1 si no esta) y el codigo de status
+ * de la primera linea.
+ * */
+static void parse_headers(const char *headers, const char *end, int *status, long long *content_length) {
+    const char name[] = "Content-Length:";
+    *status = 0;
+    *content_length = -1;
+
+    // "HTTP/1.x 200 OK"
+    const char *sp = (const char*)memchr(headers, ' ', end - headers);
+    if (sp)
+        *status = atoi(sp + 1);
+
+    for (const char *line = headers; line < end;) {
+        const char *eol = CRLF.find(line, end);
+        if (not eol)
+            break;
+
+        if ((size_t)(eol - line) > sizeof(name) - 1 and strncasecmp(line, name, sizeof(name) - 1) == 0)
+            *content_length = strtoll(line + sizeof(name) - 1, nullptr, 10);
+
+        line = eol + 2;
+    }
+}
+
+Fetcher::Fetcher(unsigned int max_inflight, unsigned int max_per_host, int timeout_ms) :
+    max_inflight(std::max(max_inflight, 1u)), max_per_host(std::max(max_per_host, 1u)),
+    timeout_ms(timeout_ms), on_done(nullptr) {}
+
+void Fetcher::add(const std::string& url, const std::string& output) {
+    this->fetches.emplace_back(new Fetch(url, output));
+    Fetch *f = this->fetches.back().get();
+
+    std::string hostname, servicename, path;
+    if (not parse_url(url, &hostname, &servicename, &path)) {
+        // Queda con host == nullptr: run() la reporta como fallida
+        f->result.error = "Malformed URL (expected http://host[:port][/path])";
+        return;
+    }
+
+    f->request = "GET " + path + " HTTP/1.0\r\nAccept: */*\r\nHost: " + hostname + "\r\n\r\n";
+
+    std::unique_ptr<Host>& host = this->hosts[hostname + ":" + servicename];
+    if (not host)
+        host.reset(new Host(hostname, servicename));
+
+    f->host = host.get();
+    host->pending.push_back(f);
+    if (not host->queued) {
+        host->queued = true;
+        this->ready.push_back(host.get());
+    }
+}
+
+void Fetcher::start(Fetch *f) {
+    Host *host = f->host;
+    f->started = Clock::now();
+    ++host->active;
+    this->inflight.push_back(f);
+
+    if (not host->resolved) {
+        host->resolved = true;
+        try {
+            Resolver resolver(host->hostname.c_str(), host->servicename.c_str(), false);
+            while (resolver.has_next()) {
+                struct addrinfo *addr = resolver.next();
+                host->addrs.emplace_back((const char*)addr->ai_addr, addr->ai_addrlen);
+            }
+        } catch (const std::exception& err) {
+            host->resolve_error = err.what();
+        }
+        f->result.dns_ms = ms_since(f->started);
+    }
+
+    if (not host->resolve_error.empty()) {
+        this->finish(f, host->resolve_error);
+        return;
+    }
+
+    this->connect(f);
+}
+
+void Fetcher::connect(Fetch *f) {
+    const std::vector<std::string>& addrs = f->host->addrs;
+    std::string error = "No address to connect to";
+
+    /*
+     * Igual que Socket(hostname, servicename): probamos las direcciones
+     * en orden hasta que una funcione. Aca "funcionar" es solo poder
+     * iniciar la conexion; si despues falla (finish_connect()) volvemos
+     * aca con la siguiente.
+     * */
+    for (; f->addr_index < addrs.size(); ++f->addr_index) try {
+        const std::string& addr = addrs[f->addr_index];
+        f->connect_started = Clock::now();
+        f->skt = Socket::connect_nonblocking((const struct sockaddr*)addr.data(), addr.size());
+
+        this->poller.add(f->skt, f, false, true);
+        f->registered = true;
+        f->state = Fetch::CONNECTING;
+        return;
+    } catch (const std::exception& err) {
+        error = err.what();
+    }
+
+    this->finish(f, error);
+}
+
+void Fetcher::on_event(Fetch *f) {
+    if (f->state == Fetch::CONNECTING) {
+        int err = f->skt.finish_connect();
+        if (err != 0) {
+            this->poller.remove(f->skt);
+            f->registered = false;
+            f->skt = Socket();
+
+            ++f->addr_index;
+            if (f->addr_index < f->host->addrs.size()) {
+                this->connect(f);
+            } else {
+                this->finish(f, std::string("Connect failed: ") + strerror(err));
+            }
+            return;
+        }
+
+        f->result.connect_ms = ms_since(f->connect_started);
+
+        // El pedido es chico: entra de sobra en el buffer del socket
+        // recien conectado, asi que sendall() no se bloquea.
+        bool was_closed = false;
+        f->skt.sendall(f->request.data(), f->request.size(), &was_closed);
+        if (was_closed) {
+            this->finish(f, "Connection closed while sending the request");
+            return;
+        }
+
+        f->sent = Clock::now();
+        f->state = Fetch::RECEIVING;
+        this->poller.modify(f->skt, f, true, false);
+        return;
+    }
+
+    /*
+     * RECEIVING: el socket es bloqueante pero solo leemos cuando el
+     * Poller dice que hay algo (o que el peer cerro), asi que recvsome()
+     * retorna enseguida. Leemos una sola vez por evento: si queda mas,
+     * epoll nos volvera a avisar y mientras tanto atendemos a los demas.
+     * */
+    char buf[64 * 1024];
+    bool was_closed = false;
+    int n = f->skt.recvsome(buf, sizeof(buf), &was_closed);
+
+    if (f->result.ttfb_ms == 0 and n > 0)
+        f->result.ttfb_ms = ms_since(f->sent);
+
+    if (was_closed) {
+        if (not f->body_started)
+            this->finish(f, "Connection closed before the end of the headers");
+        else if (f->content_length >= 0 and f->result.bytes < f->content_length)
+            this->finish(f, "Connection closed before the end of the body");
+        else
+            this->finish(f, "");
+        return;
+    }
+
+    if (this->on_data(f, buf, n))
+        this->finish(f, "");
+}
+
+/*
+ * Procesa lo recibido: primero acumula los headers y despues escribe
+ * el body en el archivo de salida. Retorna true si la respuesta se
+ * completo (se recibieron Content-Length bytes de body).
+ * */
+bool Fetcher::on_data(Fetch *f, const char *data, unsigned int sz) {
+    if (not f->body_started) {
+        f->headers.append(data, sz);
+        if (f->headers.size() > 64 * 1024)
+            throw std::runtime_error("HTTP response headers too large");
+
+        const char *begin = f->headers.data();
+        const char *end = begin + f->headers.size();
+        const char *eoh = END_OF_HEADERS.find(begin + (f->scanned > 3 ? f->scanned - 3 : 0), end);
+        f->scanned = f->headers.size();
+        if (not eoh)
+            return false;
+
+        eoh += END_OF_HEADERS.size();
+        parse_headers(begin, eoh, &f->result.status, &f->content_length);
+
+        f->out_fd = open(f->result.output.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (f->out_fd == -1)
+            throw LibError(errno, "Cannot open '%s': ", f->result.output.c_str());
+
+        f->body_started = true;
+
+        // Lo que vino despues de los headers es el principio del body
+        data = eoh;
+        sz = end - eoh;
+    }
+
+    while (sz > 0) {
+        ssize_t s = ::write(f->out_fd, data, sz);
+        if (s == -1) {
+            if (errno == EINTR)
+                continue;
+            throw LibError(errno, "Write to '%s' failed: ", f->result.output.c_str());
+        }
+        data += s;
+        sz -= s;
+        f->result.bytes += s;
+    }
+
+    return f->content_length >= 0 and f->result.bytes >= f->content_length;
+}
+
+void Fetcher::finish(Fetch *f, const std::string& error) {
+    if (f->registered) {
+        this->poller.remove(f->skt);
+        f->registered = false;
+    }
+
+    // Liberamos el socket y el archivo ya: con miles de URLs no podemos
+    // esperar al destructor del Fetcher
+    f->skt = Socket();
+    if (f->out_fd != -1) {
+        ::close(f->out_fd);
+        f->out_fd = -1;
+    }
+
+    f->state = Fetch::DONE;
+    f->result.total_ms = ms_since(f->started);
+    f->result.error = error;
+
+    this->inflight.erase(std::find(this->inflight.begin(), this->inflight.end(), f));
+
+    // Si el host estaba en su limite ahora tiene lugar para otra
+    Host *host = f->host;
+    --host->active;
+    if (not host->queued and not host->pending.empty()) {
+        host->queued = true;
+        this->ready.push_back(host);
+    }
+
+    (*this->on_done)(f->result);
+}
+
+void Fetcher::run(const Callback& on_done) {
+    this->on_done = &on_done;
+
+    for (auto& f : this->fetches) {
+        if (not f->host and f->state != Fetch::DONE) {
+            f->state = Fetch::DONE;
+            on_done(f->result);
+        }
+    }
+
+    Poller::Event events[64];
+    Clock::time_point last_check = Clock::now();
+
+    while (true) {
+        /*
+         * Arrancamos todas las descargas que los limites permitan,
+         * tomando una URL de cada host por turno (round-robin).
+         * */
+        while (this->inflight.size() < this->max_inflight and not this->ready.empty()) {
+            Host *host = this->ready.front();
+            this->ready.pop_front();
+
+            Fetch *f = host->pending.front();
+            host->pending.pop_front();
+
+            if (not host->pending.empty() and host->active + 1 < this->max_per_host)
+                this->ready.push_back(host);
+            else
+                host->queued = false;
+
+            this->start(f);
+        }
+
+        if (this->inflight.empty())
+            break;
+
+        // Con timeout nos despertamos cada tanto para revisarlos aunque
+        // no haya eventos
+        int n = this->poller.wait(events, 64, this->timeout_ms > 0 ? 100 : -1);
+        for (int i = 0; i < n; ++i) {
+            Fetch *f = (Fetch*)events[i].data;
+            if (f->state == Fetch::DONE)
+                continue;
+
+            try {
+                this->on_event(f);
+            } catch (const std::exception& err) {
+                this->finish(f, err.what());
+            }
+        }
+
+        if (this->timeout_ms > 0 and ms_since(last_check) >= 100) {
+            last_check = Clock::now();
+
+            // Copia: finish() modifica inflight
+            std::vector<Fetch*> running = this->inflight;
+            for (Fetch *f : running) {
+                if (ms_since(f->started) >= this->timeout_ms)
+                    this->finish(f, "Timed out");
+            }
+        }
+    }
+
+    this->on_done = nullptr;
+}
+
+Fetcher::~Fetcher() {}
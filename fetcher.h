@@ -0,0 +1,121 @@
+#ifndef FETCHER_H
+#define FETCHER_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "poller.h"
+
+/*
+ * Fetcher: descarga muchas URLs http:// en paralelo desde un unico thread.
+ *
+ * Descargar las URLs de a una (resolver, conectar, enviar, leer hasta
+ * EOF) hace que el tiempo total sea la *suma* de las latencias. Aca en
+ * cambio todas las descargas en curso se multiplexan sobre un Poller:
+ * las conexiones son no bloqueantes (vease Socket::connect_nonblocking())
+ * y de cada socket solo leemos cuando hay algo para leer.
+ *
+ * La concurrencia esta acotada por dos limites:
+ *
+ *  - max_inflight: descargas en curso en total (cada una es un socket
+ *    y un archivo abiertos);
+ *  - max_per_host: descargas en curso contra un mismo host:puerto,
+ *    para no ahogar a un unico server.
+ *
+ * Las URLs que esperan turno se encolan por host y los hosts con
+ * trabajo pendiente (y por debajo de su limite) se atienden en
+ * round-robin: un host con diez mil URLs no deja esperando a los demas.
+ *
+ * La resolucion de nombres (getaddrinfo()) es bloqueante: se hace una
+ * unica vez por host:puerto y se cachea. Solo la primera descarga de
+ * cada host paga (y reporta) ese tiempo.
+ *
+ * El pedido es un GET HTTP/1.0: asi el server no puede responder con
+ * chunked encoding y el body termina en Content-Length bytes o cuando
+ * el server cierra la conexion.
+ * */
+class Fetcher {
+    public:
+    /*
+     * Resultado de una descarga.
+     *
+     * Los tiempos son en milisegundos y se miden desde que la descarga
+     * arranca (obtuvo un lugar segun los limites): dns es lo que tardo
+     * la resolucion, connect el handshake TCP, ttfb (time to first byte)
+     * desde que se envio el pedido hasta el primer byte de la respuesta
+     * y total todo (incluyendo dns).
+     *
+     * Si la descarga fallo error describe por que; status y bytes
+     * reflejan lo que se llego a recibir.
+     * */
+    struct Result {
+        std::string url;
+        std::string output;
+        int status;
+        long long bytes;
+        double dns_ms;
+        double connect_ms;
+        double ttfb_ms;
+        double total_ms;
+        std::string error;
+    };
+
+    typedef std::function<void(const Result&)> Callback;
+
+    private:
+    struct Host;
+    struct Fetch;
+
+    unsigned int max_inflight;
+    unsigned int max_per_host;
+    int timeout_ms;
+
+    Poller poller;
+    std::unordered_map<std::string, std::unique_ptr<Host>> hosts;
+    std::vector<std::unique_ptr<Fetch>> fetches;
+
+    // Hosts con URLs pendientes y por debajo de max_per_host
+    std::deque<Host*> ready;
+    std::vector<Fetch*> inflight;
+    const Callback *on_done;
+
+    void start(Fetch *f);
+    void connect(Fetch *f);
+    void on_event(Fetch *f);
+    bool on_data(Fetch *f, const char *data, unsigned int sz);
+    void finish(Fetch *f, const std::string& error);
+
+    public:
+    /*
+     * timeout_ms es el tiempo maximo de cada descarga (incluyendo la
+     * resolucion y la conexion); 0 es sin limite.
+     * */
+    Fetcher(unsigned int max_inflight, unsigned int max_per_host, int timeout_ms);
+
+    /*
+     * Encola la descarga de url (http://host[:puerto][/path]) cuyo body
+     * se escribira en el archivo output.
+     *
+     * Una URL mal formada no lanza una excepcion: se reporta como
+     * cualquier otra descarga fallida.
+     * */
+    void add(const std::string& url, const std::string& output);
+
+    /*
+     * Descarga todo lo encolado y retorna cuando termino. Por cada
+     * descarga finalizada (con exito o no) se llama a on_done, en el
+     * orden en que van terminando.
+     * */
+    void run(const Callback& on_done);
+
+    ~Fetcher();
+
+    Fetcher(const Fetcher&) = delete;
+    Fetcher& operator=(const Fetcher&) = delete;
+};
+
+#endif
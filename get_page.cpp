@@ -2,9 +2,23 @@
 #include "socket.h"
 #include "resolvererror.h"
 #include "liberror.h"
+#include "delimiter.h"
+#include "fetcher.h"
+#include "recvbuffer.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <chrono>
+#include <fstream>
+#include <string>
 #include <thread>
+#include <stdexcept>
 #include <exception>
 
 /*
@@ -38,12 +52,227 @@
  *
  * En Golang podras usar los "defer" para mitigar el problema. En C++ y en Rust
  * tendras RAII para resolverlo completamente (RAII = Resource Acquisition is Initialization)
+ *
+ * Descargas a archivo
+ * -------------------
+ *
+ * Opcionalmente se le puede pasar el host, servicio y path a descargar
+ * y un archivo de salida:
+ *
+ *  ./get_page 127.0.0.1 8080 /big.iso big.iso
+ *
+ * En ese modo el body de la respuesta se escribe en el archivo usando
+ * Socket::recv_to_fd(): los bytes van del socket al archivo sin pasar
+ * por nuestros buffers (vease socket.h).
+ *
+ * Descargas en lote
+ * -----------------
+ *
+ * Con --batch se descargan en paralelo todas las URLs (una por linea)
+ * del archivo dado, usando Fetcher (vease fetcher.h):
+ *
+ *  ./get_page --batch <url-file> <output-dir> [<max-inflight> [<max-per-host>]]
+ *
+ * El body de la URL de la linea N se escribe en <output-dir>/N. Por cada
+ * URL terminada se imprime en stdout una linea separada por tabs con el
+ * status, los bytes, los tiempos (dns, connect, ttfb y total en ms), la
+ * URL y el error si lo hubo. Al final se imprime un resumen en stderr.
+ *
+ * Para probarlo localmente con miles de "hosts" alcanza con un unico
+ * echo_server --http: todo 127.0.0.0/8 es loopback, asi que
+ * http://127.0.0.1:3129/, http://127.0.0.2:3129/, ... son hosts distintos
+ * para Fetcher (y para max-per-host) pero llegan al mismo server:
+ *
+ *  ./echo_server --http ./public &
+ *  for i in $(seq 1 4000); do echo "http://127.0.$((i / 250)).$((i % 250 + 1)):3129/index.html"; done > urls
+ *  ./get_page --batch urls out 16 4
+ *
+ * Ojo con max-inflight mayor que el backlog del listen() del server
+ * (20 en echo_server): las conexiones que no entran en la cola de
+ * accept se pierden y TCP las reintenta con backoff exponencial
+ * (se ven connect/ttfb de 1 segundo o mas).
  * */
-int main() try {
+
+/*
+ * Modo --batch: vease el comentario del principio.
+ * */
+static int batch(const char *url_file, const std::string& output_dir, unsigned int max_inflight, unsigned int max_per_host) {
+    std::ifstream in(url_file);
+    if (not in)
+        throw std::runtime_error(std::string("Cannot open the URL file '") + url_file + "'");
+
+    Fetcher fetcher(max_inflight, max_per_host, 30 * 1000);
+
+    std::string url;
+    unsigned int count = 0;
+    while (std::getline(in, url)) {
+        if (url.empty())
+            continue;
+        fetcher.add(url, output_dir + "/" + std::to_string(count));
+        ++count;
+    }
+
+    unsigned int failed = 0;
+    auto begin = std::chrono::steady_clock::now();
+
+    std::cout << "status\tbytes\tdns_ms\tconnect_ms\tttfb_ms\ttotal_ms\turl\terror\n";
+    fetcher.run([&failed](const Fetcher::Result& r) {
+        if (not r.error.empty())
+            ++failed;
+
+        std::cout << r.status << "\t" << r.bytes << "\t"
+                  << r.dns_ms << "\t" << r.connect_ms << "\t" << r.ttfb_ms << "\t" << r.total_ms << "\t"
+                  << r.url << "\t" << r.error << "\n";
+    });
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cerr << "Fetched " << count - failed << " of " << count << " URLs (" << failed << " failed) in "
+              << elapsed << " seconds\n";
+
+    return failed ? -1 : 0;
+}
+
+/*
+ * Archivo de salida abierto para escritura. RAII: lo cerramos
+ * en el destructor pase lo que pase.
+ * */
+struct OutputFile {
+    int fd;
+
+    explicit OutputFile(const char *filename) {
+        this->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (this->fd == -1)
+            throw LibError(errno, "Cannot open '%s': ", filename);
+    }
+
+    void write_all(const char *data, size_t sz) {
+        while (sz > 0) {
+            ssize_t s = ::write(this->fd, data, sz);
+            if (s == -1) {
+                if (errno == EINTR)
+                    continue;
+                throw LibError(errno, "Write failed: ");
+            }
+            data += s;
+            sz -= s;
+        }
+    }
+
+    ~OutputFile() {
+        ::close(this->fd);
+    }
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+};
+
+static const Delimiter CRLF("\r\n", 2);
+static const Delimiter END_OF_HEADERS("\r\n\r\n", 4);
+
+/*
+ * Busca el header Content-Length entre los headers de la respuesta.
+ * Retorna -1 si no esta (en cuyo caso el body termina cuando el server
+ * cierra la conexion: en HTTP/1.0 el server cierra al terminar)
+ * */
+static long long content_length(const char *headers, const char *end) {
+    const char name[] = "Content-Length:";
+    for (const char *line = headers; line < end;) {
+        const char *eol = CRLF.find(line, end);
+        if (not eol)
+            break;
+
+        if ((size_t)(eol - line) > sizeof(name) - 1 and strncasecmp(line, name, sizeof(name) - 1) == 0)
+            return strtoll(line + sizeof(name) - 1, nullptr, 10);
+
+        line = eol + 2;
+    }
+
+    return -1;
+}
+
+/*
+ * Recibe la respuesta HTTP: los headers van a un buffer y el body
+ * directo al archivo.
+ * */
+static void download(Socket& skt, const char *filename) {
+    bool was_closed = false;
+    OutputFile out(filename);
+
+    /*
+     * Primero leemos hasta encontrar el fin de los headers (una linea
+     * vacia, \r\n\r\n). Es probable que con los headers hayamos recibido
+     * tambien el principio del body.
+     * */
+    char buf[8192];
+    size_t received = 0;
+    size_t scanned = 0;
+    const char *body = nullptr;
+    while (not body) {
+        if (received == sizeof(buf))
+            throw std::runtime_error("HTTP response headers too large");
+
+        received += skt.recvsome(buf + received, sizeof(buf) - received, &was_closed);
+        if (was_closed)
+            throw std::runtime_error("Unexpected closed");
+
+        // Buscamos solo en lo recien recibido (y los 3 bytes anteriores
+        // por si el \r\n\r\n quedo partido entre dos recvsome())
+        body = END_OF_HEADERS.find(buf + (scanned > 3 ? scanned - 3 : 0), buf + received);
+        scanned = received;
+    }
+    body += END_OF_HEADERS.size();
+
+    long long len = content_length(buf, body);
+    size_t already = received - (body - buf);
+
+    // Un server que envia mas que el Content-Length: lo que sobra no es
+    // parte del body
+    if (len >= 0 and (long long)already > len)
+        already = len;
+    out.write_all(body, already);
+
+    // El resto del body (si falta algo) lo dejamos en manos de
+    // Socket::recv_to_fd()
+    long long pending = len >= 0 ? len - (long long)already : -1;
+    long long n = 0;
+    if (len < 0 or pending > 0)
+        n = skt.recv_to_fd(out.fd, pending, &was_closed);
+
+    if (len >= 0 and n != pending)
+        throw std::runtime_error("Unexpected closed");
+
+    std::cerr << "Downloaded " << already + n << " bytes into " << filename << "\n";
+}
+
+int main(int argc, char *argv[]) try {
     int ret = -1;
     bool was_closed = false;
 
-    const char req[] = "GET / HTTP/1.1\r\nAccept: */*\r\nConnection: close\r\nHost: www.google.com.ar\r\n\r\n";
+    if (argc >= 4 and argc <= 6 and strcmp(argv[1], "--batch") == 0) {
+        return batch(argv[2], argv[3],
+                argc > 4 ? atoi(argv[4]) : 64,
+                argc > 5 ? atoi(argv[5]) : 4);
+    }
+
+    if (argc != 1 and argc != 5) {
+        std::cerr << "Bad program call. Expected " << argv[0]
+                  << " [<hostname> <servicename> <path> <output-file>]"
+                  << " or " << argv[0] << " --batch <url-file> <output-dir> [<max-inflight> [<max-per-host>]]\n";
+        return -1;
+    }
+
+    const char *hostname = argc == 5 ? argv[1] : "www.google.com.ar";
+    const char *servicename = argc == 5 ? argv[2] : "http";
+    const char *path = argc == 5 ? argv[3] : "/";
+    const char *output = argc == 5 ? argv[4] : nullptr;
+
+    /*
+     * Pedimos HTTP/1.0 (como Fetcher): un server no puede responder a un
+     * request HTTP/1.0 con "Transfer-Encoding: chunked", asi que el body
+     * es exactamente lo que va al archivo (con HTTP/1.1 escribiriamos
+     * los tamaños de los chunks mezclados con los datos).
+     * */
+    const std::string req = std::string("GET ") + path + " HTTP/1.0\r\nAccept: */*\r\nHost: " + hostname + "\r\n\r\n";
 
     /*
      * Inicializamos el socket para que se conecte a google.com
@@ -60,7 +289,7 @@ int main() try {
     int retries = 3;
     Socket skt;
     while (true) try {
-        Socket tmp("www.google.com.ar", "http");
+        Socket tmp(hostname, servicename);
 
         // Move semantics: movemos el socket del scope del try/catch (tmp)
         // afuera, al scope del main (skt).
@@ -85,7 +314,12 @@ int main() try {
      * En caso que el send() no pueda enviar todo de un solo golpe,
      * socket_sendall() fue codeada para hacer "el loop" por nosotros.
      * */
-    skt.sendall(req, sizeof(req) - 1, &was_closed);
+    skt.sendall(req.data(), req.size(), &was_closed);
+
+    if (output) {
+        download(skt, output);
+        return 0;
+    }
 
     /*
      * Iteramos leyendo/recibiendo de a cachos la pagina web.
@@ -95,19 +329,23 @@ int main() try {
      * tenga exactamente el size del buffer: sera nuestro trabajo hacer
      * el loop aqui.
      * */
-    char buf[512];
+    RecvBuffer rbuf;
     while (not was_closed) {
-        int r = skt.recvsome(buf, sizeof(buf) - 1, &was_closed);
+        int r = rbuf.recvsome(skt, &was_closed);
         if (was_closed)
             break;
 
         /*
          * Recorda que con sockets se envian/reciben *bytes*, no texto.
          * La respuesta de google seran bytes y no necesariamente terminaran
-         * en un \0 asi que es necesario poner ese "fin de string" nosotros.
+         * en un \0 asi que no la podemos imprimir como un string: le
+         * decimos a std::cout cuantos bytes escribir.
+         *
+         * RecvBuffer empieza con 512 bytes y crece si la pagina es grande
+         * (vease recvbuffer.h): una descarga de varios MB se lee en
+         * muchos menos recvsome().
          * */
-        buf[r] = 0;
-        std::cout << buf;
+        std::cout.write(rbuf.data(), r);
     }
 
     ret = 0;
@@ -0,0 +1,210 @@
+#include <string.h>
+#include <errno.h>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+#include "handoff.h"
+#include "socket.h"
+#include "liberror.h"
+
+/*
+ * Completa la direccion UNIX con el path. A diferencia de las
+ * direcciones IP aqui no hay getaddrinfo(): la direccion es un path
+ * del filesystem y tiene un limite de tamaño fijo (sun_path).
+ * */
+static void fill_unix_addr(struct sockaddr_un *addr, const char *path) {
+    if (strlen(path) >= sizeof(addr->sun_path))
+        throw std::runtime_error("Handoff path too long");
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+}
+
+Handoff::Handoff(const char *path) : skt(-1) {
+    struct sockaddr_un addr;
+    fill_unix_addr(&addr, path);
+
+    strncpy(this->path, addr.sun_path, sizeof(this->path));
+
+    int skt = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (skt == -1)
+        throw LibError(errno, "Handoff socket failed: ");
+
+    // Un path "viejo" haria fallar al bind() con "Address already in use".
+    // No chequeamos el error: lo normal es que el path no exista.
+    ::unlink(this->path);
+
+    if (bind(skt, (struct sockaddr*)&addr, sizeof(addr)) == -1 or listen(skt, 1) == -1) {
+        int errno_saved = errno;
+        ::close(skt);
+        throw LibError(errno_saved, "Handoff on '%s' failed: ", path);
+    }
+
+    this->skt = skt;
+}
+
+bool Handoff::wait(Socket& listener) {
+    struct pollfd fds[2];
+    fds[0].fd = listener.skt;
+    fds[0].events = POLLIN;
+    fds[1].fd = this->skt;
+    fds[1].events = POLLIN;
+
+    while (true) {
+        int s = poll(fds, 2, -1);
+        if (s == -1) {
+            if (errno == EINTR)
+                continue;
+            throw LibError(errno, "Handoff poll failed: ");
+        }
+
+        // Priorizamos el handoff: si el proceso nuevo ya esta listo
+        // no tiene sentido que sigamos aceptando aqui.
+        if (fds[1].revents & POLLIN)
+            break;
+
+        if (fds[0].revents & POLLIN)
+            return true;
+    }
+
+    int peer = ::accept(this->skt, nullptr, nullptr);
+    if (peer == -1)
+        throw LibError(errno, "Handoff accept failed: ");
+
+    // Borramos el path *antes* de enviar el listener: el proceso nuevo
+    // creara su propio Handoff en el mismo path y no queremos que nuestro
+    // destructor se lo borre.
+    ::unlink(this->path);
+    this->path[0] = 0;
+
+    /*
+     * El file descriptor viaja en un mensaje de control (cmsg) con
+     * tipo SCM_RIGHTS. El kernel lo "duplica" en el proceso receptor:
+     * ambos procesos quedan apuntando al mismo socket del kernel.
+     *
+     * Ademas del mensaje de control hay que enviar al menos un byte
+     * de datos "normales".
+     * */
+    char dummy = 'L';
+    struct iovec iov;
+    iov.iov_base = &dummy;
+    iov.iov_len = 1;
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctrl;
+    memset(&ctrl, 0, sizeof(ctrl));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &listener.skt, sizeof(int));
+
+    ssize_t s = sendmsg(peer, &msg, MSG_NOSIGNAL);
+    int errno_saved = errno;
+    ::close(peer);
+
+    if (s == -1)
+        throw LibError(errno_saved, "Handoff sendmsg failed: ");
+
+    /*
+     * Cerramos *solo* nuestro file descriptor. Es muy importante no
+     * llamar a shutdown(): el socket del kernel es compartido y un
+     * shutdown() lo cerraria tambien para el proceso nuevo.
+     *
+     * Por eso usamos Socket::close() y no dejamos que el destructor
+     * de Socket lo haga por nosotros.
+     * */
+    listener.close();
+    return false;
+}
+
+Socket Handoff::takeover(const char *path) {
+    struct sockaddr_un addr;
+    fill_unix_addr(&addr, path);
+
+    int skt = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (skt == -1)
+        throw LibError(errno, "Handoff socket failed: ");
+
+    if (connect(skt, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        int errno_saved = errno;
+        ::close(skt);
+        throw LibError(errno_saved, "Handoff takeover from '%s' failed: ", path);
+    }
+
+    char dummy;
+    struct iovec iov;
+    iov.iov_base = &dummy;
+    iov.iov_len = 1;
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctrl;
+    memset(&ctrl, 0, sizeof(ctrl));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    // MSG_CMSG_CLOEXEC: que el listener recibido no se filtre a
+    // procesos hijos que podamos lanzar con exec().
+    ssize_t s;
+    do {
+        s = recvmsg(skt, &msg, MSG_CMSG_CLOEXEC);
+    } while (s == -1 and errno == EINTR);
+
+    int errno_saved = errno;
+    ::close(skt);
+
+    if (s == -1)
+        throw LibError(errno_saved, "Handoff recvmsg failed: ");
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (s == 0 or cmsg == nullptr or cmsg->cmsg_level != SOL_SOCKET or cmsg->cmsg_type != SCM_RIGHTS)
+        throw std::runtime_error("Handoff takeover failed: no file descriptor received");
+
+    int fd;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+
+    /*
+     * Nos aseguramos que lo que recibimos es realmente un socket
+     * en escucha antes de envolverlo en un Socket.
+     * */
+    int listening = 0;
+    socklen_t len = sizeof(listening);
+    if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) == -1 or not listening) {
+        ::close(fd);
+        throw std::runtime_error("Handoff takeover failed: received a non-listening socket");
+    }
+
+    return Socket(fd);
+}
+
+Handoff::~Handoff() {
+    if (this->skt != -1)
+        ::close(this->skt);
+
+    if (this->path[0])
+        ::unlink(this->path);
+}
@@ -0,0 +1,79 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+class Socket;
+
+/*
+ * Handoff: pasaje del socket aceptador (listener) de un proceso a otro
+ * para hacer un "hot restart" sin cortar el servicio.
+ *
+ * El problema: si para actualizar un servidor lo matamos y lanzamos
+ * el binario nuevo, entre un proceso y otro nadie esta escuchando
+ * en el puerto. Las conexiones que estaban en el backlog del listen()
+ * se pierden (reset) y las nuevas son rechazadas.
+ *
+ * La solucion: el proceso viejo le *pasa* el file descriptor del listener
+ * al proceso nuevo. Ambos comparten el mismo socket del kernel asi que
+ * el backlog nunca se pierde: el proceso nuevo empieza a aceptar
+ * inmediatamente mientras que el viejo deja de aceptar, termina de atender
+ * a sus clientes actuales y finaliza.
+ *
+ * Los file descriptors solo se pueden pasar entre procesos a traves de
+ * un socket UNIX (AF_UNIX) con un mensaje de control SCM_RIGHTS.
+ * Lease man 7 unix y man 3 cmsg
+ *
+ * Handoff es amigo (friend) de Socket: es el unico que puede tomar
+ * el file descriptor de un Socket y construir un Socket a partir
+ * de un file descriptor recibido.
+ * */
+class Handoff {
+    int skt;
+    char path[108];
+
+    public:
+    /*
+     * Lado del proceso viejo: crea un socket UNIX en escucha en el path
+     * dado. Por ahi es por donde el proceso nuevo pedira el listener.
+     *
+     * Si el path ya existe (por ejemplo, quedo de una corrida anterior)
+     * se lo borra primero.
+     * */
+    explicit Handoff(const char *path);
+
+    /*
+     * Bloquea hasta que pase una de dos cosas:
+     *
+     *  - hay una conexion entrante en el listener: retorna true y
+     *    el caller deberia llamar a listener.accept() que no bloqueara.
+     *
+     *  - un proceso nuevo pidio el listener: se le envia el file descriptor,
+     *    se cierra (sin shutdown!) nuestra copia del listener y se retorna
+     *    false. A partir de aqui el caller no debe aceptar mas conexiones,
+     *    solo terminar con las que ya tiene.
+     *
+     * Es importante que sea el mismo loop el que espere por ambas cosas:
+     * asi nunca hay dos procesos bloqueados en accept() al mismo tiempo.
+     * */
+    bool wait(Socket& listener);
+
+    /*
+     * Lado del proceso nuevo: se conecta al socket UNIX del proceso
+     * viejo y recibe el listener, ya en escucha.
+     *
+     * Lanza LibError si no hay ningun proceso escuchando en el path
+     * (errno ENOENT o ECONNREFUSED) en cuyo caso el caller puede
+     * crear su propio listener con Socket(servicename).
+     * */
+    static Socket takeover(const char *path);
+
+    /*
+     * Cierra el socket UNIX y borra el path (si aun no se hizo
+     * el handoff).
+     * */
+    ~Handoff();
+
+    Handoff(const Handoff&) = delete;
+    Handoff& operator=(const Handoff&) = delete;
+};
+
+#endif
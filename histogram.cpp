@@ -0,0 +1,129 @@
+#include "histogram.h"
+
+#include <string.h>
+
+Histogram::Histogram() : total(0), min_(0), max_(0), sum(0) {
+    memset(this->counts, 0, sizeof(this->counts));
+}
+
+/*
+ * Los valores menores a SUB_BUCKETS van cada uno a su propio bucket.
+ *
+ * Para los demas miramos el bit mas significativo (msb): el valor cae
+ * en el rango [2^msb, 2^(msb+1)) que dividimos en SUB_BUCKETS partes
+ * iguales. Basta con quedarnos con los SUB_BUCKET_BITS bits mas
+ * significativos del valor para saber en que parte cae.
+ * */
+int Histogram::index_of(unsigned long long value) {
+    if (value < (unsigned long long)SUB_BUCKETS)
+        return (int)value;
+
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + (int)((value >> shift) - SUB_BUCKETS);
+}
+
+/*
+ * La inversa de index_of(): el valor mas alto que cae en el bucket.
+ * */
+unsigned long long Histogram::value_of(int index) {
+    if (index < SUB_BUCKETS)
+        return index;
+
+    int shift = index / SUB_BUCKETS - 1;
+    unsigned long long sub = index % SUB_BUCKETS + SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+void Histogram::record(unsigned long long value) {
+    ++this->counts[index_of(value)];
+
+    if (this->total == 0 or value < this->min_)
+        this->min_ = value;
+    if (value > this->max_)
+        this->max_ = value;
+
+    ++this->total;
+    this->sum += value;
+}
+
+void Histogram::record_corrected(unsigned long long value, unsigned long long expected_interval) {
+    this->record(value);
+
+    if (expected_interval == 0)
+        return;
+
+    for (unsigned long long missing = value - expected_interval;
+            missing >= expected_interval and missing < value;
+            missing -= expected_interval) {
+        this->record(missing);
+    }
+}
+
+void Histogram::merge(const Histogram& other) {
+    if (other.total == 0)
+        return;
+
+    for (int i = 0; i < BUCKETS; ++i)
+        this->counts[i] += other.counts[i];
+
+    if (this->total == 0 or other.min_ < this->min_)
+        this->min_ = other.min_;
+    if (other.max_ > this->max_)
+        this->max_ = other.max_;
+
+    this->total += other.total;
+    this->sum += other.sum;
+}
+
+unsigned long long Histogram::count() const {
+    return this->total;
+}
+
+unsigned long long Histogram::min() const {
+    return this->min_;
+}
+
+unsigned long long Histogram::max() const {
+    return this->max_;
+}
+
+double Histogram::mean() const {
+    return this->total ? (double)(this->sum / this->total) : 0;
+}
+
+unsigned long long Histogram::percentile(double p) const {
+    if (this->total == 0)
+        return 0;
+
+    // Cuantas mediciones tienen que quedar a la izquierda (incluido)
+    // del valor que buscamos. Redondeamos para arriba y al menos 1.
+    unsigned long long target = (unsigned long long)(p / 100.0 * this->total + 0.5);
+    if (target < 1)
+        target = 1;
+
+    unsigned long long seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        seen += this->counts[i];
+        if (seen >= target) {
+            // El bucket es una aproximacion: no reportemos nunca
+            // algo por fuera de lo realmente medido.
+            unsigned long long value = value_of(i);
+            return value > this->max_ ? this->max_ : value;
+        }
+    }
+
+    return this->max_;
+}
+
+void Histogram::write_json(std::ostream& out, double scale) const {
+    out << "{\"count\": " << this->count()
+        << ", \"min\": " << this->min() / scale
+        << ", \"mean\": " << this->mean() / scale
+        << ", \"p50\": " << this->percentile(50) / scale
+        << ", \"p90\": " << this->percentile(90) / scale
+        << ", \"p99\": " << this->percentile(99) / scale
+        << ", \"p99.9\": " << this->percentile(99.9) / scale
+        << ", \"max\": " << this->max() / scale
+        << "}";
+}
@@ -0,0 +1,84 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <ostream>
+
+/*
+ * Histograma de latencias (o de cualquier valor entero no negativo).
+ *
+ * Guardar cada medicion para despues ordenarlas y sacar percentiles
+ * no escala: un load generator puede hacer millones de mediciones
+ * por segundo.
+ *
+ * En cambio agrupamos los valores en "buckets" de tamaño logaritmico
+ * con 64 sub-buckets lineales cada uno (la misma idea que HdrHistogram):
+ * el error relativo es de a lo sumo ~1.5% sin importar si medimos
+ * microsegundos o segundos y el histograma ocupa una cantidad fija
+ * de memoria.
+ *
+ * Dos histogramas se pueden sumar (Histogram::merge()) asi cada thread
+ * tiene el suyo, sin locks, y se combinan al final.
+ * */
+class Histogram {
+    static const int SUB_BUCKET_BITS = 6;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int BUCKETS = SUB_BUCKETS * (64 - SUB_BUCKET_BITS + 1);
+
+    unsigned long long counts[BUCKETS];
+    unsigned long long total;
+    unsigned long long min_;
+    unsigned long long max_;
+    long double sum;
+
+    static int index_of(unsigned long long value);
+    static unsigned long long value_of(int index);
+
+    public:
+    Histogram();
+
+    /*
+     * Registra un valor.
+     * */
+    void record(unsigned long long value);
+
+    /*
+     * Registra un valor corrigiendo la "omision coordinada"
+     * (coordinated omission).
+     *
+     * Si el generador de carga queria enviar un request cada
+     * expected_interval pero uno tardo value >> expected_interval,
+     * todos los requests que *deberian* haberse enviado mientras tanto
+     * no se midieron: el generador se "coordino" con el server lento
+     * y los omitio.
+     *
+     * Para compensarlo, ademas de value se registran los valores
+     * value - expected_interval, value - 2*expected_interval, ...
+     * que son las latencias que habrian visto esos requests omitidos.
+     * */
+    void record_corrected(unsigned long long value, unsigned long long expected_interval);
+
+    /*
+     * Suma los conteos de otro histograma a este.
+     * */
+    void merge(const Histogram& other);
+
+    unsigned long long count() const;
+    unsigned long long min() const;
+    unsigned long long max() const;
+    double mean() const;
+
+    /*
+     * Retorna el valor por debajo del cual cae el percentil dado
+     * (entre 0 y 100) de las mediciones.
+     * */
+    unsigned long long percentile(double p) const;
+
+    /*
+     * Escribe un resumen (count, min, mean, p50, p90, p99, p99.9, max)
+     * como un objeto JSON dividiendo cada valor por scale (por ejemplo,
+     * 1000 para pasar de nanosegundos a microsegundos).
+     * */
+    void write_json(std::ostream& out, double scale) const;
+};
+
+#endif
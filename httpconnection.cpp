@@ -0,0 +1,142 @@
+#include "httpconnection.h"
+
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+
+#include "delimiter.h"
+
+/*
+ * Un request no deberia tener headers tan grandes: si los tiene
+ * probablemente no es HTTP (o es un ataque) y cerramos.
+ * */
+static const size_t MAX_REQUEST_SIZE = 8192;
+
+static const Delimiter CRLF("\r\n", 2);
+static const Delimiter END_OF_HEADERS("\r\n\r\n", 4);
+
+HttpConnection::HttpConnection(Socket&& peer, const ResponseCache& cache) :
+    PeerConnection(std::move(peer)), cache(cache), scanned(0) {}
+
+/*
+ * Retorna si entre los headers hay uno "name: value" (ignorando
+ * mayusculas/minusculas).
+ * */
+static bool has_header(const char *headers, const char *end, const char *name, const char *value) {
+    const size_t name_len = strlen(name);
+    const size_t value_len = strlen(value);
+
+    for (const char *line = headers; line < end;) {
+        const char *eol = CRLF.find(line, end);
+        if (not eol)
+            eol = end;
+
+        if ((size_t)(eol - line) > name_len and strncasecmp(line, name, name_len) == 0 and line[name_len] == ':') {
+            const char *v = line + name_len + 1;
+            while (v < eol and *v == ' ')
+                ++v;
+            if ((size_t)(eol - v) >= value_len and strncasecmp(v, value, value_len) == 0)
+                return true;
+        }
+
+        line = eol + 2;
+    }
+
+    return false;
+}
+
+bool HttpConnection::serve(const char *req, size_t len) {
+    const char *end = req + len;
+
+    /*
+     * La request line es "METHOD SP TARGET SP VERSION"
+     * */
+    const char *eol = CRLF.find(req, end);
+    if (not eol)
+        eol = end;
+
+    const char *sp1 = (const char*)memchr(req, ' ', eol - req);
+    const char *sp2 = sp1 ? (const char*)memchr(sp1 + 1, ' ', eol - sp1 - 1) : nullptr;
+    if (not sp2) {
+        this->send(this->cache.error().data.data(), this->cache.error().data.size());
+        return false;
+    }
+
+    const bool is_head = sp1 - req == 4 and memcmp(req, "HEAD", 4) == 0;
+    const bool is_get = sp1 - req == 3 and memcmp(req, "GET", 3) == 0;
+    if (not is_get and not is_head) {
+        this->send(this->cache.error().data.data(), this->cache.error().data.size());
+        return false;
+    }
+
+    // Ignoramos la query string (?a=b): el cache es por path
+    const char *path = sp1 + 1;
+    const char *query = (const char*)memchr(path, '?', sp2 - path);
+    size_t path_len = (query ? query : sp2) - path;
+
+    /*
+     * HTTP/1.1 es keep-alive salvo que pidan "Connection: close";
+     * HTTP/1.0 es al reves.
+     * */
+    const bool http11 = eol - sp2 - 1 == 8 and memcmp(sp2 + 1, "HTTP/1.1", 8) == 0;
+    const bool keep_alive = http11 ?
+        not has_header(eol + 2, end, "Connection", "close") :
+        has_header(eol + 2, end, "Connection", "keep-alive");
+
+    /*
+     * El corazon del cache: la respuesta ya esta armada, un solo send()
+     * (lo que el kernel no acepte queda encolado, vease worker.h)
+     * */
+    const ResponseCache::Entry& entry = this->cache.get(path, path_len, keep_alive and not http11);
+    bool open = this->send(entry.data.data(), is_head ? entry.header_len : entry.data.size());
+
+    return keep_alive and open;
+}
+
+bool HttpConnection::on_readable(char *buf, size_t len) {
+    bool was_closed = false;
+
+    int sz = this->peer.recvsome(buf, len, &was_closed);
+    if (was_closed)
+        return false;
+    if (sz < 0)
+        return true;    // al final no habia nada para leer
+
+    this->inbuf.append(buf, sz);
+
+    /*
+     * Respondemos todos los requests completos que haya en el buffer
+     * (pipelining). Un request termina con una linea vacia: \r\n\r\n
+     *
+     * Si un request llega en varios pedazos no volvemos a buscar desde
+     * el principio: lo ya escaneado (salvo los ultimos 3 bytes, que
+     * podrian ser el comienzo de un \r\n\r\n partido) sabemos que no
+     * tiene el delimitador.
+     * */
+    size_t pos = 0;
+    while (true) {
+        const char *begin = this->inbuf.data() + pos;
+        const char *from = this->inbuf.data() + std::max(pos, this->scanned);
+        const char *end = END_OF_HEADERS.find(from, this->inbuf.data() + this->inbuf.size());
+        if (not end)
+            break;
+
+        if (not this->serve(begin, end - begin))
+            return false;
+
+        pos = end + END_OF_HEADERS.size() - this->inbuf.data();
+    }
+
+    this->inbuf.erase(0, pos);
+
+    size_t tail = END_OF_HEADERS.size() - 1;
+    this->scanned = this->inbuf.size() > tail ? this->inbuf.size() - tail : 0;
+
+    if (this->inbuf.size() > MAX_REQUEST_SIZE) {
+        this->send(this->cache.error().data.data(), this->cache.error().data.size());
+        return false;
+    }
+
+    return true;
+}
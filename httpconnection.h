@@ -0,0 +1,37 @@
+#ifndef HTTP_CONNECTION_H
+#define HTTP_CONNECTION_H
+
+#include <stddef.h>
+
+#include <string>
+
+#include "worker.h"
+#include "responsecache.h"
+
+/*
+ * Conexion HTTP/1.1 minima: solo GET y HEAD de recursos del
+ * ResponseCache, sin bodies en los requests.
+ *
+ * Soporta keep-alive (varios requests por conexion) y pipelining
+ * (varios requests enviados de una sin esperar las respuestas): todo
+ * lo recibido se acumula en un buffer y se responden todos los requests
+ * completos que haya, en orden.
+ * */
+class HttpConnection : public PeerConnection<Socket> {
+    const ResponseCache& cache;
+    std::string inbuf;
+    size_t scanned;     // hasta donde ya buscamos el fin de headers en inbuf
+
+    /*
+     * Atiende un request completo (request line + headers, sin el
+     * \r\n\r\n final). Retorna false si hay que cerrar la conexion.
+     * */
+    bool serve(const char *req, size_t len);
+
+    public:
+    HttpConnection(Socket&& peer, const ResponseCache& cache);
+
+    virtual bool on_readable(char *buf, size_t len) override;
+};
+
+#endif
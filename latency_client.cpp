@@ -0,0 +1,185 @@
+#include <iostream>
+#include "socket.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <exception>
+
+/*
+ * Este mini ejemplo mide la latencia de ida y vuelta (round-trip) contra
+ * un echo server: envia un mensaje chico, espera a recibirlo de vuelta
+ * y mide cuanto tardo. Repite eso muchas veces y reporta los percentiles
+ * p50 (la mediana) y p99.
+ *
+ * Por que percentiles y no el promedio? Por que el promedio esconde
+ * los casos malos: un 1% de mensajes muy lentos apenas mueve el promedio
+ * pero es justamente lo que el usuario nota.
+ *
+ * Para comparar con y sin el modo de baja latencia (Socket::set_busy_poll())
+ * corre en una consola el echo_server y en otra:
+ *
+ *  ./latency_client 127.0.0.1 3129 100000
+ *  ./latency_client 127.0.0.1 3129 100000 50
+ *
+ * El ultimo argumento (opcional) es el presupuesto de spinning en
+ * microsegundos.
+ *
+ * Desglose con timestamps del kernel
+ * ----------------------------------
+ *
+ * Con --timestamps se activan los timestamps del kernel (vease
+ * Socket::set_timestamping()) y cada round-trip se parte en:
+ *
+ *  - send stack: desde que llamamos a send() hasta que los datos
+ *    entraron a la cola de la interfaz (SCHED)
+ *  - qdisc: cuanto estuvieron en esa cola (SENT - SCHED)
+ *  - network+peer: desde que salieron hasta que llego la respuesta
+ *    (timestamp de recepcion), incluye al echo server
+ *  - wakeup: desde que llego la respuesta hasta que recvsome() nos la
+ *    dio (despertar al thread y que el scheduler lo ponga a correr)
+ *
+ * Las cuatro partes suman exactamente el round-trip (medido con
+ * CLOCK_REALTIME, el reloj de los timestamps del kernel). Funciona en
+ * loopback con timestamps de software:
+ *
+ *  ./latency_client 127.0.0.1 3129 100000 --timestamps
+ * */
+
+static uint64_t realtime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void report(const char *name, std::vector<long long>& ns) {
+    if (ns.empty())
+        return;
+    std::sort(ns.begin(), ns.end());
+    std::cout << name << " p50: " << ns[ns.size() * 50 / 100] / 1000.0 << " us"
+              << ", p99: " << ns[ns.size() * 99 / 100] / 1000.0 << " us\n";
+}
+
+int main(int argc, char *argv[]) try {
+    bool timestamps = argc > 4 and strcmp(argv[argc - 1], "--timestamps") == 0;
+    if (timestamps)
+        --argc;
+
+    if (argc != 4 and argc != 5) {
+        std::cerr << "Bad program call. Expected " << argv[0]
+                  << " <hostname> <servicename> <count> [<busy-poll-usecs>] [--timestamps]\n";
+        return -1;
+    }
+
+    const int count = atoi(argv[3]);
+    const unsigned int spin_usecs = argc == 5 ? atoi(argv[4]) : 0;
+    bool was_closed = false;
+
+    Socket skt(argv[1], argv[2]);
+    if (spin_usecs)
+        skt.set_busy_poll(spin_usecs);
+    if (timestamps)
+        skt.set_timestamping(true);
+
+    // Desglose del round-trip (solo con --timestamps)
+    std::vector<long long> send_stack, qdisc, network, wakeup;
+    uint32_t sent_bytes = 0;
+
+    // Reservamos de antemano: no queremos medir los realloc() del vector
+    std::vector<long long> rtts;
+    rtts.reserve(count);
+    if (timestamps) {
+        send_stack.reserve(count);
+        qdisc.reserve(count);
+        network.reserve(count);
+        wakeup.reserve(count);
+    }
+
+    char msg[64] = "ping";
+    char buf[sizeof(msg)];
+    for (int i = 0; i < count; ++i) {
+        auto begin = std::chrono::steady_clock::now();
+        uint64_t app_send = timestamps ? realtime_ns() : 0;
+
+        skt.sendall(msg, sizeof(msg), &was_closed);
+        if (was_closed)
+            break;
+
+        if (not timestamps) {
+            skt.recvall(buf, sizeof(buf), &was_closed);
+            if (was_closed)
+                break;
+        } else {
+            // Un recvall() "a mano" para quedarnos con el timestamp de
+            // recepcion del ultimo pedazo de la respuesta
+            Socket::Timestamp rx;
+            unsigned int received = 0;
+            while (received < sizeof(buf) and not was_closed)
+                received += skt.recvsome(buf + received, sizeof(buf) - received, &was_closed, &rx);
+            if (was_closed)
+                break;
+
+            uint64_t app_recv = realtime_ns();
+            sent_bytes += sizeof(msg);
+
+            // Los timestamps de envio de este mensaje ya estan en la
+            // cola de errores: se generaron antes de que saliera
+            uint64_t sched = 0, sent = 0;
+            Socket::TxTimestamp tx;
+            while (skt.tx_timestamp(&tx)) {
+                if (tx.bytes != sent_bytes)
+                    continue;
+                if (tx.kind == Socket::TxTimestamp::SCHED)
+                    sched = tx.ts.software_ns;
+                else if (tx.kind == Socket::TxTimestamp::SENT)
+                    sent = tx.ts.hardware_ns ? tx.ts.hardware_ns : tx.ts.software_ns;
+            }
+
+            if (sched and sent and rx.software_ns) {
+                send_stack.push_back(sched - app_send);
+                qdisc.push_back(sent - sched);
+                network.push_back(rx.software_ns - sent);
+                wakeup.push_back(app_recv - rx.software_ns);
+            }
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        rtts.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+    }
+
+    if (rtts.empty()) {
+        std::cerr << "No round-trip was completed.\n";
+        return -1;
+    }
+
+    std::sort(rtts.begin(), rtts.end());
+    std::cout << "round-trips: " << rtts.size() << "\n"
+              << "p50: " << rtts[rtts.size() * 50 / 100] / 1000.0 << " us\n"
+              << "p99: " << rtts[rtts.size() * 99 / 100] / 1000.0 << " us\n";
+
+    if (spin_usecs) {
+        const Socket::BusyPollStats& stats = skt.busy_poll_stats();
+        std::cout << "spinning: " << stats.spin_ns / 1000000.0 << " ms (" << stats.spin_hits << " reads)\n"
+                  << "sleeping: " << stats.sleep_ns / 1000000.0 << " ms (" << stats.sleeps << " reads)\n";
+    }
+
+    if (timestamps) {
+        std::cout << "kernel timestamps for " << send_stack.size() << " round-trips:\n";
+        report("  send stack  ", send_stack);
+        report("  qdisc       ", qdisc);
+        report("  network+peer", network);
+        report("  wakeup      ", wakeup);
+    }
+
+    return 0;
+} catch (const std::exception& err) {
+    std::cerr << "Something went wrong and an exception was caught: " << err.what() << "\n";
+    return -1;
+} catch (...) {
+    std::cerr << "Something went wrong and an unknown exception was caught.\n";
+    return -1;
+}
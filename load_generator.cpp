@@ -0,0 +1,464 @@
+#include <iostream>
+#include "socket.h"
+#include "poller.h"
+#include "histogram.h"
+#include "delimiter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <exception>
+
+/*
+ * Generador de carga para estresar servidores como el echo_server.
+ *
+ * Lanza N threads y cada uno abre M conexiones. Cada request es un
+ * payload de bytes que el server debe devolver (echo): el request se
+ * da por completado cuando recibimos de vuelta tantos bytes como
+ * enviamos.
+ *
+ * Hay dos modos:
+ *
+ *  - closed-loop (lazo cerrado): cada conexion envia un request,
+ *    espera la respuesta y recien ahi envia el siguiente. La carga
+ *    la "decide" el server: si el server es lento, enviamos menos.
+ *    Sirve para saber cuanto aguanta el server como maximo.
+ *
+ *  - open-loop (lazo abierto): los requests se envian a una tasa fija
+ *    (requests por segundo) sin importar si el server respondio o no
+ *    a los anteriores. Asi es como se comportan los usuarios reales.
+ *
+ * En el modo open-loop la latencia se mide desde el momento en que el
+ * request *deberia* haberse enviado y no desde que realmente se envio.
+ * Si el server se trabo 1 segundo, todos los requests que tendriamos
+ * que haber enviado en ese segundo reportan esa demora: asi se corrige
+ * la "omision coordinada".
+ *
+ * En closed-loop no hay un "deberia": mientras el server esta trabado
+ * simplemente no enviamos nada. Ahi cada latencia se registra con
+ * Histogram::record_corrected() tomando como intervalo esperado entre
+ * requests de una conexion la latencia media observada hasta el momento
+ * (como hace wrk). En el JSON latency_us es la corregida y
+ * latency_uncorrected_us la medida tal cual.
+ *
+ * Los sockets son no bloqueantes: lo que el server todavia no acepta
+ * queda en un buffer de salida por conexion y se envia cuando el socket
+ * vuelve a ser writable, mientras seguimos leyendo respuestas. Con un
+ * sendall() bloqueante, si el server deja de leer hasta poder enviar
+ * sus respuestas y nosotros dejamos de leerlas hasta terminar de
+ * enviar, ambos quedan trabados (deadlock).
+ *
+ * Uso:
+ *
+ *  ./load_generator <hostname> <servicename> <threads> <conns-per-thread> <seconds> <payload> [<rate>]
+ *
+ * payload es un tamaño fijo en bytes (ej: 64) o un rango MIN-MAX
+ * (ej: 16-4096) del cual se elige uniformemente el tamaño de cada request.
+ *
+ * Si payload empieza con / el server no es un echo sino uno HTTP/1.1 y
+ * cada request es un "GET <payload>" (con keep-alive). La respuesta se
+ * da por completada al recibir sus headers y Content-Length bytes de body.
+ *
+ * Si se da rate (requests por segundo, en total) el modo es open-loop,
+ * de otro modo es closed-loop.
+ *
+ * El resultado se escribe en stdout en formato JSON. Por ejemplo:
+ *
+ *  ./load_generator 127.0.0.1 3129 4 16 10 64
+ *  ./load_generator 127.0.0.1 3129 4 16 10 16-4096 20000
+ *  ./load_generator 127.0.0.1 3129 4 16 10 /health
+ * */
+
+struct Config {
+    const char *hostname;
+    const char *servicename;
+    int threads;
+    int connections;
+    double seconds;
+    unsigned int min_payload;
+    unsigned int max_payload;
+    const char *http_path;  // nullptr si el server es un echo
+    double rate;    // 0 es closed-loop
+};
+
+struct Result {
+    Histogram latency;
+    Histogram uncorrected;  // solo closed-loop, vease arriba
+    unsigned long long requests;
+    unsigned long long bytes;
+    unsigned long long unfinished;
+    std::string error;
+
+    Result() : requests(0), bytes(0), unfinished(0) {}
+};
+
+/*
+ * Un request enviado del que estamos esperando la respuesta.
+ * start_ns es el momento desde el cual se mide la latencia
+ * y remaining cuantos bytes nos faltan recibir.
+ * */
+struct Pending {
+    long long start_ns;
+    unsigned int remaining;
+};
+
+struct Connection {
+    Socket skt;
+    std::deque<Pending> pending;
+    std::string inbuf;  // respuesta HTTP parcial
+    std::string out;    // requests que el server todavia no acepto
+    size_t out_sent;    // cuanto de out ya se envio
+    bool writing;       // registrada en el Poller como writable
+
+    explicit Connection(Socket&& skt) : skt(std::move(skt)), out_sent(0), writing(false) {}
+};
+
+static const Delimiter END_OF_HEADERS("\r\n\r\n", 4);
+
+static long long now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class Worker {
+    const Config& cfg;
+    Result& result;
+
+    std::mt19937 rng;
+    std::uniform_int_distribution<unsigned int> sizes;
+    std::vector<char> payload;
+    std::string http_request;
+
+    std::vector<std::unique_ptr<Connection>> conns;
+    Poller poller;
+
+    // Latencias medidas (sin corregir) en closed-loop: su media es el
+    // intervalo esperado para Histogram::record_corrected()
+    long long measured_ns;
+    unsigned long long measured;
+
+    void send_request(Connection& conn, long long start_ns) {
+        if (this->cfg.http_path) {
+            conn.pending.push_back(Pending{start_ns, 0});
+            conn.out.append(this->http_request);
+        } else {
+            unsigned int sz = this->sizes(this->rng);
+            conn.pending.push_back(Pending{start_ns, sz});
+            conn.out.append(this->payload.data(), sz);
+        }
+
+        /*
+         * Si el server no acepta todo ahora, el resto se envia cuando el
+         * socket sea writable. En open-loop la demora igual se le cobra
+         * a la latencia de los requests (se mide desde start_ns).
+         * */
+        this->flush(conn);
+    }
+
+    /*
+     * Envia lo pendiente de la conexion hasta que se termine o el kernel
+     * no acepte mas y registra el socket como writable solo mientras
+     * quede algo.
+     * */
+    void flush(Connection& conn) {
+        bool was_closed = false;
+        while (conn.out_sent < conn.out.size()) {
+            int s = conn.skt.sendsome(conn.out.data() + conn.out_sent, conn.out.size() - conn.out_sent, &was_closed);
+            if (was_closed)
+                throw std::runtime_error("Connection closed by the server");
+            if (s < 0)
+                break;
+
+            conn.out_sent += s;
+        }
+
+        const bool want_write = conn.out_sent < conn.out.size();
+        if (not want_write) {
+            conn.out.clear();
+            conn.out_sent = 0;
+        }
+
+        if (want_write != conn.writing) {
+            this->poller.modify(conn.skt, &conn, true, want_write);
+            conn.writing = want_write;
+        }
+    }
+
+    /*
+     * Registra la latencia de un request completado.
+     * */
+    void complete(long long start_ns, long long now, bool closed_loop) {
+        long long latency = now - start_ns;
+        ++this->result.requests;
+
+        if (not closed_loop) {
+            this->result.latency.record(latency);
+            return;
+        }
+
+        long long expected = this->measured ? this->measured_ns / (long long)this->measured : 0;
+        this->result.latency.record_corrected(latency, expected);
+        this->result.uncorrected.record(latency);
+
+        this->measured_ns += latency;
+        ++this->measured;
+    }
+
+    /*
+     * Recibe lo que haya en la conexion y completa los requests
+     * pendientes. Como el server es un echo, las respuestas llegan
+     * en el mismo orden y con el mismo tamaño que los requests.
+     * */
+    void receive(Connection& conn, bool closed_loop) {
+        char buf[64 * 1024];
+        bool was_closed = false;
+
+        int r = conn.skt.recvsome(buf, sizeof(buf), &was_closed);
+        if (was_closed)
+            throw std::runtime_error("Connection closed by the server");
+        if (r < 0)
+            return;     // al final no habia nada para leer
+
+        long long now = now_ns();
+        this->result.bytes += r;
+
+        if (this->cfg.http_path) {
+            this->receive_http(conn, buf, r, now, closed_loop);
+            return;
+        }
+
+        unsigned int left = r;
+        while (left > 0 and not conn.pending.empty()) {
+            Pending& p = conn.pending.front();
+            unsigned int taken = std::min(left, p.remaining);
+            p.remaining -= taken;
+            left -= taken;
+
+            if (p.remaining == 0) {
+                this->complete(p.start_ns, now, closed_loop);
+                conn.pending.pop_front();
+
+                if (closed_loop)
+                    this->send_request(conn, now_ns());
+            }
+        }
+    }
+
+    /*
+     * Acumula lo recibido y completa un request por cada respuesta
+     * HTTP entera (headers + Content-Length bytes de body).
+     * */
+    void receive_http(Connection& conn, const char *buf, int r, long long now, bool closed_loop) {
+        conn.inbuf.append(buf, r);
+
+        size_t pos = 0;
+        while (not conn.pending.empty()) {
+            const char *begin = conn.inbuf.data() + pos;
+            const char *end = END_OF_HEADERS.find(begin, conn.inbuf.data() + conn.inbuf.size());
+            if (not end)
+                break;
+
+            size_t body = 0;
+            const char *cl = (const char*)memmem(begin, end - begin, "Content-Length:", 15);
+            if (cl)
+                body = strtoul(cl + 15, nullptr, 10);
+
+            size_t total = end + 4 - begin + body;
+            if (conn.inbuf.size() - pos < total)
+                break;
+
+            pos += total;
+            this->complete(conn.pending.front().start_ns, now, closed_loop);
+            conn.pending.pop_front();
+
+            if (closed_loop)
+                this->send_request(conn, now_ns());
+        }
+
+        conn.inbuf.erase(0, pos);
+    }
+
+    public:
+    Worker(const Config& cfg, Result& result, unsigned int seed) :
+        cfg(cfg), result(result), rng(seed),
+        sizes(cfg.min_payload, cfg.max_payload),
+        payload(cfg.max_payload, 'x'), measured_ns(0), measured(0) {
+        if (cfg.http_path)
+            this->http_request = std::string("GET ") + cfg.http_path + " HTTP/1.1\r\nHost: " + cfg.hostname + "\r\n\r\n";
+    }
+
+    void run() {
+        for (int i = 0; i < this->cfg.connections; ++i) {
+            std::unique_ptr<Connection> conn(new Connection(Socket(cfg.hostname, cfg.servicename)));
+            conn->skt.set_nonblocking(true);
+            this->poller.add(conn->skt, conn.get(), true, false);
+            this->conns.push_back(std::move(conn));
+        }
+
+        const bool closed_loop = this->cfg.rate <= 0;
+        const long long begin = now_ns();
+        const long long deadline = begin + (long long)(this->cfg.seconds * 1e9);
+
+        // En open-loop cada thread se encarga de una fraccion de la tasa
+        const long long interval = closed_loop ? 0 : (long long)(this->cfg.threads * 1e9 / this->cfg.rate);
+        long long next = begin;
+        unsigned int rr = 0;
+
+        if (closed_loop) {
+            for (auto& conn : this->conns)
+                this->send_request(*conn, now_ns());
+        }
+
+        Poller::Event events[64];
+        long long now = now_ns();
+        while (now < deadline) {
+            if (not closed_loop) {
+                // Enviamos todos los requests cuyo momento ya llego
+                // (si nos atrasamos, nos ponemos al dia de golpe)
+                while (next <= now and next < deadline) {
+                    Connection& conn = *this->conns[rr++ % this->conns.size()];
+                    this->send_request(conn, next);
+                    next += interval;
+                }
+            }
+
+            long long wake = closed_loop ? deadline : std::min(next, deadline);
+            // Redondeamos para arriba: un timeout de 0 ms nos haria girar
+            // (busy loop) robandole CPU al server que queremos medir.
+            int timeout_ms = (int)std::max(0LL, (wake - now + 999999) / 1000000);
+
+            int n = this->poller.wait(events, 64, timeout_ms);
+            for (int i = 0; i < n; ++i) {
+                Connection& conn = *(Connection*)events[i].data;
+                if (events[i].writable)
+                    this->flush(conn);
+                if (events[i].readable or events[i].hangup)
+                    this->receive(conn, closed_loop);
+            }
+
+            now = now_ns();
+        }
+
+        /*
+         * Los requests que no llegaron a completarse tambien cuentan:
+         * ignorarlos seria otra forma de omision coordinada. Registramos
+         * su latencia como "al menos hasta ahora".
+         * */
+        for (auto& conn : this->conns) {
+            for (auto& p : conn->pending) {
+                this->result.latency.record(now - p.start_ns);
+                if (closed_loop)
+                    this->result.uncorrected.record(now - p.start_ns);
+                ++this->result.unfinished;
+            }
+        }
+    }
+};
+
+static void run_worker(const Config *cfg, Result *result, unsigned int seed) try {
+    Worker worker(*cfg, *result, seed);
+    worker.run();
+} catch (const std::exception& err) {
+    // No dejamos que la excepcion escape del thread (abortaria el programa)
+    result->error = err.what();
+}
+
+static void parse_payload(const char *arg, Config& cfg) {
+    cfg.http_path = nullptr;
+    if (arg[0] == '/') {
+        cfg.http_path = arg;
+        cfg.min_payload = cfg.max_payload = 1;
+        return;
+    }
+
+    const char *dash = strchr(arg, '-');
+    cfg.min_payload = atoi(arg);
+    cfg.max_payload = dash ? atoi(dash + 1) : cfg.min_payload;
+
+    if (cfg.min_payload == 0 or cfg.max_payload < cfg.min_payload)
+        throw std::runtime_error("Invalid payload size (expected N or MIN-MAX, N > 0)");
+}
+
+int main(int argc, char *argv[]) try {
+    if (argc != 7 and argc != 8) {
+        std::cerr << "Bad program call. Expected " << argv[0]
+                  << " <hostname> <servicename> <threads> <conns-per-thread> <seconds> <payload> [<rate>]\n";
+        return -1;
+    }
+
+    Config cfg;
+    cfg.hostname = argv[1];
+    cfg.servicename = argv[2];
+    cfg.threads = atoi(argv[3]);
+    cfg.connections = atoi(argv[4]);
+    cfg.seconds = atof(argv[5]);
+    parse_payload(argv[6], cfg);
+    cfg.rate = argc == 8 ? atof(argv[7]) : 0;
+
+    if (cfg.threads <= 0 or cfg.connections <= 0 or cfg.seconds <= 0)
+        throw std::runtime_error("threads, conns-per-thread and seconds must be positive");
+
+    std::vector<Result> results(cfg.threads);
+    std::vector<std::thread> threads;
+
+    long long begin = now_ns();
+    for (int i = 0; i < cfg.threads; ++i)
+        threads.push_back(std::thread(run_worker, &cfg, &results[i], 1234 + i));
+
+    for (auto& th : threads)
+        th.join();
+    double elapsed = (now_ns() - begin) / 1e9;
+
+    Result total;
+    for (auto& r : results) {
+        if (not r.error.empty())
+            throw std::runtime_error(r.error);
+
+        total.latency.merge(r.latency);
+        total.uncorrected.merge(r.uncorrected);
+        total.requests += r.requests;
+        total.bytes += r.bytes;
+        total.unfinished += r.unfinished;
+    }
+
+    std::cout << "{\n"
+              << "  \"mode\": \"" << (cfg.rate > 0 ? "open-loop" : "closed-loop") << "\",\n"
+              << "  \"threads\": " << cfg.threads << ",\n"
+              << "  \"connections\": " << cfg.threads * cfg.connections << ",\n"
+              << "  \"payload\": ";
+    if (cfg.http_path)
+        std::cout << "\"GET " << cfg.http_path << "\",\n";
+    else
+        std::cout << "[" << cfg.min_payload << ", " << cfg.max_payload << "],\n";
+    std::cout
+              << "  \"target_rate\": " << cfg.rate << ",\n"
+              << "  \"elapsed_s\": " << elapsed << ",\n"
+              << "  \"requests\": " << total.requests << ",\n"
+              << "  \"unfinished\": " << total.unfinished << ",\n"
+              << "  \"requests_per_s\": " << total.requests / elapsed << ",\n"
+              << "  \"mbytes_per_s\": " << total.bytes / elapsed / 1e6 << ",\n"
+              << "  \"latency_us\": ";
+    total.latency.write_json(std::cout, 1000.0);
+    if (cfg.rate <= 0) {
+        std::cout << ",\n  \"latency_uncorrected_us\": ";
+        total.uncorrected.write_json(std::cout, 1000.0);
+    }
+    std::cout << "\n}\n";
+
+    return 0;
+} catch (const std::exception& err) {
+    std::cerr << "Something went wrong and an exception was caught: " << err.what() << "\n";
+    return -1;
+} catch (...) {
+    std::cerr << "Something went wrong and an unknown exception was caught.\n";
+    return -1;
+}
@@ -0,0 +1,144 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+/*
+ * Cola acotada y lock-free de multiples productores y un unico
+ * consumidor (MPSC: multi-producer single-consumer).
+ *
+ * Una cola con un std::mutex funciona bien hasta que muchos threads
+ * la usan a la vez: el mutex se convierte en el cuello de botella y
+ * los threads pasan mas tiempo esperando el lock que trabajando.
+ *
+ * Esta cola es la de Dmitry Vyukov ("bounded MPMC queue"): un arreglo
+ * circular de celdas donde cada celda tiene un numero de secuencia que
+ * dice si esta libre para escribir (seq == pos) o lista para leer
+ * (seq == pos + 1). Los productores compiten por una posicion con un
+ * compare-and-swap sobre tail; el consumidor, al ser uno solo, avanza
+ * head sin atomicos.
+ *
+ * T puede ser cualquier tipo movible, en particular Socket.
+ *
+ * Por ser un template todo el codigo esta en el header: el compilador
+ * necesita verlo para generar MpscQueue<Socket>, MpscQueue<int>, etc.
+ * */
+template<class T>
+class MpscQueue {
+    struct Cell {
+        std::atomic<size_t> seq;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    const size_t mask;
+
+    // tail lo tocan los productores y head el consumidor. Los separamos
+    // con padding para que no compartan linea de cache (false sharing).
+    char pad0[64];
+    std::atomic<size_t> tail;
+    char pad1[64];
+    size_t head;
+    char pad2[64];
+
+    public:
+    /*
+     * capacity debe ser potencia de 2 asi calcular la celda de una
+     * posicion es un AND (pos & mask) y no un modulo.
+     * */
+    explicit MpscQueue(size_t capacity) : cells(new Cell[capacity]), mask(capacity - 1), tail(0), head(0) {
+        if (capacity < 2 or (capacity & (capacity - 1)) != 0)
+            throw std::invalid_argument("MpscQueue capacity must be a power of 2");
+
+        for (size_t i = 0; i < capacity; ++i)
+            this->cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    /*
+     * Encola item moviendolo a la cola. Thread-safe: la pueden llamar
+     * muchos threads a la vez.
+     *
+     * Si la cola esta llena retorna false y item *no* se mueve (el
+     * caller lo sigue teniendo y puede reintentar o darselo a otro).
+     * */
+    bool try_push(T& item) {
+        Cell *cell;
+        size_t pos = this->tail.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &this->cells[pos & this->mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+            if (diff == 0) {
+                // Celda libre: intentamos reservarla. Si otro productor
+                // nos gano, compare_exchange_weak nos actualiza pos.
+                if (this->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                // La celda todavia tiene un item sin consumir: llena
+                return false;
+            } else {
+                pos = this->tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        new (&cell->storage) T(std::move(item));
+
+        // release: el consumidor que vea seq == pos + 1 vera el item
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*
+     * Desencola un item moviendolo a item. Solo la puede llamar
+     * el (unico) thread consumidor.
+     *
+     * Retorna false si la cola esta vacia.
+     * */
+    bool try_pop(T& item) {
+        Cell *cell = &this->cells[this->head & this->mask];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        if ((intptr_t)seq - (intptr_t)(this->head + 1) < 0)
+            return false;
+
+        T *stored = reinterpret_cast<T*>(&cell->storage);
+        item = std::move(*stored);
+        stored->~T();
+
+        // La celda queda libre para la siguiente vuelta del arreglo
+        cell->seq.store(this->head + this->mask + 1, std::memory_order_release);
+        ++this->head;
+        return true;
+    }
+
+    /*
+     * Retorna si la cola esta vacia. Solo la puede llamar el consumidor
+     * (para los productores el resultado ya podria estar desactualizado).
+     * */
+    bool empty() const {
+        const Cell *cell = &this->cells[this->head & this->mask];
+        size_t seq = cell->seq.load(std::memory_order_seq_cst);
+        return (intptr_t)seq - (intptr_t)(this->head + 1) < 0;
+    }
+
+    /*
+     * Los items que quedaron sin consumir se destruyen (para un Socket
+     * eso significa cerrar la conexion).
+     * */
+    ~MpscQueue() {
+        T item;
+        while (this->try_pop(item)) {}
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+};
+
+#endif
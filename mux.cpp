@@ -0,0 +1,442 @@
+#include "mux.h"
+
+#include <string.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include "socket.h"
+#include "wire.h"
+
+enum FrameType : uint8_t {
+    DATA = 0,
+    WINDOW = 1,
+    FIN = 2,
+    OPEN = 3,
+};
+
+struct FrameHeader {
+    uint8_t type;
+    uint32_t id;
+    uint32_t len;
+};
+
+typedef WireLayout<FrameHeader,
+        WIRE_FIELD(FrameHeader, type),
+        WIRE_FIELD(FrameHeader, id),
+        WIRE_FIELD(FrameHeader, len)> FrameHeaderWire;
+
+static const unsigned int HEADER_SIZE = FrameHeaderWire::SIZE;
+static_assert(HEADER_SIZE == 9, "the Mux frame header is 9 bytes long (see mux.h)");
+
+static void put_header(char *buf, uint8_t type, uint32_t id, uint32_t len) {
+    FrameHeaderWire::encode(FrameHeader{ type, id, len }, buf);
+}
+
+// Se pasa por referencia a std::chrono::milliseconds: necesita definicion
+const unsigned int Mux::CLOSE_TIMEOUT_MS;
+
+Mux::State::State(uint32_t id) :
+    id(id), send_window(INITIAL_WINDOW), fin_requested(false), fin_sent(false), scheduled(false),
+    in_pos(0), consumed(0), fin_received(false), released(false) {}
+
+Mux::Mux(Socket& skt, bool initiator) :
+    skt(skt), next_id(initiator ? 1 : 2), stopping(false), writer_done(false), broken(false) {
+    this->reader = std::thread(&Mux::read_loop, this);
+    this->writer = std::thread(&Mux::write_loop, this);
+}
+
+bool Mux::sendable(const State& st) const {
+    if (not st.out.empty())
+        return st.send_window > 0;
+    return st.fin_requested and not st.fin_sent;
+}
+
+/*
+ * Si algun stream tiene datos sin enviar, aunque no sea sendable()
+ * porque espera ventana del peer. Se llama con el mutex tomado.
+ * */
+bool Mux::has_unsent() const {
+    for (const auto& it : this->streams) {
+        if (not it.second->out.empty())
+            return true;
+    }
+    return false;
+}
+
+/*
+ * Pone al stream al final de la ronda del escritor si tiene algo
+ * para enviar y no estaba ya en ella. Se llama con el mutex tomado.
+ * */
+void Mux::schedule(State& st) {
+    if (st.scheduled or not this->sendable(st))
+        return;
+
+    st.scheduled = true;
+    this->ready.push_back(st.id);
+    this->writer_cv.notify_one();
+}
+
+/*
+ * La aplicacion leyo (o descartamos) n bytes del stream: cuando se
+ * junta media ventana se la devolvemos al emisor. Devolverla de a
+ * pedacitos seria un frame WINDOW por cada recvsome().
+ * */
+void Mux::consume(State& st, uint32_t n) {
+    st.consumed += n;
+    if (st.consumed >= INITIAL_WINDOW / 2) {
+        this->control.push_back(Control{WINDOW, st.id, st.consumed});
+        st.consumed = 0;
+        this->writer_cv.notify_one();
+    }
+}
+
+void Mux::maybe_release(uint32_t id) {
+    auto it = this->streams.find(id);
+    if (it == this->streams.end())
+        return;
+
+    const State& st = *it->second;
+    if (st.released and st.fin_sent and st.fin_received)
+        this->streams.erase(it);
+}
+
+void Mux::fail(const std::string& why) {
+    std::unique_lock<std::mutex> lock(this->m);
+    if (not this->broken) {
+        this->broken = true;
+        this->error = why;
+    }
+    this->streams_cv.notify_all();
+    this->writer_cv.notify_all();
+}
+
+Mux::State& Mux::state_of(uint32_t id) {
+    return *this->streams.at(id);
+}
+
+void Mux::read_loop() try {
+    std::vector<char> payload(MAX_FRAME);
+
+    while (true) {
+        /*
+         * Igual que en CompressedSocket: un cierre entre frames es un
+         * cierre "limpio"; en el medio de un frame recvall() lanza.
+         * */
+        char header[HEADER_SIZE];
+        bool was_closed = false;
+        this->skt.recvsome(header, 1, &was_closed);
+        if (was_closed) {
+            this->fail("");
+            return;
+        }
+        this->skt.recvall(header + 1, HEADER_SIZE - 1, &was_closed);
+
+        FrameHeader h;
+        FrameHeaderWire::decode(header, h);
+        uint8_t type = h.type;
+        uint32_t id = h.id, len = h.len;
+
+        if (type > OPEN or (type == DATA and len > MAX_FRAME))
+            throw std::runtime_error("Mux received a corrupted frame");
+
+        if (type == DATA)
+            this->skt.recvall(payload.data(), len, &was_closed);
+
+        std::unique_lock<std::mutex> lock(this->m);
+
+        if (type == OPEN) {
+            // Los ids del peer tienen la otra paridad y no se reusan
+            bool peer_parity = (id % 2) != (this->next_id % 2);
+            if (not peer_parity or this->streams.count(id))
+                throw std::runtime_error("Mux peer opened an invalid stream");
+
+            this->streams.emplace(id, std::unique_ptr<State>(new State(id)));
+            this->incoming.push_back(id);
+            this->streams_cv.notify_all();
+            continue;
+        }
+
+        auto it = this->streams.find(id);
+        if (it == this->streams.end())
+            continue;   // un stream ya liberado: el frame se ignora
+
+        State& st = *it->second;
+        if (type == DATA) {
+            if (st.released) {
+                // Nadie lo va a leer: lo descartamos pero devolvemos la
+                // ventana para que el emisor no se quede trabado
+                this->consume(st, len);
+            } else {
+                if (st.in.size() - st.in_pos + len > INITIAL_WINDOW)
+                    throw std::runtime_error("Mux peer exceeded the flow control window");
+                st.in.append(payload.data(), len);
+            }
+        } else if (type == WINDOW) {
+            st.send_window += len;
+            this->schedule(st);
+        } else {
+            st.fin_received = true;
+            this->maybe_release(id);
+        }
+
+        this->streams_cv.notify_all();
+    }
+} catch (const std::exception& err) {
+    this->fail(err.what());
+}
+
+void Mux::write_loop() try {
+    std::vector<char> frame(HEADER_SIZE + MAX_FRAME);
+
+    while (true) {
+        size_t n = 0;
+        {
+            std::unique_lock<std::mutex> lock(this->m);
+
+            // Al cerrar no alcanza con vaciar ready: un stream sin ventana
+            // no esta en ready pero tiene datos que esperan un WINDOW
+            this->writer_cv.wait(lock, [this] {
+                return this->broken or not this->control.empty() or not this->ready.empty()
+                    or (this->stopping and not this->has_unsent());
+            });
+
+            if (this->broken)
+                return;
+
+            if (not this->control.empty()) {
+                Control c = this->control.front();
+                this->control.pop_front();
+                put_header(frame.data(), c.type, c.id, c.value);
+                n = HEADER_SIZE;
+            } else if (not this->ready.empty()) {
+                uint32_t id = this->ready.front();
+                this->ready.pop_front();
+
+                State& st = this->state_of(id);
+                st.scheduled = false;
+
+                if (not st.out.empty()) {
+                    // Un frame por turno: a lo sumo MAX_FRAME y lo que permita la ventana
+                    uint32_t len = std::min<size_t>({ st.out.size(), MAX_FRAME, st.send_window });
+                    put_header(frame.data(), DATA, id, len);
+                    memcpy(frame.data() + HEADER_SIZE, st.out.data(), len);
+                    st.out.erase(0, len);
+                    st.send_window -= len;
+                    n = HEADER_SIZE + len;
+
+                    this->streams_cv.notify_all();  // hay lugar para encolar
+                    this->schedule(st);             // al final de la ronda
+                } else {
+                    put_header(frame.data(), FIN, id, 0);
+                    st.fin_sent = true;
+                    n = HEADER_SIZE;
+                    this->maybe_release(id);
+                }
+            } else {
+                // stopping y ya se envio todo
+                this->writer_done = true;
+                this->streams_cv.notify_all();
+                return;
+            }
+        }
+
+        // Enviamos sin el mutex: los streams pueden seguir encolando
+        bool was_closed = false;
+        this->skt.sendall(frame.data(), n, &was_closed);
+        if (was_closed) {
+            this->fail("");
+            return;
+        }
+    }
+} catch (const std::exception& err) {
+    this->fail(err.what());
+}
+
+Mux::Stream Mux::open() {
+    std::unique_lock<std::mutex> lock(this->m);
+    uint32_t id = this->next_id;
+    this->next_id += 2;
+    this->streams.emplace(id, std::unique_ptr<State>(new State(id)));
+
+    /*
+     * El OPEN va por la cola de control, que el escritor vacia en orden
+     * y antes que cualquier DATA: el peer conoce el stream antes de su
+     * primer dato aunque varios threads abran streams a la vez.
+     * */
+    this->control.push_back(Control{OPEN, id, 0});
+    this->writer_cv.notify_one();
+    return Stream(this, id);
+}
+
+Mux::Stream Mux::accept() {
+    std::unique_lock<std::mutex> lock(this->m);
+    this->streams_cv.wait(lock, [this] {
+        return this->broken or not this->incoming.empty();
+    });
+
+    if (this->incoming.empty())
+        throw std::runtime_error("Mux connection closed" + (this->error.empty() ? "" : ": " + this->error));
+
+    uint32_t id = this->incoming.front();
+    this->incoming.pop_front();
+    return Stream(this, id);
+}
+
+Mux::~Mux() {
+    {
+        std::unique_lock<std::mutex> lock(this->m);
+        this->stopping = true;
+        this->writer_cv.notify_all();
+
+        // El lector sigue recibiendo los WINDOW que destraban a los
+        // streams sin ventana
+        this->streams_cv.wait_for(lock, std::chrono::milliseconds(CLOSE_TIMEOUT_MS), [this] {
+            return this->broken or this->writer_done;
+        });
+    }
+
+    // Cerrando la conexion despertamos al lector (bloqueado en recv())
+    // y, si no termino a tiempo, al escritor (bloqueado en send() o
+    // esperando ventana: el lector roto lo despierta via fail())
+    try {
+        this->skt.shutdown(SHUT_RDWR);
+    } catch (const std::exception&) {
+        // El peer pudo haberla cerrado antes: no hay nada que hacer
+    }
+    this->writer.join();
+    this->reader.join();
+}
+
+Mux::Stream::Stream(Mux *mux, uint32_t id) : mux(mux), id_(id) {}
+
+int Mux::Stream::sendall(const void *data, unsigned int sz, bool *was_closed) {
+    std::unique_lock<std::mutex> lock(this->mux->m);
+    State& st = this->mux->state_of(this->id_);
+    *was_closed = false;
+
+    if (st.fin_requested)
+        throw std::runtime_error("Mux stream already closed for writing");
+
+    const char *p = (const char*)data;
+    unsigned int queued = 0;
+    while (queued < sz) {
+        this->mux->streams_cv.wait(lock, [this, &st] {
+            return this->mux->broken or st.out.size() < MAX_QUEUED;
+        });
+
+        if (this->mux->broken) {
+            if (not this->mux->error.empty())
+                throw std::runtime_error("Mux connection failed: " + this->mux->error);
+            *was_closed = true;
+            return 0;
+        }
+
+        unsigned int n = std::min(sz - queued, MAX_QUEUED - (unsigned int)st.out.size());
+        st.out.append(p + queued, n);
+        queued += n;
+        this->mux->schedule(st);
+    }
+
+    return sz;
+}
+
+int Mux::Stream::recvsome(void *data, unsigned int sz, bool *was_closed) {
+    std::unique_lock<std::mutex> lock(this->mux->m);
+    State& st = this->mux->state_of(this->id_);
+    *was_closed = false;
+
+    this->mux->streams_cv.wait(lock, [this, &st] {
+        return this->mux->broken or st.fin_received or st.in_pos < st.in.size();
+    });
+
+    if (st.in_pos < st.in.size()) {
+        unsigned int n = std::min(sz, (unsigned int)(st.in.size() - st.in_pos));
+        memcpy(data, st.in.data() + st.in_pos, n);
+        st.in_pos += n;
+
+        // Compactamos de vez en cuando para no mover bytes en cada lectura
+        if (st.in_pos == st.in.size()) {
+            st.in.clear();
+            st.in_pos = 0;
+        } else if (st.in_pos > INITIAL_WINDOW / 2) {
+            st.in.erase(0, st.in_pos);
+            st.in_pos = 0;
+        }
+
+        this->mux->consume(st, n);
+        return n;
+    }
+
+    if (not st.fin_received and not this->mux->error.empty())
+        throw std::runtime_error("Mux connection failed: " + this->mux->error);
+
+    *was_closed = true;
+    return 0;
+}
+
+int Mux::Stream::recvall(void *data, unsigned int sz, bool *was_closed) {
+    unsigned int received = 0;
+    *was_closed = false;
+
+    while (received < sz) {
+        int s = this->recvsome((char*)data + received, sz - received, was_closed);
+        if (*was_closed) {
+            // Mismo criterio que Socket::recvall()
+            throw std::runtime_error("Unexpected closed");
+        }
+        received += s;
+    }
+
+    return sz;
+}
+
+void Mux::Stream::close() {
+    std::unique_lock<std::mutex> lock(this->mux->m);
+    State& st = this->mux->state_of(this->id_);
+    st.fin_requested = true;
+    this->mux->schedule(st);
+}
+
+uint32_t Mux::Stream::id() const {
+    return this->id_;
+}
+
+Mux::Stream::~Stream() {
+    if (not this->mux)
+        return;
+
+    std::unique_lock<std::mutex> lock(this->mux->m);
+    State& st = this->mux->state_of(this->id_);
+    st.fin_requested = true;
+    st.released = true;
+
+    // Lo que no se leyo ya no se va a leer: devolvemos esa ventana
+    uint32_t unread = st.in.size() - st.in_pos;
+    st.in.clear();
+    st.in_pos = 0;
+    this->mux->consume(st, unread);
+
+    this->mux->schedule(st);
+    this->mux->maybe_release(this->id_);
+}
+
+Mux::Stream::Stream(Stream&& other) : mux(other.mux), id_(other.id_) {
+    other.mux = nullptr;
+}
+
+Mux::Stream& Mux::Stream::operator=(Stream&& other) {
+    if (this == &other)
+        return *this;
+
+    // Primero liberamos el stream que teniamos (como ~Stream())
+    Stream old(std::move(*this));
+
+    this->mux = other.mux;
+    this->id_ = other.id_;
+    other.mux = nullptr;
+    return *this;
+}
@@ -0,0 +1,209 @@
+#ifndef MUX_H
+#define MUX_H
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+class Socket;
+
+/*
+ * Multiplexor de streams sobre una unica conexion.
+ *
+ * Hoy cada "conversacion" logica necesita su propio Socket: un
+ * handshake, buffers en el kernel y un fd en cada extremo. Mux permite
+ * tener muchos streams bidireccionales e independientes sobre un mismo
+ * Socket, cada uno con una API igual a la de Socket (sendall(),
+ * recvsome(), recvall()).
+ *
+ * En el cable todo viaja en frames con un header de 9 bytes:
+ *
+ *      tipo (1 byte)       OPEN, DATA, WINDOW o FIN
+ *      stream (4 bytes, big endian)
+ *      largo (4 bytes, big endian)
+ *
+ * OPEN abre un stream y no lleva payload; DATA lleva largo bytes de
+ * payload (a lo sumo MAX_FRAME); WINDOW no lleva payload y largo es
+ * cuanto se amplia la ventana (ver abajo); FIN indica que el emisor no
+ * enviara mas nada en ese stream (como un shutdown(SHUT_WR)).
+ *
+ * Para que los ids no choquen, el que inicio la conexion (initiator)
+ * usa ids impares y el otro pares.
+ *
+ * Control de flujo: cada stream tiene una ventana de INITIAL_WINDOW
+ * bytes, lo maximo que el emisor puede enviar sin que el receptor los
+ * haya leido. A medida que la aplicacion lee, el receptor le devuelve
+ * ventana al emisor con frames WINDOW. Asi un stream cuya aplicacion
+ * no lee no puede acaparar la conexion ni la memoria del otro lado.
+ *
+ * Interleaving justo: Stream::sendall() no escribe en el Socket sino
+ * que encola; un thread escritor toma un frame de cada stream con datos
+ * por turno (round-robin). Una transferencia grande solo ocupa la
+ * conexion de a MAX_FRAME bytes y un request chico en otro stream sale
+ * en el siguiente turno, sin esperar a que termine la grande.
+ *
+ * Un thread lector recibe los frames y los reparte a los streams.
+ * Todos los metodos de Mux y de Mux::Stream son thread-safe: lo tipico
+ * es un thread por stream.
+ *
+ * Ambos extremos deben envolver su Socket en un Mux. El Socket debe
+ * seguir vivo mientras viva el Mux.
+ * */
+class Mux {
+    public:
+    static const unsigned int MAX_FRAME = 16 * 1024;
+    static const unsigned int INITIAL_WINDOW = 256 * 1024;
+
+    /*
+     * Lo que Stream::sendall() puede encolar por stream antes de
+     * bloquearse esperando que el escritor lo envie.
+     * */
+    static const unsigned int MAX_QUEUED = 64 * 1024;
+
+    /*
+     * Cuanto espera ~Mux() a que se termine de enviar lo encolado.
+     * */
+    static const unsigned int CLOSE_TIMEOUT_MS = 5000;
+
+    class Stream;
+
+    private:
+    struct State {
+        uint32_t id;
+
+        // Envio
+        std::string out;            // datos encolados sin enviar
+        uint32_t send_window;
+        bool fin_requested;         // Stream::close(): FIN despues de out
+        bool fin_sent;
+        bool scheduled;             // esta en Mux::ready
+
+        // Recepcion
+        std::string in;
+        size_t in_pos;
+        uint32_t consumed;          // leido y aun no devuelto como ventana
+        bool fin_received;
+
+        bool released;              // el Stream (handle) ya no existe
+
+        explicit State(uint32_t id);
+    };
+
+    struct Control {
+        uint8_t type;
+        uint32_t id;
+        uint32_t value;
+    };
+
+    Socket& skt;
+    uint32_t next_id;
+
+    std::mutex m;
+    std::condition_variable writer_cv;     // el escritor espera trabajo
+    std::condition_variable streams_cv;    // los streams esperan datos/ventana/espacio
+
+    std::unordered_map<uint32_t, std::unique_ptr<State>> streams;
+    std::deque<uint32_t> ready;            // streams con algo para enviar (round-robin)
+    std::deque<Control> control;           // frames OPEN y WINDOW pendientes
+    std::deque<uint32_t> incoming;         // streams abiertos por el peer sin aceptar
+
+    bool stopping;
+    bool writer_done;                      // el escritor envio todo y termino
+    bool broken;
+    std::string error;
+
+    std::thread reader;
+    std::thread writer;
+
+    void read_loop();
+    void write_loop();
+
+    void schedule(State& st);
+    bool sendable(const State& st) const;
+    bool has_unsent() const;
+    void consume(State& st, uint32_t n);
+    void maybe_release(uint32_t id);
+    void fail(const std::string& why);
+    State& state_of(uint32_t id);
+
+
+    public:
+    /*
+     * initiator debe ser true en un extremo (tipicamente el cliente)
+     * y false en el otro.
+     * */
+    Mux(Socket& skt, bool initiator);
+
+    /*
+     * Abre un stream nuevo: el peer lo recibira en su accept().
+     * */
+    Stream open();
+
+    /*
+     * Bloquea hasta que el peer abra un stream y lo retorna. Lanza
+     * std::runtime_error si la conexion se cerro.
+     * */
+    Stream accept();
+
+    /*
+     * Termina de enviar lo encolado y los FIN de los streams, incluso lo
+     * que esta esperando que el peer devuelva ventana, pero espera a lo
+     * sumo CLOSE_TIMEOUT_MS: un peer que no lee no puede colgar al
+     * destructor. Despues cierra la conexion (shutdown), lo que corta
+     * tambien un envio trabado, y espera a los threads lector y
+     * escritor. Si se agoto el tiempo lo que faltaba enviar se pierde.
+     * */
+    ~Mux();
+
+    Mux(const Mux&) = delete;
+    Mux& operator=(const Mux&) = delete;
+
+    /*
+     * Un stream. Es un handle (movible, no copiable): al destruirse hace
+     * close() y el Mux libera el estado del stream cuando ambos lados
+     * terminaron.
+     *
+     * La semantica es la de Socket: recvsome() pone was_closed en true
+     * cuando el peer hizo close() (y ya se leyo todo); sendall() lo pone
+     * en true si la conexion se cerro. Si la conexion se rompe (error de
+     * red o protocolo) se lanza std::runtime_error.
+     *
+     * Los Streams deben destruirse antes que su Mux.
+     * */
+    class Stream {
+        Mux *mux;
+        uint32_t id_;
+
+        Stream(Mux *mux, uint32_t id);
+        friend class Mux;
+
+        public:
+        int sendall(const void *data, unsigned int sz, bool *was_closed);
+        int recvsome(void *data, unsigned int sz, bool *was_closed);
+        int recvall(void *data, unsigned int sz, bool *was_closed);
+
+        /*
+         * Cierra la mitad de escritura: el peer, tras leer todo lo
+         * enviado, vera was_closed. Se puede seguir recibiendo.
+         * */
+        void close();
+
+        uint32_t id() const;
+
+        ~Stream();
+
+        Stream(const Stream&) = delete;
+        Stream& operator=(const Stream&) = delete;
+
+        Stream(Stream&&);
+        Stream& operator=(Stream&&);
+    };
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include <errno.h>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "poller.h"
+#include "socket.h"
+#include "shmsocket.h"
+#include "eventfd.h"
+#include "liberror.h"
+
+Poller::Poller() {
+    this->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (this->epfd == -1)
+        throw LibError(errno, "Poller epoll_create1 failed: ");
+}
+
+static void control(int epfd, int op, int fd, void *data, bool readable, bool writable) {
+    struct epoll_event ev;
+    ev.events = (readable ? EPOLLIN : 0) | (writable ? EPOLLOUT : 0);
+    ev.data.ptr = data;
+
+    if (epoll_ctl(epfd, op, fd, &ev) == -1)
+        throw LibError(errno, "Poller epoll_ctl failed (op %d, fd %d): ", op, fd);
+}
+
+void Poller::add(const Socket& skt, void *data, bool readable, bool writable) {
+    control(this->epfd, EPOLL_CTL_ADD, skt.skt, data, readable, writable);
+}
+
+void Poller::modify(const Socket& skt, void *data, bool readable, bool writable) {
+    control(this->epfd, EPOLL_CTL_MOD, skt.skt, data, readable, writable);
+}
+
+void Poller::remove(const Socket& skt) {
+    control(this->epfd, EPOLL_CTL_DEL, skt.skt, nullptr, false, false);
+}
+
+void Poller::add(const EventFd& efd, void *data) {
+    control(this->epfd, EPOLL_CTL_ADD, efd.fd, data, true, false);
+}
+
+void Poller::remove(const EventFd& efd) {
+    control(this->epfd, EPOLL_CTL_DEL, efd.fd, nullptr, false, false);
+}
+
+void Poller::add(const ShmSocket& shm, void *data, bool readable, bool writable) {
+    control(this->epfd, EPOLL_CTL_ADD, shm.ctl, data, readable or writable, false);
+}
+
+void Poller::modify(const ShmSocket& shm, void *data, bool readable, bool writable) {
+    control(this->epfd, EPOLL_CTL_MOD, shm.ctl, data, readable or writable, false);
+}
+
+void Poller::remove(const ShmSocket& shm) {
+    control(this->epfd, EPOLL_CTL_DEL, shm.ctl, nullptr, false, false);
+}
+
+int Poller::wait(Event *events, int max_events, int timeout_ms) {
+    /*
+     * epoll_wait() escribe en un arreglo de struct epoll_event que
+     * despues traducimos a Event. Para no reservar memoria en cada
+     * llamada usamos un arreglo en el stack y, si nos piden mas eventos,
+     * los procesamos de a tandas (los que no entren quedaran para la
+     * proxima llamada: epoll no los pierde).
+     * */
+    struct epoll_event evs[64];
+    if (max_events > 64)
+        max_events = 64;
+
+    int n = epoll_wait(this->epfd, evs, max_events, timeout_ms);
+    if (n == -1) {
+        if (errno == EINTR)
+            return 0;
+        throw LibError(errno, "Poller epoll_wait failed: ");
+    }
+
+    for (int i = 0; i < n; ++i) {
+        events[i].data = evs[i].data.ptr;
+        events[i].readable = evs[i].events & EPOLLIN;
+        events[i].writable = evs[i].events & EPOLLOUT;
+        events[i].hangup = evs[i].events & (EPOLLHUP | EPOLLERR);
+    }
+
+    return n;
+}
+
+Poller::~Poller() {
+    ::close(this->epfd);
+}
@@ -0,0 +1,100 @@
+#ifndef POLLER_H
+#define POLLER_H
+
+class Socket;
+class ShmSocket;
+class EventFd;
+
+/*
+ * Poller: espera por eventos en muchos Sockets a la vez.
+ *
+ * Con un Socket bloqueante un thread solo puede esperar por *un*
+ * cliente a la vez. Si queremos que un unico thread atienda a muchos
+ * sockets necesitamos preguntarle al sistema operativo "cual de todos
+ * estos sockets tiene algo para leer (o espacio para escribir)?".
+ *
+ * Eso es lo que hace epoll() en Linux. Lease man 7 epoll
+ *
+ * Poller es amigo (friend) de Socket: es el que registra el file
+ * descriptor del Socket en epoll sin que el codigo del usuario tenga
+ * que tocarlo.
+ *
+ * Cada Socket se registra junto con un puntero "data" opaco que
+ * Poller::wait() devuelve tal cual en cada evento. Tipicamente apunta
+ * al objeto que representa la conexion.
+ * */
+class Poller {
+    int epfd;
+
+    public:
+    /*
+     * Un evento retornado por Poller::wait().
+     *
+     * hangup es true si el peer cerro la conexion o hubo un error:
+     * en ese caso lo siguiente que hay que hacer es un recvsome()
+     * para enterarse (was_closed o excepcion).
+     * */
+    struct Event {
+        void *data;
+        bool readable;
+        bool writable;
+        bool hangup;
+    };
+
+    Poller();
+
+    /*
+     * Registra el socket para ser notificado cuando haya algo para
+     * leer (readable) y/o espacio para escribir (writable).
+     *
+     * Poller no toma ownership del Socket: el Socket debe seguir vivo
+     * (y no moverse) mientras este registrado.
+     * */
+    void add(const Socket& skt, void *data, bool readable, bool writable);
+
+    /*
+     * Cambia los eventos por los que se espera en un socket ya registrado.
+     * */
+    void modify(const Socket& skt, void *data, bool readable, bool writable);
+
+    /*
+     * Deja de esperar eventos del socket.
+     * */
+    void remove(const Socket& skt);
+
+    /*
+     * Registra/desregistra un EventFd (vease eventfd.h): el evento
+     * sera readable cuando otro thread llame a EventFd::notify().
+     * */
+    void add(const EventFd& efd, void *data);
+    void remove(const EventFd& efd);
+
+    /*
+     * Registra/modifica/desregistra un ShmSocket no bloqueante (vease
+     * ShmSocket::set_nonblocking()). Para un ShmSocket readable y
+     * writable son el mismo evento: "el otro lado dejo datos o lugar,
+     * o se fue"; con cualquiera de los dos en true se lo espera.
+     * */
+    void add(const ShmSocket& shm, void *data, bool readable, bool writable);
+    void modify(const ShmSocket& shm, void *data, bool readable, bool writable);
+    void remove(const ShmSocket& shm);
+
+    /*
+     * Bloquea hasta que haya al menos un evento o hasta que pasen
+     * timeout_ms milisegundos (-1 para esperar por siempre).
+     *
+     * Escribe a lo sumo max_events eventos en events y retorna cuantos
+     * escribio (0 si se cumplio el timeout).
+     *
+     * Si una signal interrumpe la espera se retorna 0 como si fuera
+     * un timeout.
+     * */
+    int wait(Event *events, int max_events, int timeout_ms);
+
+    ~Poller();
+
+    Poller(const Poller&) = delete;
+    Poller& operator=(const Poller&) = delete;
+};
+
+#endif
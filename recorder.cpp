@@ -0,0 +1,240 @@
+#include "recorder.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+#include "liberror.h"
+
+static const char MAGIC[8] = { 'S', 'K', 'T', 'R', 'E', 'C', '0', '1' };
+
+/*
+ * Los fds mas altos que esto no se graban (una tabla fija evita
+ * locks y reservas de memoria en el camino caliente).
+ * */
+static const int MAX_FDS = 65536;
+
+static std::atomic<int> out_fd(-1);
+static std::atomic<unsigned int> writers(0);
+static std::atomic<uint64_t> start_us(0);
+static std::atomic<uint32_t> next_conn(1);
+
+// Id de conexion de cada fd (0: no se esta grabando ese fd)
+static std::atomic<uint32_t> conn_of_fd[MAX_FDS];
+
+static uint64_t monotonic_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static size_t put_varint(unsigned char *buf, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        buf[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (unsigned char)v;
+    return n;
+}
+
+static bool get_varint(const char **p, const char *end, uint64_t *v) {
+    *v = 0;
+    for (int shift = 0; *p < end and shift < 64; shift += 7) {
+        unsigned char c = (unsigned char)*(*p)++;
+        *v |= (uint64_t)(c & 0x7f) << shift;
+        if (not (c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+/*
+ * El archivo de salida mientras se escribe un registro.
+ *
+ * Sin esto, stop() podria cerrar el fd entre que otro thread lo lee de
+ * out_fd y hace el writev(): el kernel podria reusar ese numero para
+ * el proximo socket o archivo que se abra y le escribiriamos el
+ * registro a quien no corresponde. Cada escritor se anota en writers
+ * antes de volver a leer out_fd, y retire() espera a que no quede
+ * ninguno antes de cerrar.
+ *
+ * Sin grabar el costo sigue siendo leer un atomic: solo se anota quien
+ * vio un fd valido.
+ * */
+struct OutGuard {
+    int fd;
+
+    OutGuard() : fd(out_fd.load(std::memory_order_relaxed)) {
+        if (this->fd == -1)
+            return;
+
+        // seq_cst: o vemos el -1 que puso stop() o stop() ve que estamos
+        writers.fetch_add(1);
+        this->fd = out_fd.load();
+        if (this->fd == -1)
+            writers.fetch_sub(1, std::memory_order_release);
+    }
+
+    ~OutGuard() {
+        if (this->fd != -1)
+            writers.fetch_sub(1, std::memory_order_release);
+    }
+
+    OutGuard(const OutGuard&) = delete;
+    OutGuard& operator=(const OutGuard&) = delete;
+};
+
+/*
+ * Cierra un fd que ya se saco de out_fd cuando terminen los registros
+ * en curso. La espera es de a lo sumo un writev() por thread.
+ * */
+static void retire(int fd) {
+    if (fd == -1)
+        return;
+
+    while (writers.load() != 0)
+        std::this_thread::yield();
+    ::close(fd);
+}
+
+/*
+ * Escribe un registro con un unico writev() (vease recorder.h).
+ * Grabar es best-effort: un error de escritura no puede hacer fallar
+ * el send/recv de la aplicacion, asi que se ignora.
+ * */
+static void write_record(int fd, Recorder::Op op, uint32_t conn, const void *data, unsigned int len) {
+    unsigned char header[1 + 10 + 5 + 5];
+    size_t n = 0;
+
+    header[n++] = op;
+    n += put_varint(header + n, monotonic_us() - start_us.load(std::memory_order_relaxed));
+    n += put_varint(header + n, conn);
+    if (op == Recorder::SEND or op == Recorder::RECV)
+        n += put_varint(header + n, len);
+
+    struct iovec iov[2] = {
+        { header, n },
+        { (void*)data, len },
+    };
+
+    while (writev(fd, iov, len ? 2 : 1) == -1 and errno == EINTR) {}
+}
+
+void Recorder::start(const char *path) {
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1)
+        throw LibError(errno, "Recorder cannot open '%s': ", path);
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t wall_ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+    char header[16];
+    memcpy(header, MAGIC, sizeof(MAGIC));
+    memcpy(header + 8, &wall_ns, sizeof(wall_ns));
+    if (::write(fd, header, sizeof(header)) != sizeof(header)) {
+        int err = errno;
+        ::close(fd);
+        throw LibError(err, "Recorder cannot write '%s': ", path);
+    }
+
+    for (int i = 0; i < MAX_FDS; ++i)
+        conn_of_fd[i].store(0, std::memory_order_relaxed);
+
+    start_us.store(monotonic_us());
+
+    retire(out_fd.exchange(fd));
+}
+
+void Recorder::stop() {
+    retire(out_fd.exchange(-1));
+}
+
+void Recorder::open(int fd, Op op) {
+    if (fd < 0 or fd >= MAX_FDS)
+        return;
+
+    OutGuard out;
+    if (out.fd == -1)
+        return;
+
+    uint32_t conn = next_conn.fetch_add(1, std::memory_order_relaxed);
+    conn_of_fd[fd].store(conn, std::memory_order_relaxed);
+    write_record(out.fd, op, conn, nullptr, 0);
+}
+
+void Recorder::record(Op op, int fd, const void *data, unsigned int len) {
+    if (fd < 0 or fd >= MAX_FDS)
+        return;
+
+    OutGuard out;
+    if (out.fd == -1)
+        return;
+
+    uint32_t conn = conn_of_fd[fd].load(std::memory_order_relaxed);
+    if (conn == 0)
+        return;
+
+    write_record(out.fd, op, conn, data, len);
+}
+
+void Recorder::close(int fd) {
+    if (fd < 0 or fd >= MAX_FDS)
+        return;
+
+    OutGuard out;
+    if (out.fd == -1)
+        return;
+
+    // Hay que llamarlo *antes* del ::close(): despues otro thread podria
+    // recibir el mismo fd en un accept() y le borrariamos su id.
+    uint32_t conn = conn_of_fd[fd].exchange(0, std::memory_order_relaxed);
+    if (conn == 0)
+        return;
+
+    write_record(out.fd, CLOSE, conn, nullptr, 0);
+}
+
+const char* Recorder::first(const char *begin, const char *end) {
+    if (end - begin < 16 or memcmp(begin, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("Not a Recorder file (bad magic)");
+
+    return begin + 16;
+}
+
+bool Recorder::next(const char **p, const char *end, Record *rec) {
+    const char *q = *p;
+    if (q >= end)
+        return false;
+
+    uint8_t op = (uint8_t)*q++;
+    if (op < OPEN_ACCEPTED or op > CLOSE)
+        throw std::runtime_error("Corrupted Recorder file (unknown op)");
+
+    uint64_t ts, conn, len = 0;
+    if (not get_varint(&q, end, &ts) or not get_varint(&q, end, &conn))
+        return false;
+
+    if (op == SEND or op == RECV) {
+        if (not get_varint(&q, end, &len) or (uint64_t)(end - q) < len)
+            return false;
+    }
+
+    rec->op = (Op)op;
+    rec->timestamp_us = ts;
+    rec->conn = (uint32_t)conn;
+    rec->len = (uint32_t)len;
+    rec->data = q;
+
+    *p = q + len;
+    return true;
+}
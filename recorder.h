@@ -0,0 +1,101 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+
+/*
+ * Grabador de trafico.
+ *
+ * Para reproducir la carga de produccion no alcanza con un generador
+ * sintetico (load_generator): queremos los bytes reales, con los
+ * tiempos reales, de cada conexion. Con Recorder::start() cada
+ * Socket::sendsome()/recvsome() exitoso (y cada apertura y cierre de
+ * conexion) se graba en un archivo; despues replay lo reproduce contra
+ * un server a la misma velocidad, N veces mas rapido o lo mas rapido
+ * posible.
+ *
+ * Formato del archivo: el magic "SKTREC01", 8 bytes con el momento de
+ * inicio (CLOCK_REALTIME, en ns, host byte order) y una secuencia de
+ * registros:
+ *
+ *  op          1 byte (Recorder::Op)
+ *  timestamp   varint: microsegundos desde Recorder::start()
+ *  conn        varint: id de conexion (no es el fd: los fds se reusan)
+ *  len         varint: solo para SEND y RECV
+ *  payload     len bytes
+ *
+ * Los varint son LEB128 (7 bits por byte): un header tipico ocupa entre
+ * 5 y 8 bytes, el resto es el payload.
+ *
+ * Cada registro se escribe con un unico writev() sobre un archivo
+ * abierto con O_APPEND: los threads no se pisan entre si (no hace falta
+ * un lock) y lo grabado ya esta en el archivo aunque el proceso muera
+ * con un kill -9. El precio es una syscall extra (y dos operaciones
+ * atomicas) por cada send/recv mientras se graba; sin grabar el costo
+ * es leer un atomic.
+ *
+ * Dentro de una conexion los registros estan en orden; entre
+ * conexiones atendidas por threads distintos puede haber pequeños
+ * desordenes de timestamp.
+ *
+ * Solo se graban las conexiones abiertas despues de Recorder::start().
+ * Lo recibido con Socket::recv_to_fd() no se graba (nunca pasa por
+ * nuestros buffers).
+ * */
+class Recorder {
+    public:
+    enum Op : uint8_t {
+        OPEN_ACCEPTED = 1,  // conexion aceptada por un server
+        OPEN_CONNECTED,     // conexion iniciada por un cliente
+        SEND,
+        RECV,
+        CLOSE,
+    };
+
+    /*
+     * Un registro decodificado por Recorder::next(). data apunta dentro
+     * del buffer que se esta decodificando.
+     * */
+    struct Record {
+        Op op;
+        uint64_t timestamp_us;
+        uint32_t conn;
+        uint32_t len;
+        const char *data;
+    };
+
+    /*
+     * Empieza a grabar en path (lo trunca si existe). Lanza LibError si
+     * no se puede abrir.
+     *
+     * stop() (y start() si ya se estaba grabando) se puede llamar con
+     * otros threads usando Sockets: espera a que terminen los registros
+     * en curso antes de cerrar el archivo.
+     * */
+    static void start(const char *path);
+    static void stop();
+
+    /*
+     * Ganchos llamados por Socket. No hacen nada si no se esta grabando.
+     * */
+    static void open(int fd, Op op);
+    static void record(Op op, int fd, const void *data, unsigned int len);
+    static void close(int fd);
+
+    /*
+     * Valida el header del archivo (ya cargado en memoria en
+     * [begin, end)) y retorna un puntero al primer registro. Lanza
+     * std::runtime_error si no es un archivo de Recorder.
+     * */
+    static const char* first(const char *begin, const char *end);
+
+    /*
+     * Decodifica el registro en *p y avanza *p al siguiente. Retorna false
+     * al llegar a end o si el registro esta truncado (el proceso murio a
+     * mitad de un writev()): lo que esta antes sigue siendo valido.
+     * Lanza std::runtime_error si el op es desconocido.
+     * */
+    static bool next(const char **p, const char *end, Record *rec);
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "recvbuffer.h"
+
+#include <algorithm>
+
+#include "socket.h"
+
+static size_t next_power_of_2(size_t n) {
+    size_t p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+RecvBuffer::RecvBuffer(size_t min_size, size_t max_size) :
+    buf(new char[min_size]), sz(min_size), next_sz(min_size),
+    min_size(min_size), max_size(std::max(min_size, max_size)),
+    small_reads(0), max_lowat(1), lowat(1), stats() {
+    this->stats.peak = min_size;
+}
+
+int RecvBuffer::recvsome(Socket& skt, bool *was_closed) {
+    if (this->next_sz != this->sz) {
+        // Lo que habia ya se consumio: no hace falta copiarlo
+        this->buf.reset(new char[this->next_sz]);
+        this->sz = this->next_sz;
+        this->stats.peak = std::max(this->stats.peak, this->sz);
+    }
+
+    int n = skt.recvsome(this->buf.get(), this->sz, was_closed);
+
+    // Una lectura que no lleno el buffer (incluso una que no leyo nada,
+    // porque vencio el lowat_timeout_ms()) vuelve el lowat a 1
+    if (this->lowat > 1 and not *was_closed and (n < 0 or (size_t)n < this->sz))
+        this->update_lowat(skt, 1);
+
+    if (*was_closed or n <= 0)
+        return n;
+
+    ++this->stats.reads;
+    this->stats.bytes += n;
+
+    // Lleno: seguramente quedo mas en el socket
+    const bool full = (size_t)n == this->sz;
+    int pending = 0;
+    if (full and (this->sz < this->max_size or this->max_lowat > 1))
+        pending = skt.pending();
+
+    if (full and this->sz < this->max_size) {
+        size_t want = this->sz * 2;
+        if (pending > 0)
+            want = std::max(want, next_power_of_2(this->sz + pending));
+
+        this->next_sz = std::min(want, this->max_size);
+        this->small_reads = 0;
+        ++this->stats.grows;
+    } else if ((size_t)n <= this->sz / 4 and this->sz > this->min_size) {
+        if (++this->small_reads >= SHRINK_AFTER) {
+            this->next_sz = std::max(this->sz / 2, this->min_size);
+            this->small_reads = 0;
+            ++this->stats.shrinks;
+        }
+    } else {
+        this->small_reads = 0;
+    }
+
+    // Lleno y con mas en cola: el peer esta enviando mucho, que el
+    // proximo despertar traiga de una (hasta) un buffer. Un request que
+    // justo llena el buffer pero no tiene nada detras no lo sube
+    if (full and pending > 0 and this->max_lowat > 1)
+        this->update_lowat(skt, std::min(this->max_lowat, this->next_sz));
+
+    return n;
+}
+
+void RecvBuffer::update_lowat(Socket& skt, size_t want) {
+    if (want == this->lowat)
+        return;
+
+    skt.set_recv_lowat((int)want);
+    this->lowat = want;
+}
+
+char *RecvBuffer::data() {
+    return this->buf.get();
+}
+
+size_t RecvBuffer::size() const {
+    return this->sz;
+}
+
+void RecvBuffer::set_max_lowat(size_t bytes) {
+    this->max_lowat = std::max(bytes, (size_t)1);
+}
+
+unsigned int RecvBuffer::lowat_timeout_ms() const {
+    return this->lowat > 1 ? LOWAT_TIMEOUT_MS : 0;
+}
+
+const RecvBuffer::Stats& RecvBuffer::get_stats() const {
+    return this->stats;
+}
@@ -0,0 +1,112 @@
+#ifndef RECVBUFFER_H
+#define RECVBUFFER_H
+
+#include <stddef.h>
+
+#include <memory>
+
+class Socket;
+
+/*
+ * Buffer de recepcion que se adapta a lo que recibe su conexion.
+ *
+ * Con un buffer fijo hay que elegir: uno chico (512 bytes) hace un
+ * recv() por cada 512 bytes en una transferencia grande; uno grande
+ * (64 KiB) desperdicia memoria en cada una de las miles de conexiones
+ * que solo mandan mensajes de pocos bytes.
+ *
+ * RecvBuffer empieza chico y:
+ *
+ *  - crece cuando un recvsome() lo llena: seguramente quedo mas en el
+ *    socket. Se le pregunta al kernel cuanto (Socket::pending(), que
+ *    es un ioctl FIONREAD) y se crece de una hasta que entre todo
+ *    (al menos al doble), sin pasar de max_size.
+ *
+ *  - se achica a la mitad despues de SHRINK_AFTER lecturas seguidas
+ *    que usaron menos de un cuarto del buffer, sin bajar de min_size,
+ *    y devuelve la memoria.
+ *
+ * FIONREAD es un syscall extra asi que solo se consulta cuando el
+ * buffer se lleno, no en cada lectura.
+ *
+ * El cambio de tamaño se aplica en el siguiente recvsome(): lo
+ * recibido sigue en data() hasta entonces.
+ *
+ * Con min_size == max_size es un buffer fijo comun (util para
+ * comparar, vease bench_rcvbuf.cpp).
+ *
+ * Opcionalmente (set_max_lowat()) tambien maneja el SO_RCVLOWAT del
+ * socket (vease Socket::set_recv_lowat()) con el mismo criterio: lo
+ * sube mientras las lecturas llenan el buffer y queda mas en cola (el
+ * peer esta enviando mucho, conviene despertarse con mas datos) y lo
+ * vuelve a 1 con la primera lectura que no lo llena.
+ *
+ * Eso solo no alcanza: si el peer deja de enviar con menos de lowat
+ * bytes en cola (el final de una transferencia, o un cliente que
+ * espera la respuesta) el socket nunca se vuelve readable y no hay
+ * lectura que lo baje. Por eso mientras el lowat esta subido
+ * lowat_timeout_ms() retorna cuanto esperar a lo sumo: pasado ese
+ * tiempo sin datos hay que volver a llamar a recvsome() igual, que lee
+ * lo que haya (o nada) y baja el lowat. El Worker lo hace solo (vease
+ * Connection::read_timeout_ms()).
+ * */
+class RecvBuffer {
+    public:
+    static const size_t MIN_SIZE = 512;
+    static const size_t MAX_SIZE = 256 * 1024;
+    static const unsigned int SHRINK_AFTER = 8;
+    static const unsigned int LOWAT_TIMEOUT_MS = 5;
+
+    struct Stats {
+        unsigned long long reads;
+        unsigned long long bytes;
+        unsigned long long grows;
+        unsigned long long shrinks;
+        size_t peak;                // el mayor tamaño que tuvo el buffer
+    };
+
+    private:
+    std::unique_ptr<char[]> buf;
+    size_t sz;
+    size_t next_sz;
+    size_t min_size;
+    size_t max_size;
+    unsigned int small_reads;
+    size_t max_lowat;
+    size_t lowat;           // el SO_RCVLOWAT fijado en el socket
+    Stats stats;
+
+    void update_lowat(Socket& skt, size_t want);
+
+    public:
+    explicit RecvBuffer(size_t min_size = MIN_SIZE, size_t max_size = MAX_SIZE);
+
+    /*
+     * Hace un Socket::recvsome() sobre todo el buffer y retorna cuantos
+     * bytes se recibieron (que quedan en data()). Misma semantica de
+     * was_closed que Socket::recvsome().
+     * */
+    int recvsome(Socket& skt, bool *was_closed);
+
+    char *data();
+    size_t size() const;
+
+    /*
+     * Habilita el manejo del SO_RCVLOWAT, hasta bytes (sin pasar del
+     * tamaño del buffer). Con 0 o 1 (el default) no se toca.
+     * */
+    void set_max_lowat(size_t bytes);
+
+    /*
+     * Si el lowat esta subido, cuanto esperar a lo sumo por datos antes
+     * de llamar a recvsome() igual (vease arriba); si no, 0.
+     * */
+    unsigned int lowat_timeout_ms() const;
+
+    const Stats& get_stats() const;
+
+    RecvBuffer(const RecvBuffer&) = delete;
+    RecvBuffer& operator=(const RecvBuffer&) = delete;
+};
+
+#endif
@@ -0,0 +1,432 @@
+#include <iostream>
+#include "socket.h"
+#include "poller.h"
+#include "resolver.h"
+#include "recorder.h"
+#include "histogram.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <netdb.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <exception>
+
+/*
+ * Reproduce el trafico grabado con Recorder (vease recorder.h) contra
+ * un server.
+ *
+ * Cada conexion grabada es una sesion: replay abre una conexion por
+ * sesion y le envia al server lo que en la grabacion envio el cliente,
+ * esperando recibir tantos bytes como el server respondio.
+ * Si la grabacion se hizo en el server (conexiones aceptadas) lo que
+ * envio el cliente son los RECV; si se hizo en un cliente, los SEND.
+ *
+ * Cada envio sale en el momento grabado dividido por la velocidad
+ * (1 = tiempo real, 10 = diez veces mas rapido, max = sin esperas)
+ * pero nunca antes de haber recibido las respuestas que en la
+ * grabacion llegaron antes de ese envio: un cliente real no manda el
+ * segundo request sin haber leido la primera respuesta (salvo que
+ * haga pipelining, en cuyo caso la grabacion ya lo refleja).
+ *
+ * La latencia se mide desde que se envia un request (con nada
+ * pendiente) hasta recibir toda la respuesta esperada. Una sesion que
+ * no progresa durante 5 segundos (el server respondio menos de lo
+ * grabado) se da por estancada.
+ *
+ * Todas las sesiones corren concurrentemente en un unico thread con
+ * un Poller.
+ *
+ * Uso:
+ *
+ *  ./echo_server --record traffic.rec
+ *  ... trafico real ...
+ *  ./replay traffic.rec 127.0.0.1 3129 [<speed>|max]
+ *
+ * El resultado se escribe en stdout en formato JSON.
+ * */
+
+static const long long STALL_NS = 5LL * 1000 * 1000 * 1000;
+
+static long long now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Step {
+    bool send;          // false: esperar len bytes del server
+    uint64_t at_us;
+    const char *data;
+    uint32_t len;
+};
+
+struct Session {
+    enum State { WAITING, CONNECTING, RUNNING, DONE, FAILED };
+
+    uint64_t open_us;
+    bool accepted;
+    std::vector<Step> steps;
+
+    State state;
+    Socket skt;
+    size_t addr_index;                  // la direccion que se esta probando
+    size_t next;
+    bool timer_armed;
+
+    unsigned long long outstanding;     // bytes esperados aun no recibidos
+    long long request_ns;               // 0 si no hay un request en vuelo
+    long long progress_ns;
+
+    Session(uint64_t open_us, bool accepted) :
+        open_us(open_us), accepted(accepted), state(WAITING), addr_index(0), next(0), timer_armed(false),
+        outstanding(0), request_ns(0), progress_ns(0) {}
+};
+
+struct Totals {
+    Histogram latency;
+    unsigned long long sent;
+    unsigned long long received;
+    unsigned long long expected;
+    unsigned long long unexpected;      // bytes de mas que envio el server
+    unsigned long long completed;
+    unsigned long long failed;
+
+    Totals() : sent(0), received(0), expected(0), unexpected(0), completed(0), failed(0) {}
+};
+
+typedef std::pair<long long, Session*> Timer;
+
+class Replayer {
+    std::vector<std::unique_ptr<Session>> sessions;
+    uint64_t base_us;
+    double speed;   // 0: lo mas rapido posible
+
+    std::vector<std::string> addrs;
+    Poller poller;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    long long start_ns;
+    unsigned int running;
+
+    long long due(uint64_t at_us) const {
+        if (this->speed == 0)
+            return 0;
+        return this->start_ns + (long long)((at_us - this->base_us) * 1000 / this->speed);
+    }
+
+    void arm(Session *s, long long when) {
+        if (not s->timer_armed) {
+            s->timer_armed = true;
+            this->timers.push(Timer(when, s));
+        }
+    }
+
+    void fail(Session *s) {
+        if (s->state == Session::CONNECTING or s->state == Session::RUNNING)
+            this->poller.remove(s->skt);
+        s->skt = Socket();
+        s->state = Session::FAILED;
+        ++this->totals.failed;
+        --this->running;
+    }
+
+    void connect(Session *s) {
+        ++this->running;
+        this->try_addresses(s, "No address to connect to");
+    }
+
+    /*
+     * Igual que Fetcher::connect(): probamos las direcciones en orden,
+     * desde s->addr_index, hasta poder iniciar la conexion; si despues
+     * falla (finish_connect()) volvemos aca con la siguiente.
+     * */
+    void try_addresses(Session *s, std::string error) {
+        for (; s->addr_index < this->addrs.size(); ++s->addr_index) try {
+            const std::string& addr = this->addrs[s->addr_index];
+            s->progress_ns = now_ns();
+            s->skt = Socket::connect_nonblocking((const struct sockaddr*)addr.data(), addr.size());
+
+            this->poller.add(s->skt, s, false, true);
+            s->state = Session::CONNECTING;
+            return;
+        } catch (const std::exception& err) {
+            error = err.what();
+        }
+
+        std::cerr << "Session failed to connect: " << error << "\n";
+        this->fail(s);
+    }
+
+    /*
+     * Avanza la sesion tanto como se pueda: acumula lo que hay que
+     * esperar del server y envia todo lo que ya este "en horario".
+     * */
+    void advance(Session *s) {
+        bool was_closed = false;
+        while (s->next < s->steps.size()) {
+            const Step& step = s->steps[s->next];
+            if (not step.send) {
+                s->outstanding += step.len;
+                this->totals.expected += step.len;
+                ++s->next;
+                continue;
+            }
+
+            if (s->outstanding > 0)
+                return;     // primero las respuestas (vease arriba)
+
+            long long when = this->due(step.at_us);
+            long long now = now_ns();
+            if (when > now) {
+                this->arm(s, when);
+                return;
+            }
+
+            if (s->request_ns == 0)
+                s->request_ns = now;
+
+            s->skt.sendall(step.data, step.len, &was_closed);
+            if (was_closed)
+                throw std::runtime_error("Connection closed by the server");
+
+            this->totals.sent += step.len;
+            s->progress_ns = now;
+            ++s->next;
+        }
+
+        if (s->outstanding == 0) {
+            this->poller.remove(s->skt);
+            s->skt = Socket();
+            s->state = Session::DONE;
+            ++this->totals.completed;
+            --this->running;
+        }
+    }
+
+    void on_event(Session *s) {
+        if (s->state == Session::CONNECTING) {
+            int err = s->skt.finish_connect();
+            if (err != 0) {
+                this->poller.remove(s->skt);
+                s->skt = Socket();
+                s->state = Session::WAITING;
+
+                ++s->addr_index;
+                this->try_addresses(s, strerror(err));
+                return;
+            }
+
+            s->state = Session::RUNNING;
+            this->poller.modify(s->skt, s, true, false);
+            this->advance(s);
+            return;
+        }
+
+        char buf[64 * 1024];
+        bool was_closed = false;
+        int n = s->skt.recvsome(buf, sizeof(buf), &was_closed);
+        if (was_closed)
+            throw std::runtime_error("Connection closed by the server");
+
+        long long now = now_ns();
+        s->progress_ns = now;
+        this->totals.received += n;
+
+        unsigned long long consumed = std::min((unsigned long long)n, s->outstanding);
+        this->totals.unexpected += n - consumed;
+        s->outstanding -= consumed;
+
+        if (s->outstanding == 0 and consumed > 0 and s->request_ns != 0) {
+            this->totals.latency.record(now - s->request_ns);
+            s->request_ns = 0;
+        }
+
+        this->advance(s);
+    }
+
+    public:
+    Totals totals;
+
+    Replayer(const std::vector<char>& capture, double speed) : base_us(0), speed(speed), start_ns(0), running(0) {
+        std::unordered_map<uint32_t, Session*> by_conn;
+        const char *end = capture.data() + capture.size();
+        const char *p = Recorder::first(capture.data(), end);
+
+        Recorder::Record rec;
+        bool first = true;
+        while (Recorder::next(&p, end, &rec)) {
+            if (rec.op == Recorder::OPEN_ACCEPTED or rec.op == Recorder::OPEN_CONNECTED) {
+                this->sessions.emplace_back(new Session(rec.timestamp_us, rec.op == Recorder::OPEN_ACCEPTED));
+                by_conn[rec.conn] = this->sessions.back().get();
+
+                if (first or rec.timestamp_us < this->base_us)
+                    this->base_us = rec.timestamp_us;
+                first = false;
+                continue;
+            }
+
+            auto it = by_conn.find(rec.conn);
+            if (it == by_conn.end() or rec.op == Recorder::CLOSE)
+                continue;
+
+            Session *s = it->second;
+            bool from_client = (rec.op == Recorder::RECV) == s->accepted;
+            if (not from_client and not s->steps.empty() and not s->steps.back().send) {
+                s->steps.back().len += rec.len;     // respuestas consecutivas: una sola espera
+                continue;
+            }
+            s->steps.push_back(Step{from_client, rec.timestamp_us, rec.data, rec.len});
+        }
+    }
+
+    size_t count() const {
+        return this->sessions.size();
+    }
+
+    void run(const char *hostname, const char *servicename) {
+        Resolver resolver(hostname, servicename, false);
+        while (resolver.has_next()) {
+            struct addrinfo *addr = resolver.next();
+            this->addrs.emplace_back((const char*)addr->ai_addr, addr->ai_addrlen);
+        }
+        if (this->addrs.empty())
+            throw std::runtime_error("No address to connect to");
+
+        this->start_ns = now_ns();
+        for (auto& s : this->sessions)
+            this->timers.push(Timer(this->due(s->open_us), s.get()));
+
+        Poller::Event events[64];
+        long long last_check = this->start_ns;
+
+        while (this->running > 0 or not this->timers.empty()) {
+            long long now = now_ns();
+            while (not this->timers.empty() and this->timers.top().first <= now) {
+                Session *s = this->timers.top().second;
+                this->timers.pop();
+                s->timer_armed = false;
+
+                try {
+                    if (s->state == Session::WAITING)
+                        this->connect(s);
+                    else if (s->state == Session::RUNNING)
+                        this->advance(s);
+                } catch (const std::exception& err) {
+                    std::cerr << "Session failed: " << err.what() << "\n";
+                    this->fail(s);
+                }
+            }
+
+            // Redondeamos para arriba: con un timeout de 0 ms girariamos
+            // en vacio hasta que venza el proximo timer.
+            int timeout_ms = 100;
+            if (not this->timers.empty())
+                timeout_ms = std::min(100LL, (this->timers.top().first - now + 999999) / 1000000);
+
+            int n = this->poller.wait(events, 64, timeout_ms);
+            for (int i = 0; i < n; ++i) {
+                Session *s = (Session*)events[i].data;
+                if (s->state != Session::CONNECTING and s->state != Session::RUNNING)
+                    continue;
+
+                try {
+                    this->on_event(s);
+                } catch (const std::exception& err) {
+                    std::cerr << "Session failed: " << err.what() << "\n";
+                    this->fail(s);
+                }
+            }
+
+            now = now_ns();
+            if (now - last_check >= 100 * 1000 * 1000) {
+                last_check = now;
+                for (auto& s : this->sessions) {
+                    if (s->state == Session::RUNNING and s->outstanding > 0 and now - s->progress_ns > STALL_NS) {
+                        std::cerr << "Session stalled: " << s->outstanding << " bytes never arrived\n";
+                        this->fail(s.get());
+                    }
+                }
+            }
+        }
+    }
+
+    double recorded_seconds() const {
+        uint64_t last = this->base_us;
+        for (auto& s : this->sessions) {
+            for (auto& step : s->steps)
+                last = std::max(last, step.at_us);
+        }
+        return (last - this->base_us) / 1e6;
+    }
+};
+
+int main(int argc, char *argv[]) try {
+    if (argc != 4 and argc != 5) {
+        std::cerr << "Bad program call. Expected " << argv[0]
+                  << " <record-file> <hostname> <servicename> [<speed>|max]\n";
+        return -1;
+    }
+
+    // 0 es "lo mas rapido posible"
+    double speed = 1;
+    if (argc == 5 and strcmp(argv[4], "max") == 0) {
+        speed = 0;
+    } else if (argc == 5) {
+        speed = atof(argv[4]);
+        if (speed <= 0)
+            throw std::runtime_error("The speed must be a positive number or 'max'");
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (not in)
+        throw std::runtime_error(std::string("Cannot open the record file '") + argv[1] + "'");
+    std::vector<char> capture((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    Replayer replayer(capture, speed);
+
+    long long begin = now_ns();
+    replayer.run(argv[2], argv[3]);
+    double elapsed = (now_ns() - begin) / 1e9;
+
+    const Totals& t = replayer.totals;
+    std::cout << "{\n"
+              << "  \"speed\": ";
+    if (speed == 0)
+        std::cout << "\"max\",\n";
+    else
+        std::cout << speed << ",\n";
+    std::cout
+              << "  \"sessions\": " << replayer.count() << ",\n"
+              << "  \"completed\": " << t.completed << ",\n"
+              << "  \"failed\": " << t.failed << ",\n"
+              << "  \"recorded_s\": " << replayer.recorded_seconds() << ",\n"
+              << "  \"elapsed_s\": " << elapsed << ",\n"
+              << "  \"bytes_sent\": " << t.sent << ",\n"
+              << "  \"bytes_received\": " << t.received << ",\n"
+              << "  \"bytes_expected\": " << t.expected << ",\n"
+              << "  \"bytes_unexpected\": " << t.unexpected << ",\n"
+              << "  \"requests\": " << t.latency.count() << ",\n"
+              << "  \"latency_us\": ";
+    t.latency.write_json(std::cout, 1000.0);
+    std::cout << "\n}\n";
+
+    return t.failed ? -1 : 0;
+} catch (const std::exception& err) {
+    std::cerr << "Something went wrong and an exception was caught: " << err.what() << "\n";
+    return -1;
+} catch (...) {
+    std::cerr << "Something went wrong and an unknown exception was caught.\n";
+    return -1;
+}
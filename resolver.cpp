@@ -14,7 +14,10 @@
 #include "liberror.h"
 #include "resolvererror.h"
 
-Resolver::Resolver(const char* hostname, const char* servicename, bool passive) {
+Resolver::Resolver(const char* hostname, const char* servicename, bool passive) :
+    Resolver(hostname, servicename, passive, AF_INET, SOCK_STREAM) {}
+
+Resolver::Resolver(const char* hostname, const char* servicename, bool passive, int family, int socktype) {
     struct addrinfo hints;
     this->result = this->next_ = nullptr;
 
@@ -26,8 +29,8 @@ Resolver::Resolver(const char* hostname, const char* servicename, bool passive)
      * que le indicaran que tipo de direcciones queremos.
      * */
     memset(&hints, 0, sizeof(struct addrinfo));
-    hints.ai_family = AF_INET;       /* IPv4 (or AF_INET6 for IPv6)     */
-    hints.ai_socktype = SOCK_STREAM; /* TCP  (or SOCK_DGRAM for UDP)    */
+    hints.ai_family = family;        /* AF_INET IPv4 (or AF_INET6 for IPv6) */
+    hints.ai_socktype = socktype;    /* SOCK_STREAM TCP (or SOCK_DGRAM for UDP) */
     hints.ai_flags = passive ? AI_PASSIVE : 0;  /* AI_PASSIVE for server; 0 for client */
 
 
@@ -35,7 +38,7 @@ Resolver::Resolver(const char* hostname, const char* servicename, bool passive)
      * busco
      *
      * De todas las direcciones posibles, solo me interesan aquellas que sean
-     * IPv4 y TCP (segun lo definido en hints)
+     * de la familia y tipo pedidos (segun lo definido en hints)
      *
      * El resultado lo guarda en result que es un puntero al primer nodo
      * de una lista simplemente enlazada.
@@ -6,8 +6,8 @@ struct addrinfo;
 
 /*
  * Resolverdor de hostnames y service names.
- * Por simplificacion este TDA se enfocara solamente
- * en direcciones IPv4 para TCP.
+ * Por default resuelve direcciones IPv4 para TCP; BasicSocket (vease
+ * basicsocket.h) le pide la familia y el tipo de socket que necesita.
  * */
 class Resolver {
     struct addrinfo *result;
@@ -22,6 +22,13 @@ class Resolver {
      * */
     Resolver(const char* hostname, const char* servicename, bool passive);
 
+    /*
+     * Como el anterior pero solo para direcciones de la familia family
+     * (AF_INET, AF_INET6) y sockets del tipo socktype (SOCK_STREAM,
+     * SOCK_DGRAM, SOCK_SEQPACKET).
+     * */
+    Resolver(const char* hostname, const char* servicename, bool passive, int family, int socktype);
+
 
     /* Retorna si hay o no una direccion siguiente para testear.
      * Si la hay, se debera llamar a Resolver::next() para obtenerla.
@@ -0,0 +1,138 @@
+#include "responsecache.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "liberror.h"
+
+/*
+ * Content-Type segun la extension del archivo.
+ * */
+static const char* content_type_of(const char *filename) {
+    static const char *types[][2] = {
+        { ".html", "text/html" },
+        { ".css", "text/css" },
+        { ".js", "application/javascript" },
+        { ".json", "application/json" },
+        { ".txt", "text/plain" },
+        { ".png", "image/png" },
+        { ".jpg", "image/jpeg" },
+        { ".svg", "image/svg+xml" },
+        { ".ico", "image/x-icon" },
+    };
+
+    const char *ext = strrchr(filename, '.');
+    if (ext) {
+        for (auto& type : types)
+            if (strcmp(ext, type[0]) == 0)
+                return type[1];
+    }
+
+    return "application/octet-stream";
+}
+
+ResponseCache::Entry ResponseCache::render(const char *status, const char *content_type, const std::string& body, bool keep_alive) {
+    /*
+     * En HTTP/1.1 las conexiones son persistentes (keep-alive) por
+     * default y no hace falta el header Connection: si el cliente pide
+     * Connection: close simplemente cerramos despues de responder.
+     *
+     * Un cliente HTTP/1.0 en cambio asume que cerramos, salvo que le
+     * digamos lo contrario: si pidio keep-alive y no lo confirmamos se
+     * queda esperando el cierre.
+     * */
+    std::ostringstream headers;
+    headers << "HTTP/1.1 " << status << "\r\n"
+            << "Content-Type: " << content_type << "\r\n"
+            << "Content-Length: " << body.size() << "\r\n";
+    if (keep_alive)
+        headers << "Connection: keep-alive\r\n";
+    headers << "\r\n";
+
+    Entry entry;
+    entry.data = headers.str();
+    entry.header_len = entry.data.size();
+    entry.data += body;
+    return entry;
+}
+
+ResponseCache::Variants ResponseCache::render_both(const char *status, const char *content_type, const std::string& body) {
+    Variants variants;
+    variants.normal = render(status, content_type, body, false);
+    variants.keep_alive = render(status, content_type, body, true);
+    return variants;
+}
+
+/*
+ * FNV-1a: simple y suficiente para unos pocos paths cortos
+ * */
+size_t ResponseCache::PathHash::operator()(const Path& path) const {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < path.len; ++i) {
+        h ^= (unsigned char)path.data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+bool ResponseCache::PathEqual::operator()(const Path& a, const Path& b) const {
+    return a.len == b.len and memcmp(a.data, b.data, a.len) == 0;
+}
+
+void ResponseCache::add(const std::string& path, const Variants& variants) {
+    this->paths.push_back(path);
+    const std::string& key = this->paths.back();
+    this->entries[Path{key.data(), key.size()}] = variants;
+}
+
+ResponseCache::ResponseCache(const char *docroot) :
+    not_found(render_both("404 Not Found", "text/plain", "not found\n")),
+    bad_request(render("400 Bad Request", "text/plain", "bad request\n", false)) {
+
+    this->add("/health", render_both("200 OK", "text/plain", "ok\n"));
+
+    if (not docroot)
+        return;
+
+    DIR *dir = opendir(docroot);
+    if (not dir)
+        throw LibError(errno, "Cannot open docroot '%s': ", docroot);
+
+    struct dirent *dent;
+    while ((dent = readdir(dir)) != nullptr) {
+        std::string filename = std::string(docroot) + "/" + dent->d_name;
+
+        struct stat st;
+        if (stat(filename.c_str(), &st) == -1 or not S_ISREG(st.st_mode))
+            continue;
+
+        std::ifstream file(filename, std::ios::binary);
+        std::ostringstream body;
+        body << file.rdbuf();
+
+        Variants variants = render_both("200 OK", content_type_of(dent->d_name), body.str());
+        if (strcmp(dent->d_name, "index.html") == 0)
+            this->add("/", variants);
+
+        this->add(std::string("/") + dent->d_name, variants);
+    }
+
+    closedir(dir);
+}
+
+const ResponseCache::Entry& ResponseCache::get(const char *path, size_t len, bool keep_alive) const {
+    auto it = this->entries.find(Path{path, len});
+    const Variants& variants = it == this->entries.end() ? this->not_found : it->second;
+    return keep_alive ? variants.keep_alive : variants.normal;
+}
+
+const ResponseCache::Entry& ResponseCache::error() const {
+    return this->bad_request;
+}
@@ -0,0 +1,107 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <stddef.h>
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+/*
+ * Cache de respuestas HTTP pre-serializadas.
+ *
+ * Al arrancar se leen todos los archivos de un directorio y para cada
+ * uno se arma la respuesta HTTP *completa*: status line, headers y body
+ * en un unico buffer contiguo.
+ *
+ * Asi atender un GET que pega en el cache es buscar el path en un hash
+ * map y hacer un unico Socket::sendall() del buffer: sin formatear
+ * headers, sin leer el archivo, sin copias intermedias.
+ *
+ * Ademas siempre existe /health (responde "ok") para los health checks.
+ * */
+class ResponseCache {
+    public:
+    /*
+     * Una respuesta pre-serializada. Los primeros header_len bytes son
+     * la status line y los headers (lo que se envia para un HEAD).
+     * */
+    struct Entry {
+        std::string data;
+        size_t header_len;
+    };
+
+    private:
+    /*
+     * Cada recurso se pre-serializa dos veces: la respuesta normal y la
+     * misma con "Connection: keep-alive", que es lo que un cliente
+     * HTTP/1.0 necesita ver para no quedarse esperando el cierre.
+     * */
+    struct Variants {
+        Entry normal;
+        Entry keep_alive;
+    };
+
+    /*
+     * Las claves del map apuntan al path del request tal cual llega en
+     * el buffer: buscar no requiere armar un std::string (una
+     * allocation por request). La memoria de las claves guardadas es
+     * de paths, que no mueve sus strings al crecer.
+     * */
+    struct Path {
+        const char *data;
+        size_t len;
+    };
+
+    struct PathHash {
+        size_t operator()(const Path& path) const;
+    };
+
+    struct PathEqual {
+        bool operator()(const Path& a, const Path& b) const;
+    };
+
+    std::deque<std::string> paths;
+    std::unordered_map<Path, Variants, PathHash, PathEqual> entries;
+    Variants not_found;
+    Entry bad_request;
+
+    void add(const std::string& path, const Variants& variants);
+
+    static Entry render(const char *status, const char *content_type, const std::string& body, bool keep_alive);
+    static Variants render_both(const char *status, const char *content_type, const std::string& body);
+
+    public:
+    /*
+     * Carga los archivos regulares de docroot (no recursivo). El
+     * archivo index.html, si existe, tambien se sirve como "/".
+     *
+     * Con docroot nullptr solo se sirve /health.
+     * */
+    explicit ResponseCache(const char *docroot);
+
+    /*
+     * Retorna la respuesta para el path pedido o un 404 si no esta.
+     * La referencia es valida mientras viva el ResponseCache (que no
+     * cambia despues de construido, asi que los Workers lo pueden
+     * compartir sin locks).
+     *
+     * Con keep_alive se retorna la variante con "Connection:
+     * keep-alive" (para HTTP/1.0; en HTTP/1.1 es el default y no hace
+     * falta).
+     * */
+    const Entry& get(const char *path, size_t len, bool keep_alive) const;
+
+    /*
+     * Respuesta 400 para requests mal formados (o que no soportamos).
+     * */
+    const Entry& error() const;
+
+    /*
+     * No se copia: las claves apuntan a los strings de paths.
+     * */
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef RESUMABLE_H
+#define RESUMABLE_H
+
+#include <stdint.h>
+
+#include "wire.h"
+
+/*
+ * Protocolo de transferencias reanudables (vease ResumableSender y
+ * ResumableReceiver).
+ *
+ * Cada vez que se (re)conecta, el receptor dice cuantos bytes de la
+ * transferencia id ya tiene (un ResumeRequest con offset) y el emisor
+ * responde con el total (un ResumeReply) seguido de los bytes desde
+ * offset hasta el final. Al terminar, el receptor envia otro
+ * ResumeRequest con offset == total: es el ack de que tiene todo.
+ *
+ * El offset es lo unico que hace falta para reanudar y lo sabe el
+ * receptor con exactitud (vease BasicSocket::recvall()): el emisor no
+ * puede saber cuanto de lo que entrego al kernel llego de verdad.
+ * */
+struct ResumeRequest {
+    uint64_t id;
+    uint64_t offset;
+};
+
+struct ResumeReply {
+    uint64_t id;
+    uint64_t total;
+};
+
+typedef WireLayout<ResumeRequest,
+        WIRE_FIELD(ResumeRequest, id),
+        WIRE_FIELD(ResumeRequest, offset)> ResumeRequestWire;
+
+typedef WireLayout<ResumeReply,
+        WIRE_FIELD(ResumeReply, id),
+        WIRE_FIELD(ResumeReply, total)> ResumeReplyWire;
+
+#endif
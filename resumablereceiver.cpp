@@ -0,0 +1,66 @@
+#include "resumablereceiver.h"
+
+#include <stdexcept>
+
+#include "socket.h"
+#include "resumable.h"
+
+ResumableReceiver::ResumableReceiver(uint64_t id, void *data, uint64_t capacity, uint64_t checkpoint) :
+    id(id), data((char*)data), capacity(capacity), received_bytes(checkpoint), total_bytes(0), known(false) {
+    if (checkpoint > capacity)
+        throw std::runtime_error("Resume checkpoint past the end of the buffer");
+}
+
+static void send_request(Socket& skt, uint64_t id, uint64_t offset, bool *was_closed) {
+    char buf[ResumeRequestWire::SIZE];
+    ResumeRequest req = { id, offset };
+    ResumeRequestWire::encode(req, buf);
+    skt.sendall(buf, sizeof(buf), was_closed);
+}
+
+void ResumableReceiver::resume(Socket& skt, bool *was_closed) {
+    send_request(skt, this->id, this->received_bytes, was_closed);
+
+    char buf[ResumeReplyWire::SIZE];
+    skt.recvall(buf, sizeof(buf), was_closed);
+
+    ResumeReply reply;
+    ResumeReplyWire::decode(buf, reply);
+    if (reply.id != this->id)
+        throw std::runtime_error("Resume reply for an unknown transfer");
+    if (reply.total > this->capacity or reply.total < this->received_bytes)
+        throw std::runtime_error("Resume reply does not fit in the buffer");
+    if (this->known and reply.total != this->total_bytes)
+        throw std::runtime_error("Resumed transfer changed its size");
+    this->total_bytes = reply.total;
+    this->known = true;
+
+    // El checkpoint avanza aun si se corta a mitad de camino (vease
+    // BasicSocket::recvall())
+    size_t done = 0;
+    try {
+        skt.recvall(this->data + this->received_bytes, this->total_bytes - this->received_bytes, was_closed, &done);
+    } catch (...) {
+        this->received_bytes += done;
+        throw;
+    }
+    this->received_bytes += done;
+
+    send_request(skt, this->id, this->received_bytes, was_closed);
+}
+
+uint64_t ResumableReceiver::received() const {
+    return this->received_bytes;
+}
+
+bool ResumableReceiver::total_known() const {
+    return this->known;
+}
+
+uint64_t ResumableReceiver::total() const {
+    return this->total_bytes;
+}
+
+bool ResumableReceiver::complete() const {
+    return this->known and this->received_bytes == this->total_bytes;
+}
@@ -0,0 +1,62 @@
+#ifndef RESUMABLERECEIVER_H
+#define RESUMABLERECEIVER_H
+
+#include <stdint.h>
+
+class Socket;
+
+/*
+ * Receptor de una transferencia reanudable (vease resumable.h y
+ * ResumableSender).
+ *
+ * Los datos se escriben en data, que tiene capacity bytes. received()
+ * es el checkpoint: los bytes que ya se tienen, exactos aun si la
+ * conexion se corto a mitad de un recvall(). Si el caller lo persiste
+ * (junto con los datos) puede reanudar incluso despues de reiniciar el
+ * proceso, pasandolo como checkpoint al construir el receptor.
+ * */
+class ResumableReceiver {
+    uint64_t id;
+    char *data;
+    uint64_t capacity;
+    uint64_t received_bytes;
+    uint64_t total_bytes;
+    bool known;             // total_bytes vino del emisor (puede ser 0)
+
+    public:
+    ResumableReceiver(uint64_t id, void *data, uint64_t capacity, uint64_t checkpoint);
+
+    /*
+     * Reanuda la transferencia sobre una conexion nueva: le dice al
+     * emisor cuanto ya tiene, recibe el resto y confirma.
+     *
+     * Retorna cuando se recibio todo y se envio el ack final. Si la
+     * conexion se corta lanza una excepcion (como BasicSocket::recvall())
+     * con received() ya actualizado: basta con reconectarse y llamarlo
+     * de nuevo.
+     *
+     * El ack final puede perderse: si la conexion se corta justo despues
+     * de enviarlo, resume() retorna pero el emisor nunca lo lee y su
+     * serve() lanza una excepcion. Si hace falta que el emisor se entere
+     * se puede llamar a resume() otra vez con una conexion nueva: con
+     * todo recibido solo se reconfirma (el emisor no reenvia nada).
+     * */
+    void resume(Socket& skt, bool *was_closed);
+
+    uint64_t received() const;
+
+    /*
+     * Si ya se sabe el tamaño de la transferencia (se entera en la
+     * primer conexion) y cual es. Una transferencia puede ser de 0
+     * bytes: total() == 0 no quiere decir que no se sepa.
+     * */
+    bool total_known() const;
+    uint64_t total() const;
+
+    /*
+     * Si se sabe el total y ya se recibio todo.
+     * */
+    bool complete() const;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include "resumablesender.h"
+
+#include <stdexcept>
+
+#include "socket.h"
+#include "resumable.h"
+
+ResumableSender::ResumableSender(uint64_t id, const void *data, uint64_t total) :
+    id(id), data((const char*)data), total(total), acked(0), sent_bytes(0), finished(false) {}
+
+/*
+ * Lee un ResumeRequest y lo valida: tiene que ser de esta transferencia
+ * y no puede pedir mas alla del final.
+ * */
+static ResumeRequest recv_request(Socket& skt, uint64_t id, uint64_t total, bool *was_closed) {
+    char buf[ResumeRequestWire::SIZE];
+    skt.recvall(buf, sizeof(buf), was_closed);
+
+    ResumeRequest req;
+    ResumeRequestWire::decode(buf, req);
+    if (req.id != id)
+        throw std::runtime_error("Resume request for an unknown transfer");
+    if (req.offset > total)
+        throw std::runtime_error("Resume request past the end of the transfer");
+    return req;
+}
+
+void ResumableSender::serve(Socket& skt, bool *was_closed) {
+    // El receptor puede pedir menos de lo que ya habia confirmado (por
+    // ejemplo si reinicio sin su checkpoint): manda lo que dice.
+    ResumeRequest req = recv_request(skt, this->id, this->total, was_closed);
+    this->acked = req.offset;
+
+    char buf[ResumeReplyWire::SIZE];
+    ResumeReply reply = { this->id, this->total };
+    ResumeReplyWire::encode(reply, buf);
+    skt.sendall(buf, sizeof(buf), was_closed);
+
+    // Aunque se corte a mitad de camino sabemos cuanto le entregamos
+    // al kernel (vease BasicSocket::sendall())
+    size_t done = 0;
+    try {
+        skt.sendall(this->data + req.offset, this->total - req.offset, was_closed, &done);
+    } catch (...) {
+        this->sent_bytes += done;
+        throw;
+    }
+    this->sent_bytes += done;
+
+    // Un receptor correcto solo confirma con todo recibido (si le falta
+    // algo, su recvall() lanza y cierra en vez de confirmar)
+    req = recv_request(skt, this->id, this->total, was_closed);
+    this->acked = req.offset;
+    if (this->acked != this->total)
+        throw std::runtime_error("Resume acknowledge is short");
+    this->finished = true;
+}
+
+uint64_t ResumableSender::acknowledged() const {
+    return this->acked;
+}
+
+uint64_t ResumableSender::sent() const {
+    return this->sent_bytes;
+}
+
+bool ResumableSender::complete() const {
+    return this->finished;
+}
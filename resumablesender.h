@@ -0,0 +1,64 @@
+#ifndef RESUMABLESENDER_H
+#define RESUMABLESENDER_H
+
+#include <stdint.h>
+
+class Socket;
+
+/*
+ * Emisor de una transferencia grande (total puede superar los 4 GiB)
+ * que sobrevive a que se corte la conexion: en vez de empezar de nuevo,
+ * cada conexion continua desde el ultimo offset confirmado por el
+ * receptor (vease resumable.h y ResumableReceiver).
+ *
+ * data no se copia: tiene que seguir vivo hasta que la transferencia
+ * termine.
+ * */
+class ResumableSender {
+    uint64_t id;
+    const char *data;
+    uint64_t total;
+    uint64_t acked;
+    uint64_t sent_bytes;
+    bool finished;          // se recibio el ack final (con total == 0, acked == total no alcanza)
+
+    public:
+    ResumableSender(uint64_t id, const void *data, uint64_t total);
+
+    /*
+     * Atiende una conexion del receptor: lee desde donde reanudar, envia
+     * el resto y espera el ack final.
+     *
+     * Retorna cuando el receptor confirmo tener todo. Si la conexion se
+     * corta lanza una excepcion (como BasicSocket::sendall()) y se puede
+     * llamar de nuevo con la siguiente conexion del receptor.
+     *
+     * Si lo que se corta es el ack final, el receptor ya tiene todo pero
+     * aca no nos enteramos: serve() lanza una excepcion y complete()
+     * sigue en false. Cuando el receptor se reconecta pide desde
+     * offset == total y serve() lo toma como la confirmacion: responde,
+     * no envia datos y espera el ack de nuevo. Un receptor que no se
+     * reconecta deja al emisor esperando (vease
+     * ResumableReceiver::resume()).
+     * */
+    void serve(Socket& skt, bool *was_closed);
+
+    /*
+     * Bytes que el receptor confirmo tener (el checkpoint).
+     * */
+    uint64_t acknowledged() const;
+
+    /*
+     * Bytes entregados al kernel sumando todas las conexiones. Si es
+     * mayor a total, la diferencia es lo que se perdio en los cortes
+     * (estaba en los buffers del kernel) y hubo que reenviar.
+     * */
+    uint64_t sent() const;
+
+    /*
+     * Si el receptor confirmo haber recibido todo.
+     * */
+    bool complete() const;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include <string.h>
+#include <errno.h>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+#include "shmlistener.h"
+#include "shmsocket.h"
+#include "liberror.h"
+
+/*
+ * Cuanto esperamos a que un cliente recien aceptado nos envie el memfd.
+ * Sin limite, un cliente que se conecta y no envia nada nos dejaria
+ * trabados en el recvmsg() (y sin aceptar a nadie mas).
+ * */
+static const int HANDSHAKE_TIMEOUT_MS = 1000;
+
+ShmListener::ShmListener(const char *path) : skt(-1) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        throw std::runtime_error("ShmListener path too long");
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    strncpy(this->path, addr.sun_path, sizeof(this->path));
+
+    int skt = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (skt == -1)
+        throw LibError(errno, "ShmListener socket failed: ");
+
+    // Como en Handoff: un path "viejo" haria fallar al bind()
+    ::unlink(this->path);
+
+    if (bind(skt, (struct sockaddr*)&addr, sizeof(addr)) == -1 or listen(skt, 20) == -1) {
+        int errno_saved = errno;
+        ::close(skt);
+        throw LibError(errno_saved, "ShmListener on '%s' failed: ", path);
+    }
+
+    this->skt = skt;
+}
+
+ShmSocket ShmListener::accept() {
+    int peer = ::accept4(this->skt, nullptr, nullptr, SOCK_CLOEXEC);
+    if (peer == -1)
+        throw LibError(errno, "ShmListener accept failed: ");
+
+    struct timeval timeout;
+    timeout.tv_sec = HANDSHAKE_TIMEOUT_MS / 1000;
+    timeout.tv_usec = (HANDSHAKE_TIMEOUT_MS % 1000) * 1000;
+    if (setsockopt(peer, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == -1) {
+        int errno_saved = errno;
+        ::close(peer);
+        throw LibError(errno_saved, "ShmListener setsockopt(SO_RCVTIMEO) failed: ");
+    }
+
+    // El cliente nos envia el memfd (vease ShmSocket::connect())
+    char dummy;
+    struct iovec iov;
+    iov.iov_base = &dummy;
+    iov.iov_len = 1;
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctrl;
+    memset(&ctrl, 0, sizeof(ctrl));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    ssize_t s;
+    do {
+        s = recvmsg(peer, &msg, MSG_CMSG_CLOEXEC);
+    } while (s == -1 and errno == EINTR);
+
+    if (s == -1) {
+        int errno_saved = errno;
+        ::close(peer);
+        if (errno_saved == EAGAIN or errno_saved == EWOULDBLOCK)
+            throw std::runtime_error("ShmListener accept failed: the client did not send the memfd in time");
+        throw LibError(errno_saved, "ShmListener recvmsg failed: ");
+    }
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (s == 0 or cmsg == nullptr or cmsg->cmsg_level != SOL_SOCKET or cmsg->cmsg_type != SCM_RIGHTS) {
+        ::close(peer);
+        throw std::runtime_error("ShmListener accept failed: no memfd received");
+    }
+
+    int memfd;
+    memcpy(&memfd, CMSG_DATA(cmsg), sizeof(int));
+
+    try {
+        ShmSocket shm(peer, memfd, false);
+        ::close(memfd);
+        return shm;
+    } catch (...) {
+        ::close(memfd);
+        throw;
+    }
+}
+
+void ShmListener::shutdown() {
+    // En Linux un accept() bloqueado en un socket en escucha retorna
+    // EINVAL cuando se le hace shutdown()
+    if (::shutdown(this->skt, SHUT_RDWR) == -1)
+        throw LibError(errno, "ShmListener shutdown failed: ");
+}
+
+ShmListener::~ShmListener() {
+    if (this->skt != -1)
+        ::close(this->skt);
+    ::unlink(this->path);
+}
@@ -0,0 +1,47 @@
+#ifndef SHMLISTENER_H
+#define SHMLISTENER_H
+
+class ShmSocket;
+
+/*
+ * Lado server del establecimiento de ShmSocket (vease shmsocket.h):
+ * un socket UNIX en escucha en un path del filesystem.
+ * */
+class ShmListener {
+    int skt;
+    char path[108];
+
+    public:
+    /*
+     * Si el path ya existe (por ejemplo, quedo de una corrida anterior)
+     * se lo borra primero.
+     * */
+    explicit ShmListener(const char *path);
+
+    /*
+     * Bloquea hasta que un cliente se conecte con ShmSocket::connect()
+     * y retorna el ShmSocket ya mapeado.
+     *
+     * Un cliente conectado tiene 1 segundo para enviar el memfd; si no
+     * lo hace, o si la memoria no sirve (muy chica o sin el sello
+     * F_SEAL_SHRINK), se lanza una excepcion y el listener sigue
+     * utilizable para el proximo accept().
+     * */
+    ShmSocket accept();
+
+    /*
+     * Hace que un ShmListener::accept() bloqueado en otro thread (y los
+     * siguientes) falle: asi se detiene a un thread aceptador.
+     * */
+    void shutdown();
+
+    /*
+     * Cierra el socket UNIX y borra el path.
+     * */
+    ~ShmListener();
+
+    ShmListener(const ShmListener&) = delete;
+    ShmListener& operator=(const ShmListener&) = delete;
+};
+
+#endif
@@ -0,0 +1,482 @@
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <stdexcept>
+
+#include "shmsocket.h"
+#include "liberror.h"
+
+/*
+ * Un ring SPSC en la memoria compartida. Solo el escritor mueve head y
+ * solo el lector mueve tail; ambos crecen sin cota (uint64_t) y la
+ * posicion en data es head % RING_SIZE.
+ *
+ * Las variables de cada lado van en su propia linea de cache para que
+ * el escritor y el lector no se invaliden el cache mutuamente.
+ *
+ * Los std::atomic lock-free son "address-free": funcionan igual entre
+ * procesos que comparten la memoria que entre threads.
+ * */
+struct ShmRing {
+    // Escritor
+    alignas(64) std::atomic<uint64_t> head;
+    std::atomic<uint32_t> writer_waiting;   // el escritor duerme (ring lleno)
+    std::atomic<uint32_t> space_seq;        // futex del escritor
+    std::atomic<uint32_t> writer_closed;    // shutdown(SHUT_WR) del escritor
+
+    // Lector
+    alignas(64) std::atomic<uint64_t> tail;
+    std::atomic<uint32_t> reader_waiting;   // el lector duerme (ring vacio)
+    std::atomic<uint32_t> data_seq;         // futex del lector
+    std::atomic<uint32_t> reader_closed;    // shutdown(SHUT_RD) del lector
+
+    alignas(64) char data[ShmSocket::RING_SIZE];
+
+    ShmRing() : head(0), writer_waiting(0), space_seq(0), writer_closed(0),
+                tail(0), reader_waiting(0), data_seq(0), reader_closed(0) {}
+};
+
+/*
+ * Cantidad de bytes en el ring. El otro proceso puede escribir lo que
+ * quiera en la memoria compartida: si head - tail no tiene sentido no
+ * podemos confiar en nada del ring (y usarlo podria leer o escribir
+ * fuera de data).
+ * */
+static uint64_t used(uint64_t head, uint64_t tail) {
+    uint64_t n = head - tail;
+    if (n > ShmSocket::RING_SIZE)
+        throw std::runtime_error("ShmSocket protocol error: corrupted ring indexes");
+    return n;
+}
+
+/*
+ * Como espera (si espera) el lector o el escritor de un ring: dormido en
+ * el futex o, en modo no bloqueante, en un Poller sobre el socket de
+ * control (vease ShmSocket::set_nonblocking()).
+ * */
+static const uint32_t NOT_WAITING = 0;
+static const uint32_t WAITING_FUTEX = 1;
+static const uint32_t WAITING_POLL = 2;
+
+/*
+ * Cada cuanto un thread dormido en el futex se despierta a ver si el
+ * proceso del otro lado sigue vivo.
+ * */
+static const long LIVENESS_CHECK_NS = 100 * 1000 * 1000;
+
+static void futex_wait(std::atomic<uint32_t>& word, uint32_t expected) {
+    struct timespec timeout = { 0, LIVENESS_CHECK_NS };
+
+    // Sin FUTEX_PRIVATE_FLAG: el futex esta en memoria compartida
+    // entre procesos
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t>& word) {
+    word.fetch_add(1);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+/*
+ * Despierta al otro lado solo si esta (o esta por estar) esperando. El
+ * fence se corresponde con el del que se duerme (vease
+ * ShmSocket::recvsome()): o bien aca se ve waiting o bien el que se
+ * duerme ve los datos (o el lugar) nuevos antes de dormirse.
+ *
+ * Si duerme en el futex word, FUTEX_WAKE. Si espera en un Poller, un
+ * byte por el socket de control ctl lo hace legible; lo enviamos una
+ * sola vez por espera (el compare_exchange la da por atendida). Si
+ * falla es que el socket esta lleno (ya hay avisos pendientes) o que el
+ * otro proceso se fue: en ambos casos no hay nada mas que hacer.
+ * */
+static void wake(std::atomic<uint32_t>& waiting, std::atomic<uint32_t>& word, int ctl) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t w = waiting.load(std::memory_order_relaxed);
+    if (w == WAITING_FUTEX) {
+        futex_wake(word);
+    } else if (w == WAITING_POLL and waiting.compare_exchange_strong(w, NOT_WAITING)) {
+        char token = 'W';
+        send(ctl, &token, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+}
+
+ShmSocket::ShmSocket() : ctl(-1), mem(nullptr), in(nullptr), out(nullptr), nonblocking(false) {}
+
+ShmSocket::ShmSocket(int ctl, int memfd, bool creator) :
+    ctl(-1), mem(nullptr), in(nullptr), out(nullptr), nonblocking(false) {
+    /*
+     * El server no confia ciegamente en el cliente: si la memoria fuese
+     * mas chica que los rings, acceder fuera de ella seria un SIGBUS.
+     * Y no alcanza con mirar el tamaño ahora: el cliente podria achicarla
+     * despues (ftruncate()). Por eso exigimos que este sellada contra
+     * eso (F_SEAL_SHRINK, vease man memfd_create).
+     * */
+    struct stat st;
+    if (not creator and (fstat(memfd, &st) == -1 or (size_t)st.st_size < 2 * sizeof(ShmRing))) {
+        ::close(ctl);
+        throw std::runtime_error("ShmSocket: the shared memory is too small");
+    }
+
+    int seals = creator ? 0 : fcntl(memfd, F_GET_SEALS);
+    if (not creator and (seals == -1 or not (seals & F_SEAL_SHRINK))) {
+        ::close(ctl);
+        throw std::runtime_error("ShmSocket: the shared memory is not sealed against shrinking");
+    }
+
+    void *p = mmap(nullptr, 2 * sizeof(ShmRing), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (p == MAP_FAILED) {
+        int errno_saved = errno;
+        ::close(ctl);
+        throw LibError(errno_saved, "ShmSocket mmap failed: ");
+    }
+
+    ShmRing *rings = (ShmRing*)p;
+    if (creator) {
+        new (&rings[0]) ShmRing();
+        new (&rings[1]) ShmRing();
+    }
+
+    // El cliente escribe en el ring 0 y lee del 1; el server al reves
+    this->mem = (char*)p;
+    this->out = &rings[creator ? 0 : 1];
+    this->in = &rings[creator ? 1 : 0];
+    this->ctl = ctl;
+}
+
+ShmSocket ShmSocket::connect(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        throw std::runtime_error("ShmSocket path too long");
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    int skt = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (skt == -1)
+        throw LibError(errno, "ShmSocket socket failed: ");
+
+    if (::connect(skt, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        int errno_saved = errno;
+        ::close(skt);
+        throw LibError(errno_saved, "ShmSocket connect to '%s' failed: ", path);
+    }
+
+    /*
+     * Ya con su tamaño final lo sellamos: nadie (ni nosotros) puede
+     * cambiarselo. El server lo verifica (vease el constructor).
+     * */
+    int memfd = memfd_create("shmsocket", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd == -1 or ftruncate(memfd, 2 * sizeof(ShmRing)) == -1 or
+            fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1) {
+        int errno_saved = errno;
+        if (memfd != -1)
+            ::close(memfd);
+        ::close(skt);
+        throw LibError(errno_saved, "ShmSocket memfd failed: ");
+    }
+
+    try {
+        ShmSocket shm(skt, memfd, true);
+
+        // El memfd viaja al server como el listener en Handoff::wait()
+        char dummy = 'S';
+        struct iovec iov;
+        iov.iov_base = &dummy;
+        iov.iov_len = 1;
+
+        union {
+            char buf[CMSG_SPACE(sizeof(int))];
+            struct cmsghdr align;
+        } ctrl;
+        memset(&ctrl, 0, sizeof(ctrl));
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctrl.buf;
+        msg.msg_controllen = sizeof(ctrl.buf);
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &memfd, sizeof(int));
+
+        if (sendmsg(skt, &msg, MSG_NOSIGNAL) == -1)
+            throw LibError(errno, "ShmSocket sendmsg failed: ");
+
+        // El mapeo sigue valido sin el fd
+        ::close(memfd);
+        return shm;
+    } catch (...) {
+        // skt ya lo cerro el ShmSocket (o su constructor si fallo)
+        ::close(memfd);
+        throw;
+    }
+}
+
+bool ShmSocket::peer_is_gone() const {
+    struct pollfd pfd;
+    pfd.fd = this->ctl;
+    pfd.events = POLLRDHUP;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) == 1 and (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR));
+}
+
+bool ShmSocket::drain() {
+    char buf[64];
+    while (true) {
+        ssize_t n = recv(this->ctl, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n > 0)
+            continue;
+        if (n == 0)
+            return false;   // el otro proceso cerro (o murio)
+        if (errno == EINTR)
+            continue;
+        return errno == EAGAIN or errno == EWOULDBLOCK;
+    }
+}
+
+void ShmSocket::set_nonblocking(bool nonblocking) {
+    this->nonblocking = nonblocking;
+}
+
+bool ShmSocket::prepare_wait() {
+    ShmRing *r = this->in;
+    uint64_t tail = r->tail.load(std::memory_order_relaxed);
+
+    // Como en recvsome(): o el escritor ve WAITING_POLL o nosotros vemos
+    // sus datos
+    r->reader_waiting.store(WAITING_POLL);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (used(r->head.load(), tail) == 0 and not r->writer_closed.load() and not r->reader_closed.load())
+        return true;
+
+    r->reader_waiting.store(NOT_WAITING);
+    return false;
+}
+
+int ShmSocket::sendsome(const void *data, unsigned int sz, bool *was_closed) {
+    *was_closed = false;
+    ShmRing *r = this->out;
+    uint64_t head = r->head.load(std::memory_order_relaxed);
+
+    /*
+     * Esperamos lugar. Para dormirnos: leemos el futex, avisamos que
+     * vamos a dormir y volvemos a chequear (el lector pudo haber
+     * liberado lugar justo antes de ver el aviso).
+     * */
+    uint64_t tail;
+    while (true) {
+        if (r->reader_closed.load()) {
+            *was_closed = true;
+            return 0;
+        }
+
+        tail = r->tail.load(std::memory_order_acquire);
+        if (used(head, tail) < RING_SIZE)
+            break;
+
+        if (this->nonblocking) {
+            // Lo mismo que con el futex pero sin dormir: nos despertara
+            // un byte por ctl (vease wake())
+            if (not this->drain()) {
+                *was_closed = true;
+                return 0;
+            }
+
+            r->writer_waiting.store(WAITING_POLL);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (used(head, r->tail.load()) == RING_SIZE and not r->reader_closed.load())
+                return -1;
+            r->writer_waiting.store(NOT_WAITING);
+            continue;
+        }
+
+        uint32_t seq = r->space_seq.load();
+        r->writer_waiting.store(WAITING_FUTEX);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (used(head, r->tail.load()) == RING_SIZE and not r->reader_closed.load())
+            futex_wait(r->space_seq, seq);
+        r->writer_waiting.store(NOT_WAITING);
+
+        if (r->tail.load() + RING_SIZE == head and this->peer_is_gone()) {
+            *was_closed = true;
+            return 0;
+        }
+    }
+
+    // Copiamos lo que entre, en dos partes si da la vuelta al ring
+    size_t n = std::min<size_t>(sz, RING_SIZE - (head - tail));
+    size_t pos = head % RING_SIZE;
+    size_t first = std::min(n, RING_SIZE - pos);
+    memcpy(r->data + pos, data, first);
+    memcpy(r->data, (const char*)data + first, n - first);
+
+    r->head.store(head + n, std::memory_order_release);
+    wake(r->reader_waiting, r->data_seq, this->ctl);
+    return n;
+}
+
+int ShmSocket::recvsome(void *data, unsigned int sz, bool *was_closed) {
+    *was_closed = false;
+    ShmRing *r = this->in;
+    uint64_t tail = r->tail.load(std::memory_order_relaxed);
+
+    uint64_t head;
+    while (true) {
+        // Leemos writer_closed *antes* que head: si el escritor cerro,
+        // todo lo que envio antes de cerrar ya se ve en head
+        bool closed = r->writer_closed.load();
+        head = r->head.load(std::memory_order_acquire);
+        if (used(head, tail) != 0)
+            break;
+
+        if (closed or r->reader_closed.load()) {
+            *was_closed = true;
+            return 0;
+        }
+
+        if (this->nonblocking) {
+            // Vease sendsome()
+            if (not this->drain()) {
+                *was_closed = true;
+                return 0;
+            }
+
+            r->reader_waiting.store(WAITING_POLL);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (r->head.load() == tail and not r->writer_closed.load())
+                return -1;
+            r->reader_waiting.store(NOT_WAITING);
+            continue;
+        }
+
+        uint32_t seq = r->data_seq.load();
+        r->reader_waiting.store(WAITING_FUTEX);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (r->head.load() == tail and not r->writer_closed.load())
+            futex_wait(r->data_seq, seq);
+        r->reader_waiting.store(NOT_WAITING);
+
+        if (r->head.load() == tail and this->peer_is_gone()) {
+            *was_closed = true;
+            return 0;
+        }
+    }
+
+    size_t n = std::min<size_t>(sz, head - tail);
+    size_t pos = tail % RING_SIZE;
+    size_t first = std::min(n, RING_SIZE - pos);
+    memcpy(data, r->data + pos, first);
+    memcpy((char*)data + first, r->data, n - first);
+
+    r->tail.store(tail + n, std::memory_order_release);
+    wake(r->writer_waiting, r->space_seq, this->ctl);
+    return n;
+}
+
+int ShmSocket::sendall(const void *data, unsigned int sz, bool *was_closed) {
+    unsigned int sent = 0;
+    while (sent < sz) {
+        int s = this->sendsome((const char*)data + sent, sz - sent, was_closed);
+        if (*was_closed)
+            return 0;
+        if (s < 0)
+            throw LibError(EAGAIN, "ShmSocket sendall would block (len %u/%u): ", sent, sz);
+        sent += s;
+    }
+    return sz;
+}
+
+int ShmSocket::recvall(void *data, unsigned int sz, bool *was_closed) {
+    unsigned int received = 0;
+    while (received < sz) {
+        int s = this->recvsome((char*)data + received, sz - received, was_closed);
+        if (s == 0) {
+            // Como en Socket::recvall(): no recibimos todo lo pedido
+            throw std::runtime_error("Unexpected closed");
+        }
+        if (s < 0)
+            throw LibError(EAGAIN, "ShmSocket recvall would block (len %u/%u): ", received, sz);
+        received += s;
+    }
+    return sz;
+}
+
+void ShmSocket::shutdown(int how) {
+    if (not this->mem)
+        throw std::runtime_error("ShmSocket shutdown on a closed socket");
+
+    if (how == SHUT_WR or how == SHUT_RDWR) {
+        this->out->writer_closed.store(1);
+        wake(this->out->reader_waiting, this->out->data_seq, this->ctl);
+    }
+    if (how == SHUT_RD or how == SHUT_RDWR) {
+        this->in->reader_closed.store(1);
+        wake(this->in->writer_waiting, this->in->space_seq, this->ctl);
+    }
+}
+
+int ShmSocket::close() {
+    int s = 0;
+    if (this->mem) {
+        munmap(this->mem, 2 * sizeof(ShmRing));
+        this->mem = nullptr;
+        this->in = this->out = nullptr;
+    }
+    if (this->ctl != -1) {
+        s = ::close(this->ctl);
+        this->ctl = -1;
+    }
+    return s;
+}
+
+ShmSocket::~ShmSocket() {
+    if (this->mem)
+        this->shutdown(SHUT_RDWR);
+    this->close();
+}
+
+ShmSocket::ShmSocket(ShmSocket&& other) :
+    ctl(other.ctl), mem(other.mem), in(other.in), out(other.out), nonblocking(other.nonblocking) {
+    other.ctl = -1;
+    other.mem = nullptr;
+    other.in = other.out = nullptr;
+}
+
+ShmSocket& ShmSocket::operator=(ShmSocket&& other) {
+    if (this == &other)
+        return *this;
+
+    if (this->mem)
+        this->shutdown(SHUT_RDWR);
+    this->close();
+
+    this->ctl = other.ctl;
+    this->mem = other.mem;
+    this->in = other.in;
+    this->out = other.out;
+    this->nonblocking = other.nonblocking;
+
+    other.ctl = -1;
+    other.mem = nullptr;
+    other.in = other.out = nullptr;
+    return *this;
+}
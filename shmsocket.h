@@ -0,0 +1,150 @@
+#ifndef SHMSOCKET_H
+#define SHMSOCKET_H
+
+#include <stddef.h>
+
+struct ShmRing;
+
+/*
+ * Transporte por memoria compartida para procesos en el mismo host.
+ *
+ * Aun por loopback cada byte enviado con Socket::sendall() cruza el
+ * kernel dos veces: se copia al kernel en el send() y del kernel en el
+ * recv(), con un syscall (y tipicamente un despertar) en cada extremo.
+ *
+ * Un ShmSocket en cambio intercambia los datos a traves de dos buffers
+ * circulares (rings) SPSC, uno por direccion, en una memoria compartida
+ * entre ambos procesos (un memfd mapeado por los dos). Enviar es copiar
+ * al ring y recibir es copiar del ring: no hay syscalls mientras haya
+ * datos (o lugar).
+ *
+ * El kernel solo interviene para despertar: cuando el ring de entrada
+ * esta vacio el lector se duerme en un futex y el escritor lo despierta
+ * (FUTEX_WAKE), pero solo si de verdad hay alguien durmiendo. Lo mismo
+ * cuando el ring de salida esta lleno.
+ *
+ * El establecimiento usa un socket UNIX (vease ShmListener): el cliente
+ * crea el memfd y se lo pasa al server con SCM_RIGHTS (como hace
+ * Handoff con el listener). Ese socket UNIX queda abierto mientras viva
+ * la conexion: si el otro proceso muere sin cerrar, el kernel lo cierra
+ * y asi nos enteramos (un lector dormido lo revisa cada 100 ms).
+ *
+ * La API es la de Socket (sendsome(), recvsome(), sendall(), recvall(),
+ * shutdown(), close() y was_closed con la misma semantica) asi que el
+ * codigo escrito contra esa API (por ejemplo un template sobre el tipo
+ * de socket, como el echo de bench_shm.cpp) funciona igual con ambos.
+ *
+ * El otro proceso puede escribir cualquier cosa en la memoria
+ * compartida: si los indices de un ring no tienen sentido (hay mas de
+ * RING_SIZE bytes en el) sendsome()/recvsome() lanzan
+ * std::runtime_error en vez de acceder fuera del ring.
+ *
+ * Como Socket, un ShmSocket no es thread-safe para dos threads que
+ * envian (o dos que reciben) a la vez, pero uno puede enviar mientras
+ * otro recibe.
+ * */
+class ShmSocket {
+    int ctl;            // el socket UNIX del establecimiento
+    char *mem;
+    ShmRing *in;
+    ShmRing *out;
+    bool nonblocking;
+
+    /*
+     * Mapea el memfd y toma el ownership de ctl (aun si falla). El
+     * cliente (creator) inicializa los rings; el server recibe el memfd
+     * ya inicializado y usa los rings en el orden inverso.
+     * */
+    ShmSocket(int ctl, int memfd, bool creator);
+    friend class ShmListener;
+
+    /*
+     * Poller registra ctl (vease ShmSocket::set_nonblocking())
+     * */
+    friend class Poller;
+
+    bool peer_is_gone() const;
+
+    /*
+     * Consume los avisos pendientes en ctl. Retorna false si el otro
+     * proceso cerro su lado (o murio).
+     * */
+    bool drain();
+
+    public:
+    /*
+     * Capacidad de cada ring (potencia de 2).
+     * */
+    static const size_t RING_SIZE = 1024 * 1024;
+
+    /*
+     * Se conecta a un ShmListener escuchando en el path dado (un path
+     * del filesystem, como en Handoff).
+     * */
+    static ShmSocket connect(const char *path);
+
+    /*
+     * Un ShmSocket "vacio" (como si ya se hubiera cerrado), para ser
+     * asignado despues por move.
+     * */
+    ShmSocket();
+
+    /*
+     * Modo no bloqueante, para atender muchos ShmSockets desde un
+     * Poller (como el Worker, vease worker.h).
+     *
+     * En ese modo sendsome()/recvsome() no se duermen en el futex:
+     * retornan menor a 0 si el ring esta lleno/vacio (como un
+     * BasicSocket no bloqueante con EAGAIN) y dejan anotado en el ring
+     * que esperan. El otro lado, al enviar o recibir, lo despierta
+     * enviando un byte por el socket UNIX de control en vez de con
+     * FUTEX_WAKE. Ese socket es el que se registra en el Poller: se
+     * vuelve legible tanto por esos avisos como si el otro proceso
+     * cierra o muere, asi que readable y writable son el mismo evento.
+     *
+     * Los avisos son de a uno por espera y solo si este lado anoto que
+     * espera: antes de esperar en el Poller hay que leer hasta que
+     * recvsome() retorne menor a 0 o llamar a prepare_wait(). Con el
+     * ring con datos el camino sigue sin syscalls. En este modo no hay
+     * que usar el ShmSocket desde dos threads.
+     * */
+    void set_nonblocking(bool nonblocking);
+
+    /*
+     * En modo no bloqueante, antes de esperar datos en un Poller: anota
+     * en el ring que este lado espera (como hace recvsome() cuando no
+     * hay nada) y retorna true. Si en realidad ya hay datos (o el otro
+     * lado cerro) retorna false: no hay que esperar sino llamar a
+     * recvsome(), porque lo que ya estaba en el ring no genera un aviso.
+     *
+     * No hace syscalls.
+     * */
+    bool prepare_wait();
+
+    /*
+     * Lease socket.h: misma semantica.
+     * */
+    int sendsome(const void *data, unsigned int sz, bool *was_closed);
+    int recvsome(void *data, unsigned int sz, bool *was_closed);
+
+    int sendall(const void *data, unsigned int sz, bool *was_closed);
+    int recvall(void *data, unsigned int sz, bool *was_closed);
+
+    /*
+     * SHUT_WR: el peer, tras leer todo, vera was_closed.
+     * SHUT_RD: los sendsome() del peer veran was_closed.
+     * */
+    void shutdown(int how);
+
+    int close();
+
+    ~ShmSocket();
+
+    ShmSocket(const ShmSocket&) = delete;
+    ShmSocket& operator=(const ShmSocket&) = delete;
+
+    ShmSocket(ShmSocket&&);
+    ShmSocket& operator=(ShmSocket&&);
+};
+
+#endif
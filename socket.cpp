@@ -4,362 +4,394 @@
 #include <errno.h>
 
 #include <sys/socket.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <linux/tcp.h>
 
-#include <stdexcept>
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 #include "socket.h"
-#include "resolver.h"
 #include "liberror.h"
+#include "trace.h"
+#include "recorder.h"
 
-Socket::Socket(const char *hostname, const char *servicename) : skt(-1), closed(true) {
-    Resolver resolver(hostname, servicename, false);
+Socket::Socket(const char *hostname, const char *servicename) :
+    BasicSocket(hostname, servicename) {}
 
-    int s;
-    int skt = -1;
-    while (resolver.has_next()) {
-        struct addrinfo *addr = resolver.next();
+Socket::Socket(const char *servicename) : BasicSocket(servicename) {}
 
-        /* Cerramos el socket si nos quedo abierto de la iteracion
-         * anterior
-         * */
-        if (skt != -1)
-            ::close(skt);
+/*
+ * Constructor que inicializa el socket pasandole directamente el file descriptor.
+ *
+ * No queremos que el codigo del usuario este manipulando el file descriptor,
+ * queremos q interactue con él *solo* a traves de Socket.
+ *
+ * Por ello ponemos este constructor privado (vease socket.h).
+ * */
+Socket::Socket(int skt) : BasicSocket(skt) {}
 
-        /* Creamos el socket definiendo la familia (deberia ser AF_INET IPv4),
-           el tipo de socket (deberia ser SOCK_STREAM TCP) y el protocolo (0) */
-        skt = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
-        if (skt == -1) {
-            continue;
-        }
+Socket::Socket() {}
 
-        /* Intentamos conectarnos al servidor cuya direccion
-         * fue dada por getaddrinfo()
-         * */
-        s = connect(skt, addr->ai_addr, addr->ai_addrlen);
-        if (s == -1) {
-            continue;
-        }
+int Socket::incoming_cpu() const {
+    int cpu = -1;
+    socklen_t len = sizeof(cpu);
+    if (getsockopt(this->skt, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) == -1)
+        return -1;
+    return cpu;
+}
 
-        // Conexion exitosa!
-        this->skt = skt;
-        this->closed = false;
-        return;
-    }
+int Socket::pending() const {
+    int n = 0;
+    if (ioctl(this->skt, FIONREAD, &n) == -1)
+        return -1;
+    return n;
+}
 
-    // El errno es una (psuedo) variable global con el ultimo error generado.
-    // Es importante no llamar nada antes ya que cualquier llamada
-    // a la libc puede cambiar el errno y hacernos perder el mensaje
-    // El manejo de errores en C es muy sensible!
-    int errno_saved = errno;
-
-    // No hay q olvidarse de cerrar el socket en caso de
-    // que lo hayamos abierto
-    if (skt != -1)
-        ::close(skt);
-
-    // Lanzamos una excepcion con el errno que guardamos (preservamos)
-    // excepcion
-    // Dado que probamos multiples direcciones y llamamos a socket() y
-    // a connect() multiples veces podriamos estar ante el caso de varios
-    // errores *distintos*.
-    // Sin embargo vamos a notificar del ultimo error y nada mas.
-    //
-    // Notese que lanzar una excepcion en el constructor es la unica manera
-    // de poder comunicar que un objeto no se construyo
-    throw LibError(errno_saved, "Socket for connection to '%s:%s' failed: ", hostname, servicename);
+void Socket::set_recv_lowat(int bytes) {
+    if (setsockopt(this->skt, SOL_SOCKET, SO_RCVLOWAT, &bytes, sizeof(bytes)) == -1)
+        throw LibError(errno, "Socket set SO_RCVLOWAT failed: ");
 }
 
-Socket::Socket(const char *servicename) : skt(-1), closed(true) {
-    Resolver resolver(nullptr, servicename, true);
+void Socket::set_timestamping(bool enable) {
+    /*
+     * OPT_ID numera los timestamps de envio (vease Socket::TxTimestamp)
+     * y OPT_TSONLY hace que en la cola de errores venga solo el
+     * timestamp y no una copia del paquete enviado.
+     * */
+    int flags = 0;
+    if (enable)
+        flags = SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE |
+                SOF_TIMESTAMPING_TX_SCHED | SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_TX_ACK |
+                SOF_TIMESTAMPING_RAW_HARDWARE | SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_TX_HARDWARE |
+                SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+
+    if (setsockopt(this->skt, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == -1)
+        throw LibError(errno, "Socket set SO_TIMESTAMPING failed: ");
+}
 
-    int s;
-    int skt = -1;
-    while (resolver.has_next()) {
-        struct addrinfo *addr = resolver.next();
+static uint64_t to_ns(const struct timespec& ts) {
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
 
-        /* Cerramos el socket si nos quedo abierto de la iteracion
-         * anterior
-         * */
-        if (skt != -1)
-            ::close(skt);
-
-        /* Creamos el socket definiendo la misma familia, tipo y protocolo
-         * que tiene la direccion que estamos por probar.
-         * Por ejemplo deberia ser la familia AF_INET IPv4,
-         * el tipo de socket SOCK_STREAM TCP  y el protocolo 0.
-         *
-         * Ya que usamos getaddrinfo() no conviene hardcodear esos valores
-         * sino usar los mismos que ya estan cargados en la direccion
-         * que estamos probando.
-         * */
-        skt = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
-        if (skt == -1) {
-            continue;
+/*
+ * Busca el mensaje de control SCM_TIMESTAMPING: ts[0] es el de software
+ * y ts[2] el de hardware (ts[1] ya no se usa).
+ * */
+static void parse_timestamping(struct msghdr *msg, Socket::Timestamp *out) {
+    out->software_ns = out->hardware_ns = 0;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(msg); c; c = CMSG_NXTHDR(msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET and c->cmsg_type == SCM_TIMESTAMPING) {
+            struct scm_timestamping tss;
+            memcpy(&tss, CMSG_DATA(c), sizeof(tss));
+            out->software_ns = to_ns(tss.ts[0]);
+            out->hardware_ns = to_ns(tss.ts[2]);
+        }
+    }
+}
+
+int Socket::recvsome(void *data, unsigned int sz, bool *was_closed, Timestamp *rx) {
+    *was_closed = false;
+    rx->software_ns = rx->hardware_ns = 0;
+
+    struct iovec iov = { data, sz };
+    char control[256];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    uint64_t t0 = Trace::now();
+    int s = recvmsg(this->skt, &msg, 0);
+    Trace::record(Trace::RECV, this->skt, sz, s < 0 ? -errno : s, t0);
+    if (s == 0) {
+        // Vease el comentario en el otro recvsome()
+        *was_closed = true;
+        return 0;
+    } else if (s < 0) {
+        // Socket no bloqueante sin nada para leer
+        if (errno == EAGAIN or errno == EWOULDBLOCK)
+            return -1;
+
+        throw LibError(errno, "Socket recvsome failed (len %d): ", sz);
+    }
+
+    parse_timestamping(&msg, rx);
+    Recorder::record(Recorder::RECV, this->skt, data, s);
+    return s;
+}
+
+bool Socket::tx_timestamp(TxTimestamp *tx) {
+    char control[256];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    while (true) {
+        int s = recvmsg(this->skt, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+        if (s < 0) {
+            if (errno == EAGAIN or errno == EWOULDBLOCK)
+                return false;
+            throw LibError(errno, "Socket tx_timestamp failed: ");
         }
 
         /*
-         * Como el sistema operativo puede mantener ocupado (en TIME_WAIT)
-         * un puerto que fue usado recientemente, no queremos que nuesta
-         * aplicacion falle a la hora de hacer un bind() por algo que sabemos
-         * que es temporal.
-         *
-         * Un puerto en TIME_WAIT esta "ocupado" solo temporalmente por
-         * el sistema operativo.
-         *
-         * Entonces queremos decirle que "queremos reutilizar la direccion"
-         * aun si esta en TIME_WAIT (de otro modo obtendriamos un error al
-         * llamar a bind() con un "Address already in use")
+         * Junto al timestamp viene un sock_extended_err (nivel IP o
+         * IPv6) que dice que tipo de timestamp es y, en ee_data, su id
+         * (OPT_ID): para TCP el numero del ultimo byte de ese send().
          * */
-        int val = 1;
-        s = setsockopt(skt, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val));
-        if (s == -1) {
-            continue;
+        struct sock_extended_err err;
+        bool found = false;
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            if ((c->cmsg_level == SOL_IP and c->cmsg_type == IP_RECVERR) or
+                    (c->cmsg_level == SOL_IPV6 and c->cmsg_type == IPV6_RECVERR)) {
+                memcpy(&err, CMSG_DATA(c), sizeof(err));
+                found = err.ee_errno == ENOMSG and err.ee_origin == SO_EE_ORIGIN_TIMESTAMPING;
+            }
         }
 
-        // Hacemos le bind: enlazamos el socket a una direccion local
-        // para escuchar
-        s = bind(skt, addr->ai_addr, addr->ai_addrlen);
-        if (s == -1) {
+        if (not found) {
+            // No es un timestamp (no deberia pasar): lo salteamos
+            msg.msg_controllen = sizeof(control);
             continue;
         }
 
-        // Ponemos el socket a escuchar. Ese 20 (podria ser otro valor)
-        // indica cuantas conexiones a la espera de ser aceptadas se toleraran
-        // No tiene nada q ver con cuantas conexiones totales el server tendra
-        s = listen(skt, 20);
-        if (s == -1) {
-            continue;
-        }
+        if (err.ee_info == SCM_TSTAMP_SCHED)
+            tx->kind = TxTimestamp::SCHED;
+        else if (err.ee_info == SCM_TSTAMP_ACK)
+            tx->kind = TxTimestamp::ACKED;
+        else
+            tx->kind = TxTimestamp::SENT;
 
-        // setupeamos el socket! Ahora esta escuchando
-        // en una de las direcciones obtenidas por getaddrinfo()
-        // y esta listo para aceptar conexiones.
-        this->skt = skt;
-        this->closed = false;
-        return;
+        tx->bytes = err.ee_data + 1;
+        parse_timestamping(&msg, &tx->ts);
+        return true;
     }
+}
 
-    int errno_saved = errno;
+Socket::TcpInfo Socket::tcp_info() const {
+    /*
+     * El kernel copia a lo sumo len bytes y nos dice cuantos copio:
+     * un kernel mas viejo que nuestros headers no llena los ultimos
+     * campos, que quedan en 0 por el memset.
+     * */
+    struct tcp_info ti;
+    memset(&ti, 0, sizeof(ti));
+    socklen_t len = sizeof(ti);
+    if (getsockopt(this->skt, IPPROTO_TCP, TCP_INFO, &ti, &len) == -1)
+        throw LibError(errno, "Socket getsockopt TCP_INFO failed: ");
+
+    TcpInfo info;
+    info.state = ti.tcpi_state;
+    info.rtt_us = ti.tcpi_rtt;
+    info.rttvar_us = ti.tcpi_rttvar;
+    info.min_rtt_us = ti.tcpi_min_rtt;
+    info.retransmits = ti.tcpi_total_retrans;
+    info.lost = ti.tcpi_lost;
+    info.snd_cwnd = ti.tcpi_snd_cwnd;
+    info.snd_ssthresh = ti.tcpi_snd_ssthresh;
+    info.snd_mss = ti.tcpi_snd_mss;
+    info.delivery_rate = ti.tcpi_delivery_rate;
+    info.pacing_rate = ti.tcpi_pacing_rate;
+    info.notsent_bytes = ti.tcpi_notsent_bytes;
+    info.bytes_acked = ti.tcpi_bytes_acked;
+    info.bytes_received = ti.tcpi_bytes_received;
+    info.busy_us = ti.tcpi_busy_time;
+    info.rwnd_limited_us = ti.tcpi_rwnd_limited;
+    info.sndbuf_limited_us = ti.tcpi_sndbuf_limited;
+
+    // Con bytes_sent (kernels >= 4.19) sabemos los bytes exactos en
+    // vuelo; si no, lo estimamos con los segmentos sin ACK
+    if (ti.tcpi_bytes_sent)
+        info.unacked_bytes = ti.tcpi_bytes_sent - ti.tcpi_bytes_retrans - ti.tcpi_bytes_acked;
+    else
+        info.unacked_bytes = (uint64_t)ti.tcpi_unacked * ti.tcpi_snd_mss;
+
+    return info;
+}
 
-    // No hay q olvidarse de cerrar el socket en caso de
-    // que lo hayamos abierto
-    if (skt != -1)
-        ::close(skt);
 
-    throw LibError(errno_saved, "Socket for service '%s' failed: ", servicename);
+/*
+ * Escribe exactamente sz bytes en fd (el equivalente a Socket::sendall()
+ * para un file descriptor cualquiera).
+ * */
+static void write_all(int fd, const char *data, size_t sz) {
+    while (sz > 0) {
+        ssize_t s = ::write(fd, data, sz);
+        if (s == -1) {
+            if (errno == EINTR)
+                continue;
+            throw LibError(errno, "Socket recv_to_fd write failed (len %zu): ", sz);
+        }
+        data += s;
+        sz -= s;
+    }
 }
 
 /*
- * Constructor que inicializa el socket pasandole directamente el file descriptor.
- *
- * No queremos que el codigo del usuario este manipulando el file descriptor,
- * queremos q interactue con él *solo* a traves de Socket.
- *
- * Por ello ponemos este constructor privado (vease socket.h).
+ * Pipe temporal para el splice(). Es RAII asi no lo perdemos si se
+ * lanza una excepcion en el medio.
  * */
-Socket::Socket(int skt) : skt(skt), closed(false) {
-}
+struct SplicePipe {
+    int fds[2];
 
-Socket::Socket() : skt(-1), closed(true) {}
+    SplicePipe() {
+        if (pipe2(this->fds, O_CLOEXEC) == -1)
+            throw LibError(errno, "Socket recv_to_fd pipe failed: ");
 
-int Socket::recvsome(void *data, unsigned int sz, bool *was_closed) {
-    *was_closed = false;
-    int s = recv(this->skt, (char*)data, sz, 0);
-    if (s == 0) {
-        // Puede ser o no un error, dependera del protocolo.
-        // Alguno protocolo podria decir "se reciben datos hasta
-        // que la conexion se cierra" en cuyo caso el cierre del socket
-        // no es un error sino algo esperado.
-        *was_closed = true;
-        return 0;
-    } else if (s < 0) {
-        // 99% casi seguro que es un error real
-        throw LibError(errno, "Socket recvsome failed (len %d): ", sz);
-    } else {
-        return s;
+        // Un pipe mas grande (64 KiB por default) significa menos
+        // splice()s. Si no se puede, no importa.
+        fcntl(this->fds[1], F_SETPIPE_SZ, 1 << 20);
     }
-}
-
-int Socket::sendsome(const void *data, unsigned int sz, bool *was_closed) {
-    *was_closed = false;
-    int s = send(this->skt, (char*)data, sz, MSG_NOSIGNAL);
-    if (s == 0) {
-        // Puede o no ser un error (vease el comentario en recvsome())
-        *was_closed = true;
-        return 0;
-    } else if (s < 0) {
-        // Este es un caso especial: cuando enviamos algo pero en el medio
-        // se detecta un cierre del socket no se sabe bien cuanto se logro
-        // enviar (y fue recibido por el peer) y cuanto se perdio.
-        //
-        // Se dice que la "tuberia esta rota" o en ingles, "broken pipe"
-        //
-        // En Linux el sistema operativo envia una signal (SIGPIPE) que
-        // mata al proceso. El flag MSG_NOSIGNAL evita eso y nos permite
-        // checkear y manejar la condicion mas elegantemente
-        if (errno == EPIPE) {
-            // Puede o no ser un error (vease el comentario en recvsome())
-            *was_closed = true;
-            return 0;
-        }
 
-        // 99% casi seguro que es un error
-        throw LibError(errno, "Socket sendsome failed (len %d): ", sz);
-    } else {
-        return s;
+    ~SplicePipe() {
+        ::close(this->fds[0]);
+        ::close(this->fds[1]);
     }
-}
+};
 
-int Socket::recvall(void *data, unsigned int sz, bool *was_closed) {
-    unsigned int received = 0;
+long long Socket::recv_to_fd(int fd, long long len, bool *was_closed) {
+    const size_t chunk_sz = 1 << 20;
     *was_closed = false;
 
-    while (received < sz) try {
-        int s = this->recvsome((char*)data + received, sz - received, was_closed);
-        if (s == 0) {
-            // Si el socket fue cerrado (s == 0) pero es claro que no logramos
-            // recibir todo lo que queriamos recibir por lo que supondremos
-            // que es un error y lanzamos una excepcion.
-            //
-            // Podriamos crear nuestra propia clase UnexpectedClosed pero
-            // por simplicidad voy a lanzar std::runtime_error que es una excepcion
-            // estandar que me permite pasarle un mensaje simple
-            // a su constructor
-            throw std::runtime_error("Unexpected closed");
-        }
-        else {
-            // Ok, recibimos algo pero no necesariamente todo lo que
-            // esperamos. La condicion del while checkea eso justamente
-            received += s;
-        }
-    } catch (const LibError& err) {
-        throw LibError(err.error_code, "Socket recvall failed (len %d/%d): ", received, sz);
+    if (len > 0) {
+        // Best-effort: FALLOC_FL_KEEP_SIZE reserva los bloques sin cambiar
+        // el tamaño del archivo (si al final recibimos menos, el archivo
+        // no queda con basura al final).
+        off_t offset = lseek(fd, 0, SEEK_CUR);
+        if (offset != -1)
+            fallocate(fd, FALLOC_FL_KEEP_SIZE, offset, len);
     }
 
-    return sz;
-}
-
-
-int Socket::sendall(const void *data, unsigned int sz, bool *was_closed) {
-    unsigned int sent = 0;
-    *was_closed = false;
-
-    while (sent < sz) try {
-        int s = this->sendsome((char*)data + sent, sz - sent, was_closed);
-        if (s == 0) {
-            // Si el socket fue cerrado (s == 0) pero es claro que no logramos
-            // enviar todo lo que queriamos enviar por lo que supondremos
-            // que es un error y lanzamos una excepcion.
-            //
-            // Podriamos crear nuestra propia clase UnexpectedClosed pero
-            // por simplicidad voy a lanzar std::runtime_error que es una excepcion
-            // estandar que me permite pasarle un mensaje simple
-            // a su constructor
-            throw std::runtime_error("Unexpected closed");
+    SplicePipe pipe;
+    std::vector<char> buf;  // solo se usa si splice() no esta soportado
+    bool use_splice = true;
+    long long total = 0;
+
+    while (len < 0 or total < len) {
+        size_t chunk = chunk_sz;
+        if (len >= 0 and (long long)chunk > len - total)
+            chunk = len - total;
+
+        if (use_splice) {
+            ssize_t in = splice(this->skt, nullptr, pipe.fds[1], nullptr, chunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (in == -1) {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EINVAL) {
+                    // El socket no soporta splice(): no se movio nada
+                    use_splice = false;
+                    continue;
+                }
+                throw LibError(errno, "Socket recv_to_fd failed (len %lld/%lld): ", total, len);
+            } else if (in == 0) {
+                *was_closed = true;
+                break;
+            }
+
+            // Vaciamos el pipe en el archivo
+            ssize_t pending = in;
+            while (pending > 0) {
+                ssize_t out = splice(pipe.fds[0], nullptr, fd, nullptr, pending, SPLICE_F_MOVE | SPLICE_F_MORE);
+                if (out == -1) {
+                    if (errno == EINTR)
+                        continue;
+                    if (errno != EINVAL)
+                        throw LibError(errno, "Socket recv_to_fd failed (len %lld/%lld): ", total, len);
+
+                    // El archivo no soporta splice(): lo que quedo en el
+                    // pipe lo copiamos "a mano" y seguimos sin splice()
+                    use_splice = false;
+                    buf.resize(chunk_sz);
+                    while (pending > 0) {
+                        ssize_t r = ::read(pipe.fds[0], buf.data(), std::min((size_t)pending, buf.size()));
+                        if (r == -1) {
+                            if (errno == EINTR)
+                                continue;
+                            throw LibError(errno, "Socket recv_to_fd failed (len %lld/%lld): ", total, len);
+                        }
+                        write_all(fd, buf.data(), r);
+                        pending -= r;
+                    }
+                    break;
+                }
+                pending -= out;
+            }
+
+            total += in;
         } else {
-            sent += s;
+            buf.resize(chunk_sz);
+            int r = this->recvsome(buf.data(), chunk, was_closed);
+            if (*was_closed)
+                break;
+
+            write_all(fd, buf.data(), r);
+            total += r;
         }
-    } catch (const LibError& err) {
-        throw LibError(err.error_code, "Socket sendall failed (len %d/%d): ", sent, sz);
     }
 
-    return sz;
+    return total;
 }
 
-Socket Socket::accept() {
-    int skt = ::accept(this->skt, nullptr, nullptr);
+Socket Socket::connect_nonblocking(const struct sockaddr *addr, unsigned int addrlen) {
+    int skt = socket(addr->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (skt == -1)
-        throw LibError(errno, "Socket accept failed: ");
+        throw LibError(errno, "Socket creation failed: ");
+
+    // Lo adoptamos ya: si connect() falla el destructor lo cierra
+    Socket ret(skt);
 
     /*
-     * Creamos un Socket en el scope de Socket::accept() y lo retornamos.
-     * Por default C y C++ harian una copia pero copiar un Socket no tiene
-     * sentido y ya tenemos al constructor por copia deshabilitado
-     * asi que no funcionara.
-     *
-     * Lo que queremos es que este Socket siga vivo y se mueva al scope
-     * superior (a quien llamo a Socket::accept().
-     *
-     * Este es el corazon de Move Semantics.
+     * En un socket no bloqueante connect() retorna -1 con EINPROGRESS:
+     * el handshake sigue en el kernel y nos enteraremos del resultado
+     * cuando el socket sea writable. En loopback puede que ya haya
+     * terminado (retorna 0), lo que tambien esta bien.
      * */
-    return Socket(skt);
+    uint64_t t0 = Trace::now();
+    int s = ::connect(skt, addr, addrlen);
+    Trace::record(Trace::CONNECT, skt, 0, s == -1 ? -errno : s, t0);
+    if (s == -1 and errno != EINPROGRESS)
+        throw LibError(errno, "Socket connect failed: ");
+
+    Recorder::open(skt, Recorder::OPEN_CONNECTED);
+    return ret;
 }
 
-void Socket::shutdown(int how) {
-    if (::shutdown(this->skt, how) == -1) {
-        throw LibError(errno, "Socket shutdown failed: ");
-    }
-}
+int Socket::finish_connect() {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(this->skt, SOL_SOCKET, SO_ERROR, &err, &len) == -1)
+        return errno;
 
-int Socket::close() {
-    // Aunque estrictamente uno deberia chequear el codigo de error
-    // de close(), el hecho es que no hay mucho que se pueda hacer
-    // al respecto.
-    this->closed = true;
-    return ::close(this->skt);
-}
+    if (err != 0)
+        return err;
 
-Socket::~Socket() {
-    if (not this->closed) {
-        // Aunque estrictamente uno deberia chequear el codigo de error
-        // de shutdown() y close(), el hecho es que no hay mucho que se pueda hacer
-        // al respecto.
-        // Es mas, intentar lanzar una excepcion desde un destructor lleva
-        // al programa abortar asi que lo mejor es dejarlo asi.
-        ::shutdown(this->skt, 2);
-        ::close(this->skt);
-    }
-}
+    // Conectado: de aqui en mas es un Socket bloqueante como cualquier otro
+    int flags = fcntl(this->skt, F_GETFL);
+    if (flags == -1 or fcntl(this->skt, F_SETFL, flags & ~O_NONBLOCK) == -1)
+        return errno;
 
-Socket::Socket(Socket&& other) {
-    this->skt = other.skt;
-    this->closed = other.closed;
-
-    // Le robamos al otro socket su file descriptor.
-    // A partir de aqui somos nosotros (this) los dueños
-    // del recurso.
-    //
-    // Hubo una transferencia de ownership y por lo tanto
-    // debemos hacer que el destructor del otro socket no
-    // libere los recursos.
-    //
-    // Para Socket con esto alcanza (mirate Resolver)
-    other.skt = -1;
-    other.closed = true;
+    return 0;
 }
 
-Socket& Socket::operator=(Socket&& other) {
-    // Este es un caso borde donde alguien codeo
-    //  skt = skt;
-    //
-    // Si alguien quiere "moverse a si mismo" no hacemos nada.
-    if (this == &other)
-        return *this;
-
-    // A diferencia del constructor por movimiento, nosotros
-    // somos un objeto ya construido.
-    // Antes de tomar el ownership del otro socket debemos
-    // liberar nuestro propio recurso.
-    // Al igual que en ~Socket() no chequeamos errores.
-    if (not this->closed) {
-        ::shutdown(this->skt, 2);
-        ::close(this->skt);
-    }
-
-    // A partir de aqui hacemos lo mismo que en el constructor
-    // por movimiento.
-    //
-    // Le robamos el recurso al otro, transferimos el ownership
-    // del recurso del otro socket hacia el nuestro.
-    this->skt = other.skt;
-    this->closed = other.closed;
+Socket Socket::accept() {
+    // Como BasicSocket::accept() pero el peer es un Socket
+    return Socket(this->accept_fd());
+}
 
-    other.skt = -1;
-    other.closed = true;
+Socket::Socket(Socket&& other) : BasicSocket(std::move(other)) {}
 
+Socket& Socket::operator=(Socket&& other) {
+    BasicSocket::operator=(std::move(other));
     return *this;
 }
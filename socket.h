@@ -1,110 +1,266 @@
 #ifndef SOCKET_H
 #define SOCKET_H
 
+#include <stdint.h>
+
+#include "basicsocket.h"
+
 /*
  * Socket.
  * Por simplificacion este TDA se enfocara solamente
- * en sockets IPv4 para TCP.
+ * en sockets IPv4 para TCP: es BasicSocket<Inet4, Stream> (vease
+ * basicsocket.h, de donde hereda el envio y la recepcion) mas lo que
+ * solo tiene sentido en TCP.
  * */
-class Socket {
-    int skt;
-    bool closed;
-
-    Socket(int skt);
-
+class Socket : public BasicSocket<Inet4, Stream> {
     public:
     /*
-     * Construye el socket tanto para conectarse a un servidor
-     * (primer constructor) como para inicializarlo para ser usado
-     * por un servidor (segundo constructor).
+     * Timestamps del kernel (vease Socket::set_timestamping()), en
+     * nanosegundos desde el epoch (CLOCK_REALTIME). Un valor en 0
+     * significa que ese timestamp no esta disponible.
      *
-     * Muchas librerias de muchos lenguajes ofrecen una unica formal de inicializar
-     * los sockets y luego metodos (post-inicializacion) para establer
-     * la conexion o ponerlo en escucha.
+     * software_ns lo toma el stack de red del kernel; hardware_ns lo
+     * toma la placa de red (solo si la placa lo soporta y fue
+     * configurada para eso, lo que requiere privilegios; en loopback
+     * nunca hay).
+     * */
+    struct Timestamp {
+        uint64_t software_ns;
+        uint64_t hardware_ns;
+    };
+
+    /*
+     * Un timestamp de envio. Un mismo send() puede generar hasta tres:
      *
-     * Otras librerias/lenguajes van por tener una inicializacion para
-     * el socket activo y otra para el pasivo.
+     *  - SCHED: los datos entraron a la cola (qdisc) de la interfaz
+     *  - SENT: la interfaz los tomo para enviarlos (driver)
+     *  - ACKED: el peer confirmo (ACK) haberlos recibido
      *
-     * Este codigo es un ejemplo de ello.
+     * bytes identifica el send(): es la cantidad de bytes enviados por
+     * el socket desde Socket::set_timestamping() hasta el ultimo byte
+     * de ese send() inclusive (modulo 2^32). El caller, que sabe cuanto
+     * envio, lo usa para saber a que mensaje corresponde.
+     * */
+    struct TxTimestamp {
+        enum Kind { SCHED, SENT, ACKED };
+
+        Kind kind;
+        uint32_t bytes;
+        Timestamp ts;
+    };
+
+    /*
+     * Estado de la conexion TCP segun el kernel (TCP_INFO), vease
+     * Socket::tcp_info(). Los campos que el kernel no soporta (los mas
+     * nuevos en kernels viejos) quedan en 0.
+     * */
+    struct TcpInfo {
+        uint8_t state;                  // TCP_ESTABLISHED, TCP_CLOSE_WAIT, ...
+
+        // Red
+        uint32_t rtt_us;                // RTT suavizado
+        uint32_t rttvar_us;
+        uint32_t min_rtt_us;
+        uint32_t retransmits;           // segmentos retransmitidos en total
+        uint32_t lost;                  // segmentos que se creen perdidos ahora
+
+        // Control de congestion
+        uint32_t snd_cwnd;              // ventana de congestion, en segmentos
+        uint32_t snd_ssthresh;
+        uint32_t snd_mss;
+        uint64_t delivery_rate;         // bytes/s entregados (estimado)
+        uint64_t pacing_rate;           // bytes/s
+
+        // Datos
+        uint64_t unacked_bytes;         // enviados sin ACK (en vuelo)
+        uint32_t notsent_bytes;         // en el buffer de envio, sin enviar
+        uint64_t bytes_acked;
+        uint64_t bytes_received;
+
+        // Que limito al envio (microsegundos): si rwnd_limited es alto
+        // el que no da abasto es el receptor; si sndbuf_limited es alto,
+        // nuestro buffer de envio
+        uint64_t busy_us;
+        uint64_t rwnd_limited_us;
+        uint64_t sndbuf_limited_us;
+    };
+
+    private:
+    /*
+     * Construye un Socket a partir de un file descriptor ya existente
+     * y toma su ownership (lo "adopta").
      *
+     * Es privado: el codigo del usuario no deberia manipular file
+     * descriptors. Solo Socket::accept() y Handoff (que recibe el
+     * listener de otro proceso en un hot restart) lo usan.
+     * */
+    explicit Socket(int skt);
+
+    friend class Handoff;
+
+    /*
+     * Poller registra el file descriptor en epoll (vease poller.h)
+     * */
+    friend class Poller;
+
+    public:
+    /*
+     * Construye el socket tanto para conectarse a un servidor
+     * (primer constructor) como para inicializarlo para ser usado
+     * por un servidor (segundo constructor). Vease BasicSocket.
      * */
     Socket(const char *hostname, const char *servicename);
     Socket(const char *servicename);
 
-    /* Socket::sendsome() lee hasta sz bytes del buffer y los envia. La funcion
-     * puede enviar menos bytes sin embargo.
+    /*
+     * Conexion no bloqueante.
      *
-     * Socket::recvsome() por el otro lado recibe hasta sz bytes y los escribe
-     * en el buffer (que debe estar pre-allocado). La funcion puede recibir
-     * menos bytes sin embargo.
+     * El constructor Socket(hostname, servicename) se bloquea hasta que
+     * el handshake TCP termina: conectarse a mil servers asi es hacerlo
+     * de a uno. Socket::connect_nonblocking() en cambio solo *inicia* la
+     * conexion contra la direccion addr (tipicamente obtenida con
+     * Resolver) y retorna enseguida.
      *
-     * Si el socket detecto que la conexion fue cerrada, la variable
-     * was_closed es puesta a True, de otro modo sera False.
+     * La conexion termino (bien o mal) cuando el socket se vuelve
+     * writable (vease poller.h). En ese momento hay que llamar a
+     * Socket::finish_connect() que retorna 0 si se conecto o el codigo
+     * de error (errno) si no (por ejemplo ECONNREFUSED).
      *
-     * Retorna 0 si se cerro el socket, menor a 0 si hubo un error
-     * o positivo que indicara cuantos bytes realmente se enviaron/recibieron.
+     * Una vez conectado el socket vuelve a ser bloqueante como cualquier
+     * otro Socket.
+     * */
+    static Socket connect_nonblocking(const struct sockaddr *addr, unsigned int addrlen);
+    int finish_connect();
+
+    /*
+     * sendsome(), recvsome(), sendall(), recvall(), set_busy_poll(),
+     * shutdown() y close() son los de BasicSocket.
+     * */
+    using BasicSocket::recvsome;
+
+    /*
+     * CPU que proceso los ultimos paquetes recibidos por este socket
+     * (SO_INCOMING_CPU) o -1 si no se sabe (por ejemplo si todavia no
+     * llego nada o el kernel no lo soporta).
      *
-     * Lease man send y man recv
+     * Para un socket recien aceptado es el CPU que proceso su handshake:
+     * un server puede darselo al Worker que corre en ese CPU para que
+     * el kernel y la aplicacion trabajen con los mismos caches
+     * (vease affinity.h).
      * */
-    int sendsome(const void *data, unsigned int sz, bool *was_closed);
-    int recvsome(void *data, unsigned int sz, bool *was_closed);
+    int incoming_cpu() const;
 
     /*
-     * Socket::sendall() envia exactamente sz bytes leidos del buffer, ni mas,
-     * ni menos. Socket::recvall() recibe exactamente sz bytes.
+     * Cantidad de bytes recibidos por el kernel que todavia no se
+     * leyeron (FIONREAD) o -1 si no se puede saber.
      *
-     * Si hay un error o el socket se cerro durante el envio/recibo de los bytes
-     * no hay forma certera de saber cuantos bytes realmente se enviaron/recibieron.
+     * Sirve para dimensionar el buffer del proximo recvsome() (vease
+     * recvbuffer.h).
+     * */
+    int pending() const;
+
+    /*
+     * Fija SO_RCVLOWAT: un recv() bloqueante (y epoll/poll) no considera
+     * al socket "readable" hasta que haya al menos bytes bytes en cola
+     * (o el peer cierre la conexion).
      *
-     * En caso de error se retorna un valor negativo, se retorna 0
-     * si el socket se cerro o un valor positivo igual a sz si se envio/recibio
-     * todo lo pedido.
+     * En un stream de muchos datos eso ahorra despertares y recv() que
+     * traen de a poco; en cambio un mensaje mas chico que bytes queda
+     * esperando a que llegue mas. Solo tiene sentido si el protocolo
+     * garantiza que el peer enviara al menos esa cantidad.
      *
-     * En caso de que se cierre el socket, was_closed es puesto a True.
+     * Con bytes == 1 se vuelve al default.
      * */
-    int sendall(const void *data, unsigned int sz, bool *was_closed);
-    int recvall(void *data, unsigned int sz, bool *was_closed);
+    void set_recv_lowat(int bytes);
 
     /*
-     * Acepta una conexion entrante y construye con ella un Socket peer.
-     * Dicho Socket peer es retornado por move semantics.
+     * Timestamps del kernel (SO_TIMESTAMPING), opt-in.
+     *
+     * Medir latencia con relojes de user-space alrededor de sendall()
+     * y recvsome() mezcla el tiempo de la red con el del stack del
+     * kernel y con el que el thread espero al scheduler. Con los
+     * timestamps del kernel se puede separar:
+     *
+     *  - cuanto tardo el stack en encolar lo enviado (SCHED - send())
+     *  - cuanto estuvo en la cola de la interfaz (SENT - SCHED)
+     *  - la red y el peer (hasta el timestamp de recepcion)
+     *  - cuanto tardo la aplicacion en leerlo una vez que llego
+     *    (retorno de recvsome() - timestamp de recepcion)
+     *
+     * Se piden timestamps de software y de hardware; los de hardware
+     * solo aparecen si la placa los da (vease Socket::Timestamp).
+     *
+     * Con enable == false se desactivan.
      * */
-    Socket accept();
+    void set_timestamping(bool enable);
 
     /*
-     * Cierra la conexion ya sea parcial o completamente.
-     * Lease man 2 shutdown
+     * Como BasicSocket::recvsome() pero ademas pone en rx el timestamp de
+     * recepcion del kernel de lo leido (si la lectura junto datos de
+     * varios paquetes, el del ultimo). Si no hay timestamps (no se
+     * llamo a set_timestamping()) rx queda en 0.
+     *
+     * Igual que BasicSocket::recvsome(), en un socket no bloqueante sin
+     * nada para leer retorna -1 (y rx queda en 0).
+     *
+     * No hace busy polling aunque este activado (vease
+     * BasicSocket::set_busy_poll()).
      * */
-    void shutdown(int how);
+    int recvsome(void *data, unsigned int sz, bool *was_closed, Timestamp *rx);
 
     /*
-     * Cierra el socket. El cierre no implica un shutdown
-     * que debe ser llamado explicitamente.
+     * Los timestamps de envio llegan despues del send(), por la cola de
+     * errores del socket. Socket::tx_timestamp() lee el siguiente sin
+     * bloquearse: retorna false si todavia no hay ninguno.
      * */
-    int close();
+    bool tx_timestamp(TxTimestamp *tx);
 
     /*
-     * Desinicializa el socket. Si aun esta conectado,
-     * se llamara a Socket::shutdown() y Socket::close()
-     * automaticamente.
+     * Muestrea TCP_INFO: lo que el kernel sabe de la salud de la
+     * conexion (RTT, retransmisiones, ventana de congestion, tasa de
+     * entrega, bytes en vuelo).
+     *
+     * Cuando una conexion es lenta permite distinguir si es la red
+     * (RTT alto, retransmisiones, cwnd chica) o la aplicacion (bytes
+     * esperando en el buffer de envio, receptor que no lee). Es un
+     * getsockopt(): barato pero no gratis, para muestrear cada tanto
+     * y no en cada send(). Vease tcptelemetry.h.
      * */
-    ~Socket();
+    TcpInfo tcp_info() const;
+
 
     /*
-     * Copiar un Socket carece de todo sentido. Como lo copiarias?
-     * Estarian conectados al mismo server? Que pasaria del lado del server
-     * si ahora su cliente tiene 2 sockets hacia él?
+     * Socket::recv_to_fd() recibe del socket y escribe lo recibido en el
+     * file descriptor fd (tipicamente un archivo abierto por el caller)
+     * hasta recibir len bytes o, si len es negativo, hasta que el peer
+     * cierre la conexion.
+     *
+     * Con recvsome() cada byte se copia del kernel a nuestro buffer y
+     * despues de nuestro buffer de vuelta al kernel con write().
+     * Aca en cambio se usa splice(): los datos van del socket a un pipe
+     * y del pipe al archivo sin pasar nunca por user-space.
      *
-     * Simplemente no tiene sentido.
+     * Si splice() no esta soportado para el fd (por ejemplo, un archivo
+     * abierto con O_APPEND) se cae a un recv()/write() con un buffer
+     * grande (1 MiB).
      *
-     * Ya que C++ nos crea por default el constructor y el operador asignacion
-     * por copia, lo unico razonable es prohibir los.
+     * Si len es positivo se pre-reserva ese espacio en el archivo
+     * (fallocate(), best-effort) para evitar fragmentacion.
+     *
+     * Retorna la cantidad de bytes escritos en fd. Si el peer cerro la
+     * conexion, was_closed es puesto a True (lo que con len negativo
+     * es el final esperado).
      * */
-    Socket(const Socket&) = delete;
-    Socket& operator=(const Socket&) = delete;
+    long long recv_to_fd(int fd, long long len, bool *was_closed);
+
+    /*
+     * Acepta una conexion entrante y construye con ella un Socket peer.
+     * Dicho Socket peer es retornado por move semantics.
+     * */
+    Socket accept();
 
     /*
-     * Socket es movible
+     * Socket es movible (pero no copiable, como BasicSocket)
      * */
     Socket(Socket&&);
     Socket& operator=(Socket&&);
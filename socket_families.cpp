@@ -0,0 +1,143 @@
+#include <iostream>
+#include "basicsocket.h"
+
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <stdexcept>
+#include <exception>
+
+/*
+ * Recorre las combinaciones de familia y transporte de BasicSocket
+ * (vease basicsocket.h) que no usa ningun otro programa, cada una con
+ * un server en un thread y un cliente:
+ *
+ *  - Unix / SeqPacket: con conexion pero preservando los limites de
+ *    mensaje: dos sendall() son dos recvsome() aunque el buffer del
+ *    receptor alcance para ambos
+ *
+ *  - Inet6 / Stream: el mismo echo que con Socket pero sobre IPv6
+ *
+ *  - Inet4 / Datagram: sendto()/recvfrom(), incluyendo un datagrama
+ *    vacio (que en Datagram no es un cierre)
+ *
+ * Por cada una se imprime que se verifico; si algo no es lo esperado
+ * se lanza una excepcion.
+ *
+ * Ademas de demostrar el uso, sirve para que el compilador instancie
+ * estas combinaciones: un error de tipos en el template (o un
+ * static_assert mal puesto) aparece al compilar este programa. Con
+ * compare_socket_codegen.sh se compara el codigo generado para
+ * BasicSocket<Inet4, Stream> contra el Socket anterior al template.
+ *
+ * Uso:
+ *
+ *  ./socket_families
+ * */
+
+static void expect(bool ok, const char *what) {
+    if (not ok)
+        throw std::runtime_error(std::string("Unexpected result: ") + what);
+}
+
+static void unix_seqpacket() {
+    const char *path = "/tmp/socket_families.sock";
+    BasicSocket<Unix, SeqPacket> srv(path);
+
+    // Echo mensaje por mensaje hasta que el cliente cierre
+    std::thread server([&srv] {
+        bool was_closed = false;
+        BasicSocket<Unix, SeqPacket> peer = srv.accept();
+
+        char buf[64];
+        while (true) {
+            int n = peer.recvsome(buf, sizeof(buf), &was_closed);
+            if (was_closed)
+                break;
+            peer.sendall(buf, n, &was_closed);
+        }
+    });
+
+    bool was_closed = false;
+    BasicSocket<Unix, SeqPacket> cli(nullptr, path);
+    cli.sendall("hola", 4, &was_closed);
+    cli.sendall("mundo!", 6, &was_closed);
+
+    char buf[64];
+    int a = cli.recvsome(buf, sizeof(buf), &was_closed);
+    int b = cli.recvsome(buf, sizeof(buf), &was_closed);
+    expect(a == 4 and b == 6, "seqpacket message boundaries");
+
+    cli.shutdown(SHUT_WR);
+    server.join();
+    unlink(path);
+
+    std::cout << "Unix/SeqPacket: 2 messages of " << a << " and " << b << " bytes, boundaries preserved\n";
+}
+
+static void inet6_stream() {
+    BasicSocket<Inet6, Stream> srv("3142");
+
+    std::thread server([&srv] {
+        bool was_closed = false;
+        BasicSocket<Inet6, Stream> peer = srv.accept();
+
+        char buf[5];
+        peer.recvall(buf, sizeof(buf), &was_closed);
+        peer.sendall(buf, sizeof(buf), &was_closed);
+    });
+
+    bool was_closed = false;
+    BasicSocket<Inet6, Stream> cli("::1", "3142");
+    cli.sendall("ipv6!", 5, &was_closed);
+
+    char buf[5];
+    cli.recvall(buf, sizeof(buf), &was_closed);
+    expect(memcmp(buf, "ipv6!", 5) == 0, "inet6 echo");
+
+    server.join();
+
+    std::cout << "Inet6/Stream: echo over ::1 ok\n";
+}
+
+static void inet4_datagram() {
+    BasicSocket<Inet4, Datagram> srv("3143");
+    BasicSocket<Inet4, Datagram> cli("127.0.0.1", "3143");
+
+    bool was_closed = false;
+    cli.sendsome("", 0, &was_closed);
+    cli.sendsome("udp", 3, &was_closed);
+
+    char buf[64];
+    BasicSocket<Inet4, Datagram>::Address from;
+    int a = srv.recvfrom(buf, sizeof(buf), &from);
+    int b = srv.recvfrom(buf, sizeof(buf), &from);
+    expect(a == 0 and b == 3, "datagram sizes");
+
+    srv.sendto("ack", 3, from);
+    int c = cli.recvsome(buf, sizeof(buf), &was_closed);
+    expect(c == 3 and not was_closed, "datagram reply");
+
+    std::cout << "Inet4/Datagram: empty datagram received as 0 bytes (not a close), reply of " << c << " bytes\n";
+}
+
+int main(int argc, char *argv[]) try {
+    if (argc != 1) {
+        std::cerr << "Bad program call. Expected " << argv[0] << " without arguments\n";
+        return -1;
+    }
+
+    unix_seqpacket();
+    inet6_stream();
+    inet4_datagram();
+    return 0;
+} catch (const std::exception& err) {
+    std::cerr << "Something went wrong and an exception was caught: " << err.what() << "\n";
+    return -1;
+} catch (...) {
+    std::cerr << "Something went wrong and an unknown exception was caught.\n";
+    return -1;
+}
@@ -0,0 +1,69 @@
+#include "tcptelemetry.h"
+
+TcpTelemetry::TcpTelemetry() : outliers(0) {}
+
+bool TcpTelemetry::record(const Socket::TcpInfo& info) {
+    /*
+     * El umbral se calcula *antes* de registrar la muestra: un outlier
+     * no deberia correr la mediana con la que se lo juzga.
+     * */
+    bool outlier = info.retransmits > 0;
+    if (this->baseline_rtt_us.count() >= MIN_SAMPLES) {
+        unsigned long long limit = OUTLIER_RTT_FACTOR * this->baseline_rtt_us.percentile(50);
+        if (limit < MIN_OUTLIER_RTT_US)
+            limit = MIN_OUTLIER_RTT_US;
+        outlier = outlier or info.rtt_us > limit;
+    }
+
+    this->baseline_rtt_us.record(info.rtt_us);
+    this->rtt_us.record(info.rtt_us);
+    this->retransmits.record(info.retransmits);
+    this->delivery_rate.record(info.delivery_rate);
+    this->unacked_bytes.record(info.unacked_bytes);
+
+    if (outlier)
+        ++this->outliers;
+    return outlier;
+}
+
+void TcpTelemetry::merge(const TcpTelemetry& other) {
+    this->rtt_us.merge(other.rtt_us);
+    this->retransmits.merge(other.retransmits);
+    this->delivery_rate.merge(other.delivery_rate);
+    this->unacked_bytes.merge(other.unacked_bytes);
+    this->outliers += other.outliers;
+}
+
+void TcpTelemetry::reset() {
+    this->rtt_us = Histogram();
+    this->retransmits = Histogram();
+    this->delivery_rate = Histogram();
+    this->unacked_bytes = Histogram();
+    this->outliers = 0;
+}
+
+unsigned long long TcpTelemetry::count() const {
+    return this->rtt_us.count();
+}
+
+void TcpTelemetry::write_json(std::ostream& out) const {
+    out << "{\"samples\": " << this->count()
+        << ", \"outliers\": " << this->outliers
+        << ", \"rtt_us\": ";
+    this->rtt_us.write_json(out, 1);
+    out << ", \"retransmits\": ";
+    this->retransmits.write_json(out, 1);
+    out << ", \"delivery_rate_MBps\": ";
+    this->delivery_rate.write_json(out, 1e6);
+    out << ", \"unacked_bytes\": ";
+    this->unacked_bytes.write_json(out, 1);
+    out << "}";
+}
+
+void TcpTelemetry::write_sample(std::ostream& out, const Socket::TcpInfo& info) {
+    out << "rtt " << info.rtt_us << " us (min " << info.min_rtt_us << ", var " << info.rttvar_us << ")"
+        << ", retransmits " << info.retransmits << ", lost " << info.lost
+        << ", cwnd " << info.snd_cwnd << ", delivery " << info.delivery_rate / 1e6 << " MB/s"
+        << ", unacked " << info.unacked_bytes << " bytes, notsent " << info.notsent_bytes << " bytes"
+        << ", rwnd limited " << info.rwnd_limited_us << " us, sndbuf limited " << info.sndbuf_limited_us << " us";
+}
@@ -0,0 +1,76 @@
+#ifndef TCPTELEMETRY_H
+#define TCPTELEMETRY_H
+
+#include <ostream>
+
+#include "socket.h"
+#include "histogram.h"
+
+/*
+ * Telemetria de transporte: junta muestras de Socket::tcp_info() de
+ * muchas conexiones en histogramas de RTT, retransmisiones, tasa de
+ * entrega y bytes en vuelo, y detecta las conexiones "raras"
+ * (outliers).
+ *
+ * Una muestra es un outlier si la conexion retransmitio o si su RTT
+ * supera OUTLIER_RTT_FACTOR veces la mediana de RTT de todas las
+ * muestras vistas (y al menos MIN_OUTLIER_RTT_US, para que en
+ * loopback unos pocos microsegundos de diferencia no cuenten). La
+ * mediana solo se usa una vez que hay MIN_SAMPLES muestras.
+ *
+ * Esa mediana sale de un histograma aparte (la linea de base) que
+ * TcpTelemetry::reset() no descarta: si no, al comienzo de cada
+ * periodo no habria contra que comparar y un periodo "malo" se
+ * juzgaria contra si mismo.
+ *
+ * Como Histogram, no es thread-safe: cada thread (Worker) tiene la
+ * suya y se combinan con TcpTelemetry::merge() (vease
+ * telemetryaggregator.h).
+ * */
+class TcpTelemetry {
+    Histogram baseline_rtt_us;      // todas las muestras, vease arriba
+    Histogram rtt_us;
+    Histogram retransmits;
+    Histogram delivery_rate;
+    Histogram unacked_bytes;
+    unsigned long long outliers;
+
+    public:
+    static const unsigned int OUTLIER_RTT_FACTOR = 4;
+    static const unsigned long long MIN_OUTLIER_RTT_US = 1000;
+    static const unsigned long long MIN_SAMPLES = 100;
+
+    TcpTelemetry();
+
+    /*
+     * Registra una muestra. Retorna true si es un outlier.
+     * */
+    bool record(const Socket::TcpInfo& info);
+
+    /*
+     * Suma las muestras del periodo de other (no su linea de base: la
+     * de cada TcpTelemetry es acumulada y sumarla en cada periodo la
+     * contaria varias veces).
+     * */
+    void merge(const TcpTelemetry& other);
+
+    /*
+     * Descarta las muestras del periodo (por ejemplo, al cerrarlo). La
+     * linea de base se mantiene.
+     * */
+    void reset();
+
+    unsigned long long count() const;
+
+    /*
+     * Escribe un resumen de los histogramas como un objeto JSON.
+     * */
+    void write_json(std::ostream& out) const;
+
+    /*
+     * Escribe una muestra en una linea (para loguear outliers).
+     * */
+    static void write_sample(std::ostream& out, const Socket::TcpInfo& info);
+};
+
+#endif
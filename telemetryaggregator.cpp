@@ -0,0 +1,38 @@
+#include <iostream>
+#include <sstream>
+
+#include "telemetryaggregator.h"
+
+TelemetryAggregator::TelemetryAggregator(unsigned int interval_ms) :
+    interval(interval_ms), next_report(std::chrono::steady_clock::now() + interval) {}
+
+void TelemetryAggregator::add(const TcpTelemetry& samples) {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    this->total.merge(samples);
+
+    auto now = std::chrono::steady_clock::now();
+    if (now < this->next_report)
+        return;
+
+    this->write();
+    this->next_report = now + this->interval;
+}
+
+void TelemetryAggregator::flush() {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    this->write();
+}
+
+void TelemetryAggregator::write() {
+    if (this->total.count() == 0)
+        return;
+
+    // Armamos la linea entera antes de escribirla: otros threads
+    // (los outliers de los Workers) tambien escriben en stderr
+    std::ostringstream line;
+    line << "TCP telemetry: ";
+    this->total.write_json(line);
+    line << "\n";
+    std::cerr << line.str();
+    this->total.reset();
+}
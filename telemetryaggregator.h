@@ -0,0 +1,49 @@
+#ifndef TELEMETRY_AGGREGATOR_H
+#define TELEMETRY_AGGREGATOR_H
+
+#include <chrono>
+#include <mutex>
+
+#include "tcptelemetry.h"
+
+/*
+ * Junta la telemetria de transporte (vease tcptelemetry.h) de todos los
+ * Workers de un server para loguear un unico resumen por periodo.
+ *
+ * Cada Worker sigue registrando en su propia TcpTelemetry, sin locks;
+ * una vez por periodo le pasa sus muestras al TelemetryAggregator con
+ * TelemetryAggregator::add() (ese si es thread-safe) y las descarta.
+ *
+ * El resumen lo escribe el Worker que llega con el periodo ya vencido,
+ * asi que no hace falta otro thread. Como los Workers no estan
+ * sincronizados, las muestras de uno que llega un poco tarde caen en el
+ * resumen siguiente: el total a lo largo del tiempo no cambia.
+ * */
+class TelemetryAggregator {
+    std::mutex mtx;
+    TcpTelemetry total;
+    std::chrono::milliseconds interval;
+    std::chrono::steady_clock::time_point next_report;
+
+    void write();
+
+    public:
+    explicit TelemetryAggregator(unsigned int interval_ms);
+
+    /*
+     * Suma las muestras del periodo de samples. Si el periodo del
+     * server ya vencio escribe el resumen en stderr y empieza otro.
+     * */
+    void add(const TcpTelemetry& samples);
+
+    /*
+     * Escribe lo que quede sin reportar (por ejemplo, una vez que
+     * terminaron todos los Workers).
+     * */
+    void flush();
+
+    TelemetryAggregator(const TelemetryAggregator&) = delete;
+    TelemetryAggregator& operator=(const TelemetryAggregator&) = delete;
+};
+
+#endif
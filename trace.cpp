@@ -0,0 +1,262 @@
+#include "trace.h"
+
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <new>
+
+/*
+ * El ring de un thread.
+ *
+ * Solo el thread dueño escribe en events y en head. head cuenta *todos*
+ * los eventos registrados: el siguiente evento va en head % RING_EVENTS
+ * y cuando head supera RING_EVENTS empezamos a pisar los mas viejos.
+ *
+ * head es atomico para que Trace::dump() (que corre en otro thread o en
+ * un signal handler) vea los eventos completos antes que el head nuevo.
+ * */
+struct Ring {
+    std::atomic<uint64_t> head;
+    std::atomic<bool> in_use;
+    uint32_t tid;
+    Trace::Event events[Trace::RING_EVENTS];
+};
+
+/*
+ * Todos los rings, para que Trace::dump() pueda recorrerlos.
+ *
+ * Los rings nunca se liberan: cuando un thread termina su ring queda
+ * libre (in_use == false) y lo reutiliza el proximo thread. Asi la
+ * memoria usada es proporcional a la cantidad de threads *simultaneos*
+ * y no a la cantidad total de threads que se crearon.
+ * */
+static const int MAX_RINGS = 256;
+static std::atomic<Ring*> rings[MAX_RINGS];
+
+static thread_local Ring *current = nullptr;
+static thread_local bool no_ring = false;
+
+static uint64_t ticks0;
+static uint64_t ns0;
+
+/*
+ * Registramos el primer par (ticks, monotonic) al cargar el programa.
+ * */
+struct Calibration {
+    Calibration() {
+        ns0 = Trace::monotonic_ns();
+        ticks0 = Trace::now();
+    }
+};
+static Calibration calibration;
+
+/*
+ * Libera el ring cuando el thread termina (el destructor de una variable
+ * thread_local corre al finalizar el thread).
+ * */
+struct RingReleaser {
+    ~RingReleaser() {
+        if (current) {
+            current->in_use.store(false, std::memory_order_release);
+            current = nullptr;
+        }
+        no_ring = true;
+    }
+};
+
+/*
+ * El camino lento: la primera vez que un thread registra un evento
+ * buscamos un ring libre o creamos uno nuevo.
+ * */
+static Ring* acquire_ring() {
+    // new y syscall() pueden pisar errno y Trace::record() promete no hacerlo
+    int errno_saved = errno;
+    Ring *ring = nullptr;
+
+    for (int i = 0; i < MAX_RINGS and not ring; ++i) {
+        Ring *r = rings[i].load(std::memory_order_acquire);
+        bool expected = false;
+        if (r and r->in_use.compare_exchange_strong(expected, true))
+            ring = r;
+    }
+
+    if (not ring) {
+        ring = new (std::nothrow) Ring();
+        if (ring) {
+            ring->in_use = true;
+
+            bool registered = false;
+            for (int i = 0; i < MAX_RINGS and not registered; ++i) {
+                Ring *expected = nullptr;
+                registered = rings[i].compare_exchange_strong(expected, ring);
+            }
+
+            if (not registered) {
+                // Demasiados threads simultaneos: este no se tracea
+                delete ring;
+                ring = nullptr;
+            }
+        }
+    }
+
+    if (ring) {
+        // Un ring reutilizado arranca vacio: los eventos del thread
+        // anterior no tienen nada que ver con este.
+        ring->tid = (uint32_t)syscall(SYS_gettid);
+        ring->head.store(0, std::memory_order_release);
+
+        static thread_local RingReleaser releaser;
+        (void)releaser;
+    } else {
+        no_ring = true;
+    }
+
+    errno = errno_saved;
+    return ring;
+}
+
+uint64_t Trace::monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void Trace::record(Op op, int fd, unsigned int size, long long result, uint64_t begin) {
+    uint64_t end = Trace::now();
+
+    Ring *ring = current;
+    if (not ring) {
+        if (no_ring)
+            return;
+
+        ring = current = acquire_ring();
+        if (not ring)
+            return;
+    }
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    Event& ev = ring->events[head % RING_EVENTS];
+
+    ev.begin = begin;
+    ev.result = result;
+    ev.size = size;
+    ev.fd = fd;
+    ev.duration = end - begin > UINT32_MAX ? UINT32_MAX : (uint32_t)(end - begin);
+    ev.op = op;
+
+    // release: quien lea el head nuevo vera el evento completo
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+/*
+ * write() que reintenta hasta escribir todo. Async-signal-safe.
+ * */
+static bool write_all(int fd, const void *data, size_t sz) {
+    const char *p = (const char*)data;
+    while (sz > 0) {
+        ssize_t s = ::write(fd, p, sz);
+        if (s == -1) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += s;
+        sz -= s;
+    }
+    return true;
+}
+
+bool Trace::dump(const char *path) noexcept {
+    int errno_saved = errno;
+
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        errno = errno_saved;
+        return false;
+    }
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "SKTTRACE", sizeof(header.magic));
+    header.version = 1;
+    header.ticks0 = ticks0;
+    header.ns0 = ns0;
+    header.ns1 = Trace::monotonic_ns();
+    header.ticks1 = Trace::now();
+
+    /*
+     * Tomamos una foto de los rings: un thread que arranca mientras
+     * volcamos podria registrar su ring entre que contamos y que
+     * escribimos, y el header diria menos rings de los escritos.
+     * Contamos y escribimos desde la misma foto. (Un array en el stack,
+     * nada de malloc(): esto corre dentro de un signal handler.)
+     * */
+    Ring *snapshot[MAX_RINGS];
+    for (int i = 0; i < MAX_RINGS; ++i) {
+        snapshot[i] = rings[i].load(std::memory_order_acquire);
+        if (snapshot[i])
+            ++header.rings;
+    }
+
+    bool ok = write_all(fd, &header, sizeof(header));
+
+    for (int i = 0; i < MAX_RINGS and ok; ++i) {
+        Ring *ring = snapshot[i];
+        if (not ring)
+            continue;
+
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        RingHeader rh;
+        rh.tid = ring->tid;
+        rh.count = head < RING_EVENTS ? (uint32_t)head : RING_EVENTS;
+
+        // Los eventos del mas viejo al mas nuevo: si el ring dio la
+        // vuelta son dos tramos, [start, fin) y [0, head % RING_EVENTS)
+        uint32_t start = (uint32_t)((head - rh.count) % RING_EVENTS);
+        uint32_t first = rh.count < RING_EVENTS - start ? rh.count : RING_EVENTS - start;
+
+        ok = write_all(fd, &rh, sizeof(rh))
+            and write_all(fd, &ring->events[start], first * sizeof(Event))
+            and write_all(fd, &ring->events[0], (rh.count - first) * sizeof(Event));
+    }
+
+    ::close(fd);
+    errno = errno_saved;
+    return ok;
+}
+
+static char dump_path[256];
+
+static void dump_handler(int signo) {
+    Trace::dump(dump_path);
+
+    // Para los crashes el handler ya fue reseteado al default
+    // (SA_RESETHAND): volver a lanzar la signal mata al programa
+    // como si nunca la hubieramos atrapado (y deja el core dump).
+    if (signo != SIGUSR1)
+        raise(signo);
+}
+
+void Trace::dump_on_signals(const char *path) {
+    strncpy(dump_path, path, sizeof(dump_path) - 1);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = dump_handler;
+    sigemptyset(&sa.sa_mask);
+
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, nullptr);
+
+    sa.sa_flags = SA_RESETHAND | SA_NODEFER;
+    const int crashes[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+    for (int signo : crashes)
+        sigaction(signo, &sa, nullptr);
+}
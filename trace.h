@@ -0,0 +1,120 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/*
+ * Tracer de operaciones de Socket.
+ *
+ * Cuando hay un pico de latencia queremos ver la secuencia exacta de
+ * accept/recv/send/shutdown/close con sus tiempos. strace sirve pero
+ * es demasiado caro para dejarlo corriendo en produccion.
+ *
+ * En cambio cada thread tiene su propio buffer circular (ring) de
+ * eventos en memoria: registrar un evento es escribir 32 bytes y
+ * avanzar un indice, sin locks ni syscalls (el ring es del thread, nadie
+ * mas escribe en el). Como el ring es circular solo se guardan los
+ * ultimos Trace::RING_EVENTS eventos de cada thread: justamente los
+ * que nos interesan cuando algo sale mal.
+ *
+ * Los rings se vuelcan a un archivo binario con Trace::dump(), ya sea
+ * a mano, al recibir una signal o cuando el programa crashea
+ * (vease Trace::dump_on_signals()). Luego trace_dump convierte ese
+ * archivo al formato de Chrome (chrome://tracing o Perfetto).
+ *
+ * Los timestamps son del TSC del procesador (rdtsc) en x86 y de
+ * CLOCK_MONOTONIC en otras arquitecturas. El archivo guarda dos pares
+ * (tsc, monotonic) para poder convertir TSC a nanosegundos despues.
+ * */
+class Trace {
+    public:
+    enum Op : uint8_t {
+        ACCEPT = 1,
+        RECV,
+        SEND,
+        SHUTDOWN,
+        CLOSE,
+        CONNECT,
+    };
+
+    static const unsigned int RING_EVENTS = 1024;
+
+    /*
+     * Un evento tal cual se guarda en el ring y en el archivo.
+     *
+     * begin es el timestamp (ticks) de cuando empezo la operacion y
+     * duration cuantos ticks duro. result es lo que retorno la syscall
+     * o -errno si fallo.
+     * */
+    struct Event {
+        uint64_t begin;
+        int64_t result;
+        uint32_t size;
+        int32_t fd;
+        uint32_t duration;
+        uint8_t op;
+        uint8_t reserved[3];
+    };
+
+    /*
+     * Formato del archivo: un FileHeader seguido de, por cada thread,
+     * un RingHeader y sus count eventos (del mas viejo al mas nuevo).
+     * */
+    struct FileHeader {
+        char magic[8];      // "SKTTRACE"
+        uint32_t version;
+        uint32_t rings;
+        uint64_t ticks0, ns0;
+        uint64_t ticks1, ns1;
+    };
+
+    struct RingHeader {
+        uint32_t tid;
+        uint32_t count;
+    };
+
+    /*
+     * Timestamp actual en ticks.
+     * */
+    static inline uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __builtin_ia32_rdtsc();
+#else
+        return monotonic_ns();
+#endif
+    }
+
+    static uint64_t monotonic_ns();
+
+    /*
+     * Registra un evento en el ring del thread actual. begin es el
+     * valor de Trace::now() tomado antes de la operacion.
+     *
+     * No modifica errno asi se puede llamar entre la syscall y el
+     * chequeo de errores.
+     * */
+    static void record(Op op, int fd, unsigned int size, long long result, uint64_t begin);
+
+    /*
+     * Vuelca los rings de todos los threads al archivo path.
+     *
+     * Solo usa funciones async-signal-safe (open/write/close) asi que
+     * se puede llamar desde un signal handler. Como los demas threads
+     * siguen escribiendo mientras volcamos, el ultimo evento de algun
+     * ring podria salir a medio escribir.
+     *
+     * Retorna false si no se pudo escribir el archivo.
+     * */
+    static bool dump(const char *path) noexcept;
+
+    /*
+     * Instala signal handlers que vuelcan los rings al archivo path:
+     *
+     *  - al recibir SIGUSR1 se vuelca y el programa sigue.
+     *  - al crashear (SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT) se vuelca
+     *    y se deja que la signal mate al programa como siempre.
+     * */
+    static void dump_on_signals(const char *path);
+};
+
+#endif
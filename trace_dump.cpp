@@ -0,0 +1,98 @@
+#include <iostream>
+#include <fstream>
+#include "trace.h"
+
+#include <string.h>
+
+#include <stdexcept>
+#include <exception>
+
+/*
+ * Convierte un archivo generado por Trace::dump() al formato JSON de
+ * Chrome ("Trace Event Format") que se puede abrir con chrome://tracing
+ * o con https://ui.perfetto.dev
+ *
+ * Cada operacion de Socket aparece como un bloque en la linea de tiempo
+ * de su thread, con el fd, el tamaño pedido y el resultado como argumentos.
+ *
+ * Uso:
+ *
+ *  kill -USR1 <pid del echo_server>
+ *  ./trace_dump echo_server.trace > trace.json
+ * */
+
+static const char* op_name(uint8_t op) {
+    switch (op) {
+        case Trace::ACCEPT: return "accept";
+        case Trace::RECV: return "recv";
+        case Trace::SEND: return "send";
+        case Trace::SHUTDOWN: return "shutdown";
+        case Trace::CLOSE: return "close";
+        case Trace::CONNECT: return "connect";
+        default: return "unknown";
+    }
+}
+
+static void read_exactly(std::istream& in, void *data, size_t sz) {
+    in.read((char*)data, sz);
+    if ((size_t)in.gcount() != sz)
+        throw std::runtime_error("Truncated trace file");
+}
+
+int main(int argc, char *argv[]) try {
+    if (argc != 2) {
+        std::cerr << "Bad program call. Expected " << argv[0] << " <trace-file>\n";
+        return -1;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (not in)
+        throw std::runtime_error("Cannot open the trace file");
+
+    Trace::FileHeader header;
+    read_exactly(in, &header, sizeof(header));
+    if (memcmp(header.magic, "SKTTRACE", sizeof(header.magic)) != 0 or header.version != 1)
+        throw std::runtime_error("Not a trace file (or unsupported version)");
+
+    /*
+     * Pasamos de ticks a nanosegundos con una recta que pasa por los dos
+     * pares (ticks, ns) que guardo Trace::dump(). Si los ticks ya son
+     * nanosegundos (sin TSC) la pendiente es 1.
+     * */
+    double ns_per_tick = 1.0;
+    if (header.ticks1 > header.ticks0)
+        ns_per_tick = (double)(header.ns1 - header.ns0) / (double)(header.ticks1 - header.ticks0);
+
+    std::cout << "{\"traceEvents\": [\n";
+    bool first = true;
+    for (uint32_t r = 0; r < header.rings; ++r) {
+        Trace::RingHeader rh;
+        read_exactly(in, &rh, sizeof(rh));
+
+        for (uint32_t i = 0; i < rh.count; ++i) {
+            Trace::Event ev;
+            read_exactly(in, &ev, sizeof(ev));
+
+            // Chrome espera microsegundos
+            double ts = (header.ns0 + ((double)ev.begin - (double)header.ticks0) * ns_per_tick) / 1000.0;
+            double dur = ev.duration * ns_per_tick / 1000.0;
+
+            std::cout << (first ? "" : ",\n")
+                      << "{\"name\": \"" << op_name(ev.op) << "\", \"cat\": \"socket\", \"ph\": \"X\""
+                      << ", \"pid\": 1, \"tid\": " << rh.tid
+                      << std::fixed << ", \"ts\": " << ts << ", \"dur\": " << dur << std::defaultfloat
+                      << ", \"args\": {\"fd\": " << ev.fd << ", \"size\": " << ev.size
+                      << ", \"result\": " << ev.result << "}}";
+            first = false;
+        }
+    }
+    std::cout << "\n]}\n";
+
+    return 0;
+} catch (const std::exception& err) {
+    std::cerr << "Something went wrong and an exception was caught: " << err.what() << "\n";
+    return -1;
+} catch (...) {
+    std::cerr << "Something went wrong and an unknown exception was caught.\n";
+    return -1;
+}
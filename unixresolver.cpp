@@ -0,0 +1,33 @@
+#include "unixresolver.h"
+
+#include <string.h>
+
+#include <stdexcept>
+
+UnixResolver::UnixResolver(const char* hostname, const char* path, bool passive, int family, int socktype) :
+    pending(true) {
+    if (strlen(path) >= sizeof(this->addr.sun_path))
+        throw std::runtime_error("Unix socket path too long");
+
+    memset(&this->addr, 0, sizeof(this->addr));
+    this->addr.sun_family = AF_UNIX;
+    strncpy(this->addr.sun_path, path, sizeof(this->addr.sun_path) - 1);
+
+    memset(&this->info, 0, sizeof(this->info));
+    this->info.ai_flags = passive ? AI_PASSIVE : 0;
+    this->info.ai_family = family;
+    this->info.ai_socktype = socktype;
+    this->info.ai_protocol = 0;
+    this->info.ai_addr = (struct sockaddr*)&this->addr;
+    this->info.ai_addrlen = sizeof(this->addr);
+    this->info.ai_next = nullptr;
+}
+
+bool UnixResolver::has_next() {
+    return this->pending;
+}
+
+struct addrinfo* UnixResolver::next() {
+    this->pending = false;
+    return &this->info;
+}
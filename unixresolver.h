@@ -0,0 +1,43 @@
+#ifndef UNIXRESOLVER_H
+#define UNIXRESOLVER_H
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+
+/*
+ * El "Resolver" de los sockets UNIX: no hay nada que resolver, la
+ * direccion es el path del socket en el filesystem.
+ *
+ * Tiene la misma interfaz que Resolver (vease resolver.h) para que
+ * BasicSocket (vease basicsocket.h) recorra las direcciones con el
+ * mismo codigo sin importar la familia: aca hay siempre una sola, con
+ * ai_addr apuntando a un sockaddr_un armado con el path.
+ *
+ * El hostname se ignora (un socket UNIX es siempre local) y el path
+ * va en servicename.
+ * */
+class UnixResolver {
+    struct sockaddr_un addr;
+    struct addrinfo info;
+    bool pending;
+
+    public:
+    /*
+     * Lanza una excepcion si el path no entra en un sockaddr_un.
+     * */
+    UnixResolver(const char* hostname, const char* path, bool passive, int family, int socktype);
+
+    bool has_next();
+    struct addrinfo* next();
+
+    /*
+     * info apunta a addr (un miembro): copiar o mover un UnixResolver
+     * dejaria a la copia apuntando al original. No hace falta ninguna
+     * de las dos cosas asi que se prohiben.
+     * */
+    UnixResolver(const UnixResolver&) = delete;
+    UnixResolver& operator=(const UnixResolver&) = delete;
+};
+
+#endif
@@ -0,0 +1,402 @@
+#include <iostream>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+
+#include "worker.h"
+#include "affinity.h"
+
+Connection::Connection() : out_sent(0), writing(false), closing(false) {}
+
+bool Connection::send(const void *data, size_t sz) {
+    const char *p = (const char*)data;
+
+    // Si ya habia algo pendiente esto va detras: no hay que desordenar
+    if (not this->pending()) {
+        bool was_closed = false;
+        while (sz > 0) {
+            size_t chunk = sz < Socket::MAX_CHUNK ? sz : Socket::MAX_CHUNK;
+            int s = this->sendsome(p, chunk, &was_closed);
+            if (was_closed)
+                return false;
+            if (s < 0)
+                break;      // buffer de envio del kernel lleno
+
+            p += s;
+            sz -= s;
+        }
+    }
+
+    this->out.append(p, sz);
+    return true;
+}
+
+bool Connection::flush() {
+    bool was_closed = false;
+    while (this->pending()) {
+        size_t left = this->out.size() - this->out_sent;
+        size_t chunk = left < Socket::MAX_CHUNK ? left : Socket::MAX_CHUNK;
+        int s = this->sendsome(this->out.data() + this->out_sent, chunk, &was_closed);
+        if (was_closed)
+            return false;
+        if (s < 0)
+            return true;
+
+        this->out_sent += s;
+    }
+
+    this->out.clear();
+    this->out_sent = 0;
+    return true;
+}
+
+bool Connection::pending() const {
+    return this->out_sent < this->out.size();
+}
+
+unsigned int Connection::read_timeout_ms() {
+    return 0;
+}
+
+Connection::~Connection() {}
+
+Worker::Worker(Factory factory, size_t capacity) :
+    factory(factory), inbox(capacity), stopping(false), tcp_info_ms(0), aggregator(nullptr) {}
+
+void Worker::set_cpus(const std::vector<int>& cpus) {
+    this->cpus = cpus;
+}
+
+const std::vector<int>& Worker::get_cpus() const {
+    return this->cpus;
+}
+
+void Worker::set_tcp_info(unsigned int interval_ms, TelemetryAggregator *aggregator) {
+    this->tcp_info_ms = interval_ms;
+    this->aggregator = aggregator;
+}
+
+void Worker::set_shm_factory(ShmFactory factory) {
+    this->shm_factory = factory;
+}
+
+void Worker::start() {
+    this->th = std::thread(&Worker::run, this);
+}
+
+bool Worker::give(Socket& peer) {
+    Incoming item;
+    item.skt = std::move(peer);
+    if (this->inbox.try_push(item))
+        return true;
+
+    // Channel lleno: peer vuelve al caller
+    peer = std::move(item.skt);
+    return false;
+}
+
+bool Worker::give(ShmSocket& peer) {
+    if (not this->shm_factory)
+        throw std::runtime_error("Worker has no factory for ShmSockets (see Worker::set_shm_factory())");
+
+    Incoming item;
+    item.is_shm = true;
+    item.shm = std::move(peer);
+    if (this->inbox.try_push(item))
+        return true;
+
+    peer = std::move(item.shm);
+    return false;
+}
+
+void Worker::stop_and_join() {
+    if (not this->th.joinable())
+        return;
+
+    this->stopping = true;
+    this->inbox.wakeup();
+    this->th.join();
+}
+
+Worker::~Worker() {
+    this->stop_and_join();
+}
+
+void Worker::run() try {
+    bool pinned = false;
+    if (not this->cpus.empty()) {
+        pinned = Affinity::pin(this->cpus);
+        if (not pinned)
+            std::cerr << "Worker could not be pinned to its CPUs, running unpinned\n";
+    }
+
+    // Reservado (y tocado, assign() lo llena de ceros) desde este thread
+    // y ya fijado: queda en el nodo NUMA local (vease worker.h)
+    this->buffer.assign(BUFFER_SIZE, 0);
+    if (pinned)
+        this->check_buffer_node();
+
+    // El EventFd del Channel se registra con data nullptr: asi lo
+    // distinguimos de las conexiones.
+    this->poller.add(this->inbox.event(), nullptr);
+
+    using clock = std::chrono::steady_clock;
+    auto next_sample = clock::now() + std::chrono::milliseconds(this->tcp_info_ms);
+
+    Poller::Event events[64];
+    while (true) {
+        Incoming item;
+        while (this->inbox.try_pop(item)) {
+            if (item.is_shm)
+                this->accept_connection(std::move(item.shm), this->shm_factory);
+            else
+                this->accept_connection(std::move(item.skt), this->factory);
+        }
+
+        if (this->stopping and this->conns.empty())
+            break;
+
+        int timeout = -1;
+        if (this->tcp_info_ms) {
+            auto now = clock::now();
+            if (now >= next_sample) {
+                for (auto& conn : this->conns)
+                    this->sample(conn.first, false);
+                this->report();
+                next_sample = now + std::chrono::milliseconds(this->tcp_info_ms);
+            }
+            timeout = std::chrono::duration_cast<std::chrono::milliseconds>(next_sample - now).count() + 1;
+        }
+
+        if (not this->timeouts.empty()) {
+            auto now = clock::now();
+            if (now >= this->next_timeout)
+                this->expire_timeouts();
+
+            if (not this->timeouts.empty()) {
+                int until = std::chrono::duration_cast<std::chrono::milliseconds>(this->next_timeout - now).count() + 1;
+                if (timeout < 0 or until < timeout)
+                    timeout = until;
+            }
+        }
+
+        if (not this->inbox.sleep())
+            continue;
+
+        // Si hay conexiones en ready no hay que dormirse: solo miramos
+        // que mas hay
+        int n = this->poller.wait(events, 64, this->ready.empty() ? timeout : 0);
+        this->inbox.awake();
+
+        for (int i = 0; i < n; ++i) {
+            Connection *c = (Connection*)events[i].data;
+            if (not c)
+                continue;
+
+            this->process(c);
+        }
+
+        /*
+         * Las conexiones con datos ya recibidos que no van a generar un
+         * evento (vease Connection::buffered()) se atienden sin esperar
+         * al Poller. Las copiamos porque process() modifica ready (y
+         * puede cerrar la conexion).
+         * */
+        if (not this->ready.empty()) {
+            std::vector<Connection*> again(this->ready.begin(), this->ready.end());
+            for (Connection *c : again) {
+                if (this->ready.count(c))
+                    this->process(c);
+            }
+        }
+    }
+
+    if (this->tcp_info_ms)
+        this->report();
+} catch (const std::exception& err) {
+    // Si se escapa una excepcion del "main" de un thread el programa aborta
+    std::cerr << "Worker failed: " << err.what() << "\n";
+}
+
+template<class S, class F>
+void Worker::accept_connection(S&& peer, const F& factory) try {
+    /*
+     * Como con cada evento: una conexion que no se puede armar no
+     * deberia tirar abajo al Worker. Si falla, peer (o la Connection
+     * que ya lo tenia) se destruye aca y el socket se cierra.
+     * */
+    peer.set_nonblocking(true);
+
+    std::unique_ptr<Connection> conn = factory(std::move(peer));
+    Connection *c = conn.get();
+
+    c->poll_add(this->poller);
+    this->conns[c] = std::move(conn);
+
+    // Lo que el otro lado envio antes de que lo registraramos no genera
+    // un evento en un ShmSocket (y tiene que anotar que espera)
+    if (c->buffered())
+        this->ready.insert(c);
+} catch (const std::exception& err) {
+    std::cerr << "Connection setup failed: " << err.what() << "\n";
+}
+
+void Worker::process(Connection *c) {
+    if (this->handle(c))
+        return;
+
+    if (this->tcp_info_ms)
+        this->sample(c, true);
+    this->ready.erase(c);
+    this->timeouts.erase(c);
+    c->poll_remove(this->poller);
+    this->conns.erase(c);
+}
+
+/*
+ * Atiende las conexiones que vencieron su read_timeout_ms() como si se
+ * hubieran vuelto readable y calcula el proximo vencimiento. Se llama
+ * recien cuando vence el primero: los timeouts que se agregan en el
+ * medio no lo adelantan de mas (vease Worker::handle()).
+ * */
+void Worker::expire_timeouts() {
+    auto now = std::chrono::steady_clock::now();
+
+    std::vector<Connection*> expired;
+    for (auto& timeout : this->timeouts) {
+        if (timeout.second <= now)
+            expired.push_back(timeout.first);
+    }
+
+    for (Connection *c : expired) {
+        this->timeouts.erase(c);
+        this->process(c);
+    }
+
+    this->next_timeout = std::chrono::steady_clock::time_point::max();
+    for (auto& timeout : this->timeouts)
+        this->next_timeout = std::min(this->next_timeout, timeout.second);
+}
+
+bool Worker::handle(Connection *c) try {
+    /*
+     * Mientras haya algo pendiente la conexion solo espera por writable
+     * (un error o un cierre del peer tambien la despiertan y los vemos
+     * al enviar); si no, solo por readable.
+     * */
+    const bool was_writing = c->writing;
+    if (c->writing) {
+        if (not c->flush())
+            return false;
+    } else if (not c->on_readable(this->buffer.data(), this->buffer.size())) {
+        c->closing = true;
+    }
+
+    const bool want_write = c->pending();
+    if (c->closing and not want_write)
+        return false;
+
+    if (want_write != c->writing) {
+        c->poll_modify(this->poller, not want_write, want_write);
+        c->writing = want_write;
+    }
+
+    if (not c->writing and c->buffered())
+        this->ready.insert(c);
+    else
+        this->ready.erase(c);
+
+    /*
+     * Mientras espera por writable no lee: el timeout se vuelve a
+     * armar cuando termine de enviar y vuelva a esperar por readable.
+     * */
+    unsigned int ms = c->writing ? 0 : c->read_timeout_ms();
+    if (ms and was_writing) {
+        /*
+         * Lo que se encolo mientras enviabamos puede no alcanzar el
+         * SO_RCVLOWAT y no generar un evento: leemos sin esperar al
+         * Poller (ni al timeout).
+         * */
+        this->ready.insert(c);
+    }
+
+    if (ms) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        this->timeouts[c] = deadline;
+        if (this->timeouts.size() == 1 or deadline < this->next_timeout)
+            this->next_timeout = deadline;
+    } else {
+        this->timeouts.erase(c);
+    }
+
+    return true;
+} catch (const std::exception& err) {
+    /*
+     * Una conexion que falla no deberia tirar abajo al Worker
+     * (ni a las demas conexiones): la cerramos y seguimos.
+     * */
+    std::cerr << "Connection failed: " << err.what() << "\n";
+    return false;
+}
+
+/*
+ * El first touch es lo que el kernel hace por default, pero una
+ * politica de memoria del proceso (numactl --interleave, --membind) o
+ * un nodo sin memoria libre lo cambian. Si el buffer no quedo en el
+ * nodo de los CPUs del Worker lo avisamos: cada recv() lo pagaria.
+ * Si los CPUs son de distintos nodos no hay un nodo local.
+ * */
+void Worker::check_buffer_node() {
+    int local = Affinity::node_of(this->cpus[0]);
+    for (int cpu : this->cpus) {
+        if (Affinity::node_of(cpu) != local)
+            return;
+    }
+
+    int node = Affinity::node_of_address(this->buffer.data());
+    if (node >= 0 and node != local) {
+        std::ostringstream line;
+        line << "Worker buffer is on NUMA node " << node << " but the Worker runs on node " << local << "\n";
+        std::cerr << line.str();
+    }
+}
+
+void Worker::sample(Connection *c, bool closing) {
+    Socket::TcpInfo info;
+    try {
+        // Por ejemplo, un ShmSocket: no hay nada que muestrear
+        if (not c->tcp_info(&info))
+            return;
+    } catch (const std::exception&) {
+        // Por ejemplo, no es un socket TCP: no hay nada que muestrear
+        return;
+    }
+
+    /*
+     * Un outlier se loguea una vez mientras la conexion vive y otra vez
+     * al cerrarse, con sus numeros finales. Armamos la linea entera
+     * antes de escribirla para que no se mezcle con la de otro Worker.
+     * */
+    if (this->telemetry.record(info) and (closing or not this->reported.count(c))) {
+        std::ostringstream line;
+        line << "TCP outlier connection" << (closing ? " (closed)" : "") << ": ";
+        TcpTelemetry::write_sample(line, info);
+        line << "\n";
+        std::cerr << line.str();
+        this->reported.insert(c);
+    }
+
+    if (closing)
+        this->reported.erase(c);
+}
+
+void Worker::report() {
+    if (this->telemetry.count() == 0)
+        return;
+
+    this->aggregator->add(this->telemetry);
+    this->telemetry.reset();
+}
@@ -0,0 +1,314 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <stddef.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "socket.h"
+#include "shmsocket.h"
+#include "poller.h"
+#include "channel.h"
+#include "tcptelemetry.h"
+#include "telemetryaggregator.h"
+
+/*
+ * Una conexion atendida por un Worker. Cada server define la suya
+ * (por ejemplo, el echo_server define una que reenvia lo que recibe)
+ * a partir de PeerConnection (abajo), segun su peer sea un Socket o un
+ * ShmSocket.
+ *
+ * El Worker pone al peer en modo no bloqueante: un cliente que no lee
+ * sus respuestas no puede trabar al Worker (y a todas sus otras
+ * conexiones) en un send(). Por eso las respuestas se envian con
+ * Connection::send() y no con peer.sendall(): lo que el kernel no acepta
+ * queda en un buffer de salida que el Worker termina de enviar cuando
+ * el peer vuelve a ser writable. Mientras haya algo pendiente el Worker
+ * no lee mas de esa conexion (no tiene sentido acumular requests cuyas
+ * respuestas no se pueden enviar).
+ * */
+class Connection {
+    std::string out;        // pendiente de enviar
+    size_t out_sent;        // cuanto de out ya se envio
+    bool writing;           // registrada en el Poller como writable
+    bool closing;           // on_readable() retorno false, se envia lo pendiente y se cierra
+
+    friend class Worker;
+
+    /*
+     * El transporte, que implementa PeerConnection segun el tipo de
+     * peer. Los usan el Worker y send()/flush().
+     *
+     * buffered() retorna si hay que volver a llamar a on_readable() sin
+     * esperar al Poller: datos ya recibidos que no van a generar un
+     * evento (vease ShmSocket::prepare_wait()). tcp_info() retorna false
+     * si el peer no es TCP.
+     * */
+    virtual int sendsome(const void *data, unsigned int sz, bool *was_closed) = 0;
+    virtual void poll_add(Poller& poller) = 0;
+    virtual void poll_modify(Poller& poller, bool readable, bool writable) = 0;
+    virtual void poll_remove(Poller& poller) = 0;
+    virtual bool buffered() = 0;
+    virtual bool tcp_info(Socket::TcpInfo *info) = 0;
+
+    protected:
+    Connection();
+
+    /*
+     * Envia sz bytes: lo que no se pueda enviar ya se encola y lo envia
+     * el Worker despues. Retorna false si el peer cerro la conexion.
+     * */
+    bool send(const void *data, size_t sz);
+
+    public:
+    /*
+     * El Worker la llama cuando el peer tiene datos para leer: un
+     * recvsome() sobre el peer no bloqueara (aunque puede retornar menor
+     * a 0 si al final no habia nada, vease BasicSocket::recvsome()).
+     *
+     * buf es un buffer de len bytes del Worker (compartido por todas
+     * sus conexiones) que se puede usar durante la llamada, por ejemplo
+     * para el recvsome(). No hay que guardarlo para despues.
+     *
+     * Retorna false si la conexion termino y hay que cerrarla (una vez
+     * enviado lo que quede pendiente).
+     * */
+    virtual bool on_readable(char *buf, size_t len) = 0;
+
+    /*
+     * Si retorna mayor a 0, el Worker vuelve a llamar a on_readable() si
+     * pasan esos milisegundos sin que la conexion se vuelva readable
+     * (aunque no haya nada para leer). Se consulta despues de cada
+     * on_readable(). Por default 0: sin limite.
+     *
+     * Sirve para acotar la espera de un SO_RCVLOWAT (vease
+     * recvbuffer.h).
+     * */
+    virtual unsigned int read_timeout_ms();
+
+    /*
+     * Envia lo que haya pendiente hasta que se termine o el kernel no
+     * acepte mas. Retorna false si el peer cerro la conexion.
+     * */
+    bool flush();
+
+    /*
+     * Retorna si queda algo por enviar.
+     * */
+    bool pending() const;
+
+    virtual ~Connection();
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+};
+
+/*
+ * Una Connection cuyo peer es un S (Socket o ShmSocket).
+ * */
+template<class S>
+class PeerConnection : public Connection {
+    virtual int sendsome(const void *data, unsigned int sz, bool *was_closed) override {
+        return this->peer.sendsome(data, sz, was_closed);
+    }
+
+    virtual void poll_add(Poller& poller) override {
+        // El Worker recibe el data de cada evento como Connection*
+        poller.add(this->peer, static_cast<Connection*>(this), true, false);
+    }
+
+    virtual void poll_modify(Poller& poller, bool readable, bool writable) override {
+        poller.modify(this->peer, static_cast<Connection*>(this), readable, writable);
+    }
+
+    virtual void poll_remove(Poller& poller) override {
+        poller.remove(this->peer);
+    }
+
+    virtual bool buffered() override {
+        return false;
+    }
+
+    virtual bool tcp_info(Socket::TcpInfo *) override {
+        return false;
+    }
+
+    public:
+    S peer;
+
+    explicit PeerConnection(S&& peer) : peer(std::move(peer)) {}
+};
+
+template<>
+inline bool PeerConnection<Socket>::tcp_info(Socket::TcpInfo *info) {
+    *info = this->peer.tcp_info();
+    return true;
+}
+
+/*
+ * Un Socket con datos sin leer sigue readable para epoll; a un
+ * ShmSocket solo lo avisa el otro lado y solo si anoto que espera.
+ * */
+template<>
+inline bool PeerConnection<ShmSocket>::buffered() {
+    return not this->peer.prepare_wait();
+}
+
+/*
+ * Worker: un thread con un loop de eventos que atiende muchas
+ * conexiones a la vez.
+ *
+ * El aceptador le pasa los Sockets aceptados con Worker::give() a traves
+ * de un Channel (cola lock-free + EventFd). El Worker espera en un unico
+ * Poller tanto por sus conexiones como por Sockets nuevos: ese es su
+ * unico punto de bloqueo.
+ *
+ * Tambien puede atender ShmSockets (vease shmsocket.h) por el mismo
+ * Channel, con su propia factory (Worker::set_shm_factory()).
+ *
+ * Con un thread por cliente (como tenia antes el echo_server) miles de
+ * clientes son miles de threads; con Workers son tantos threads como
+ * cores.
+ *
+ * Opcionalmente el Worker se fija (pinning) a un conjunto de CPUs
+ * (vease affinity.h). El buffer que le presta a sus conexiones se
+ * reserva desde el propio thread ya fijado: Linux ubica cada pagina en
+ * el nodo NUMA del CPU que la toca por primera vez (first touch), asi
+ * que el buffer queda en la memoria local del Worker. Al arrancar el
+ * Worker lo verifica y avisa por stderr si no fue asi (por ejemplo,
+ * bajo numactl --interleave).
+ *
+ * Opcionalmente tambien muestrea TCP_INFO de sus conexiones (vease
+ * tcptelemetry.h) cada cierto intervalo y al cerrar cada una: loguea
+ * las conexiones outlier y, en cada intervalo, le pasa sus histogramas
+ * a un TelemetryAggregator compartido por todos los Workers, que loguea
+ * el resumen de todo el server.
+ * */
+class Worker {
+    public:
+    typedef std::function<std::unique_ptr<Connection>(Socket&&)> Factory;
+    typedef std::function<std::unique_ptr<Connection>(ShmSocket&&)> ShmFactory;
+
+    private:
+    /*
+     * Lo que viaja por el Channel: un Socket o un ShmSocket (el otro
+     * queda vacio). Un unico Channel para ambos: con dos, el Worker
+     * tendria que drenar dos EventFds en cada despertar.
+     * */
+    struct Incoming {
+        bool is_shm;
+        Socket skt;
+        ShmSocket shm;
+
+        Incoming() : is_shm(false) {}
+    };
+
+    Factory factory;
+    ShmFactory shm_factory;
+    Channel<Incoming> inbox;
+    Poller poller;
+    std::unordered_map<Connection*, std::unique_ptr<Connection>> conns;
+    std::atomic<bool> stopping;
+    std::vector<int> cpus;
+    std::vector<char> buffer;
+    unsigned int tcp_info_ms;
+    TelemetryAggregator *aggregator;
+    TcpTelemetry telemetry;
+    std::unordered_set<Connection*> reported;   // outliers ya logueados
+    std::unordered_set<Connection*> ready;      // con datos que no generaran un evento
+    std::unordered_map<Connection*, std::chrono::steady_clock::time_point> timeouts;   // vease Connection::read_timeout_ms()
+    std::chrono::steady_clock::time_point next_timeout;    // el menor de timeouts (o antes)
+    std::thread th;
+
+    void run();
+    template<class S, class F>
+    void accept_connection(S&& peer, const F& factory);
+    void process(Connection *c);
+    bool handle(Connection *c);
+    void sample(Connection *c, bool closing);
+    void check_buffer_node();
+    void expire_timeouts();
+    void report();
+
+    public:
+    static const size_t BUFFER_SIZE = 64 * 1024;
+
+    /*
+     * factory construye la Connection para cada Socket recibido.
+     * capacity es cuantos Sockets pueden estar esperando en el Channel
+     * (potencia de 2).
+     * */
+    Worker(Factory factory, size_t capacity);
+
+    /*
+     * Fija el Worker a los CPUs dados. Hay que llamarlo antes de
+     * Worker::start(). Si el sistema no lo permite el Worker corre sin
+     * afinidad (y lo avisa por stderr).
+     * */
+    void set_cpus(const std::vector<int>& cpus);
+
+    /*
+     * Los CPUs a los que esta fijado (vacio si a ninguno).
+     * */
+    const std::vector<int>& get_cpus() const;
+
+    /*
+     * Muestrea TCP_INFO de cada conexion cada interval_ms milisegundos
+     * y al cerrarla (0, el default, lo desactiva) y suma las muestras
+     * en aggregator, que debe vivir mas que el Worker. Hay que llamarlo
+     * antes de Worker::start().
+     * */
+    void set_tcp_info(unsigned int interval_ms, TelemetryAggregator *aggregator);
+
+    /*
+     * factory construye la Connection para cada ShmSocket recibido.
+     * Hay que llamarlo antes de Worker::start() para poder darle
+     * ShmSockets al Worker.
+     * */
+    void set_shm_factory(ShmFactory factory);
+
+    /*
+     * Lanza el thread del Worker.
+     * */
+    void start();
+
+    /*
+     * Le pasa un Socket aceptado al Worker. Thread-safe.
+     *
+     * Retorna false si el Worker tiene su Channel lleno (peer no se
+     * mueve y se lo puede dar a otro Worker).
+     * */
+    bool give(Socket& peer);
+
+    /*
+     * Lo mismo para un ShmSocket (vease Worker::set_shm_factory()).
+     * */
+    bool give(ShmSocket& peer);
+
+    /*
+     * Le pide al Worker que termine una vez que se cierren todas sus
+     * conexiones actuales (drenado) y espera a que lo haga.
+     *
+     * Si el Worker no fue lanzado (o ya termino) no hace nada.
+     * */
+    void stop_and_join();
+
+    /*
+     * Si el thread sigue corriendo, Worker::stop_and_join(): destruir un
+     * std::thread joinable aborta el programa.
+     * */
+    ~Worker();
+
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+};
+
+#endif